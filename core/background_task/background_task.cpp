@@ -8,6 +8,17 @@
 
 #ifdef WITH_BOOST_THREAD
 #include "background_task.h"
+#include <algorithm>
+
+static bool intersects(const std::vector<const void*> &a,
+		const std::vector<const void*> &b)
+{
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (std::find(b.begin(), b.end(), a[i]) != b.end())
+			return true;
+	}
+	return false;
+}
 
 void BackgroundTask::update(int percent)
 {
@@ -29,6 +40,16 @@ void BackgroundTask::done(bool success)
 #endif
 }
 
+bool BackgroundTask::dependsOn(const BackgroundTask &other) const
+{
+	if (isBarrier() || other.isBarrier())
+		return true;
+	// read after write, write after write, write after read
+	return intersects(inputs, other.outputs)
+			|| intersects(outputs, other.outputs)
+			|| intersects(outputs, other.inputs);
+}
+
 bool BackgroundTask::wait()
 {
 	Lock lock(guard);
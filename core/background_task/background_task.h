@@ -11,6 +11,7 @@
 
 #ifdef WITH_BOOST_THREAD
 #include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
@@ -22,7 +23,9 @@
 #endif
 
 /** Abstract class for background tasks. Tasks are expected to be queued into
-    BackgroundTaskQueue by which they are dispatched one-by-one. Inheritors
+    BackgroundTaskQueue by which they are dispatched. Tasks may declare the
+	shared data they read and write (see reads() and writes()), tasks without
+	common data are then run concurrently. Inheritors
 	shall implement run() and cancel() functions which are specific to the
 	actual algorithm and technology. Algorithm executed in run() function can
 	optionally report progress via update() function. Task creator can wait 
@@ -36,7 +39,7 @@ class BackgroundTask {
 
 public:
 	BackgroundTask()
-		: terminated(false), success(false) {}
+		: terminated(false), success(false), keyData(NULL) {}
 	virtual ~BackgroundTask() {}
 
 	/** Task-specific algorithm implemented in the inheritor. It depends
@@ -55,6 +58,42 @@ public:
 	    reported via return value. */
 	bool wait();
 
+	/** Declare data the task reads. Data is identified by the address of its
+	    SharedData wrapper, empty pointers are ignored. */
+	template<class T>
+	void reads(const boost::shared_ptr<T> &data) {
+		if (data)
+			inputs.push_back(data.get());
+	}
+	/** Declare data the task writes (or reads and writes). */
+	template<class T>
+	void writes(const boost::shared_ptr<T> &data) {
+		if (data)
+			outputs.push_back(data.get());
+	}
+	/** Whether the task declared any data. Tasks without declarations are
+	    barriers: they wait for all earlier tasks and all later tasks wait
+		for them. */
+	bool isBarrier() const { return inputs.empty() && outputs.empty(); }
+	/** Whether this task has to wait for the earlier queued task other,
+	    i.e. if either is a barrier or one writes data the other uses. */
+	bool dependsOn(const BackgroundTask &other) const;
+
+	/** Set supersession key of the task: target data and operation. When the
+	    task is queued, earlier tasks with the same key are dropped (queued)
+		or cancelled (running), as their results are obsolete. Only use it
+		for tasks that fully recompute their target. */
+	template<class T>
+	void setKey(const boost::shared_ptr<T> &data, const std::string &operation) {
+		keyData = data.get();
+		keyOperation = operation;
+	}
+	/** Whether the task makes the earlier task other obsolete. */
+	bool supersedes(const BackgroundTask &other) const {
+		return keyData && keyData == other.keyData
+				&& keyOperation == other.keyOperation;
+	}
+
 #ifdef WITH_QT
 signals:
 	/** Optional progress updates for asynchronous listeners. */
@@ -78,6 +117,11 @@ protected:
 	bool success;
 	/** Short description of task for GUI progress updates. */
 	std::string description; 
+	/** Declared input and output data, see reads() and writes(). */
+	std::vector<const void*> inputs, outputs;
+	/** Supersession key, see setKey(). */
+	const void *keyData;
+	std::string keyOperation;
 };
 
 typedef boost::shared_ptr<BackgroundTask> BackgroundTaskPtr;
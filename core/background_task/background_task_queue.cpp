@@ -13,62 +13,105 @@
 #include "background_task_queue.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <boost/thread/thread.hpp>
+
+unsigned int BackgroundTaskQueue::defaultWorkers()
+{
+	// tasks are parallelized internally, the workers only need to keep the
+	// TBB pool busy with independent tasks
+	unsigned int cores = boost::thread::hardware_concurrency();
+	return std::max(2u, std::min(4u, cores));
+}
 
 bool BackgroundTaskQueue::isIdle()
 {
 	Lock lock(mutex);
-	return (taskQueue.empty()) && (!currentTask);
+	return jobs.empty();
 }
 
 void BackgroundTaskQueue::halt()
 {
 	Lock lock(mutex);
 	halted = true;
-	taskQueue.clear(); // Flush the queue, so there is nothing else to pop.
-	if (currentTask) {
-		cancelled = true;
-		currentTask->cancel();
-	}
+	cancelTasks(lock);
 	lock.unlock(); // Unlock to prevent deadlock when signalling the condition.
-	future.notify_all(); // In case the thread is sleeping.
+	future.notify_all(); // In case the threads are sleeping.
+}
+
+bool BackgroundTaskQueue::isReady(JobList::const_iterator job)
+{
+	for (JobList::const_iterator it = jobs.begin(); it != job; ++it) {
+		if (job->task->dependsOn(*it->task))
+			return false;
+	}
+	return true;
 }
 
-bool BackgroundTaskQueue::pop() 
+BackgroundTaskPtr BackgroundTaskQueue::pop()
 {
 	Lock lock(mutex);
-	while (taskQueue.empty()) {
+	while (true) {
 		if (halted) {
-			return false; // Thread will terminate.
-		} else {
-			future.wait(lock); // Yields lock until signalled.
+			return BackgroundTaskPtr(); // Thread will terminate.
 		}
-	}
-	currentTask = taskQueue.front(); // Fetch the task.
-	taskQueue.pop_front();
+		for (JobList::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+			if (!it->running && isReady(it)) {
+				it->running = true; // Fetch the task.
 #ifdef BACKGROUND_TASK_QUEUE_DEBUG
-	std::cout << "BackgroundTaskQueue pop():" << std::endl;
-	print();
+				std::cout << "BackgroundTaskQueue pop():" << std::endl;
+				print();
 #endif /* BACKGROUND_TASK_QUEUE_DEBUG */
-	cancelled = false;
-	return true;
+				return it->task;
+			}
+		}
+		future.wait(lock); // Yields lock until signalled.
+	}
+}
+
+void BackgroundTaskQueue::finish(const BackgroundTaskPtr &task, bool success)
+{
+	Lock lock(mutex);
+	for (JobList::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+		if (it->task == task) {
+			task->done(!it->cancelled && success);
+			jobs.erase(it);
+			break;
+		}
+	}
+	lock.unlock(); // Unlock to prevent deadlock when signalling the condition.
+	future.notify_all(); // Dependent tasks may be ready now.
 }
 
 void BackgroundTaskQueue::print()
 {
 	int row = 0;
-	for(std::deque<BackgroundTaskPtr>::const_iterator it = taskQueue.begin();
-		it != taskQueue.end();
-		++it, ++row)
+	for (JobList::const_iterator it = jobs.begin(); it != jobs.end();
+		 ++it, ++row)
 	{
-		std::string name = typeid(**it).name();
-		std::cout << std::setw(4) << row << " " << name << std::endl;
+		std::string name = typeid(*it->task).name();
+		std::cout << std::setw(4) << row << (it->running ? " * " : "   ")
+				  << name << std::endl;
 	}
 }
 
 void BackgroundTaskQueue::push(BackgroundTaskPtr &task) 
 {
 	Lock lock(mutex);
-	taskQueue.push_back(task);
+	JobList::iterator it = jobs.begin();
+	while (it != jobs.end()) {
+		if (!task->supersedes(*it->task)) {
+			++it;
+		} else if (it->running) {
+			it->cancelled = true;
+			it->task->cancel();
+			++it;
+		} else {
+			it->task->done(false);
+			it = jobs.erase(it);
+		}
+	}
+	jobs.push_back(Job(task));
 #ifdef BACKGROUND_TASK_QUEUE_DEBUG
 	std::cout << "BackgroundTaskQueue push():" << std::endl;
 	print();
@@ -80,10 +123,21 @@ void BackgroundTaskQueue::push(BackgroundTaskPtr &task)
 void BackgroundTaskQueue::cancelTasks()
 {
 	Lock lock(mutex);
-	taskQueue.clear();
-	if (currentTask) {
-		cancelled = true;
-		currentTask->cancel();
+	cancelTasks(lock);
+}
+
+void BackgroundTaskQueue::cancelTasks(Lock &)
+{
+	// Flush the queue, so there is nothing else to pop.
+	JobList::iterator it = jobs.begin();
+	while (it != jobs.end()) {
+		if (it->running) {
+			it->cancelled = true;
+			it->task->cancel();
+			++it;
+		} else {
+			it = jobs.erase(it);
+		}
 	}
 }
 
@@ -96,15 +150,12 @@ void BackgroundTaskQueue::operator()()
 #endif
 		//std::cout << "BackgroundTaskQueue started." << std::endl;
 		while (true) {
-			if (!pop()) {
+			BackgroundTaskPtr task = pop();
+			if (!task) {
 				break; // Thread termination.
 			}
-			bool success = currentTask->run();
-			{
-				Lock lock(mutex);
-				currentTask->done(!cancelled && success);
-				currentTask.reset();
-			}
+			bool success = task->run();
+			finish(task, success);
 		}
 		//std::cout << "BackgroundTaskQueue terminated." << std::endl;
 #ifdef WITH_QT
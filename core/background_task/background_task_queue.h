@@ -10,7 +10,7 @@
 #define BACKGROUND_TASK_QUEUE_H
 
 #ifdef WITH_BOOST_THREAD
-#include <deque>
+#include <list>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -29,19 +29,28 @@ class BackgroundTaskQueue {
 #endif
 
 public:
-	BackgroundTaskQueue() : halted(false), cancelled(false) {}
+	BackgroundTaskQueue() : halted(false) {}
+
+	/** Number of worker threads that should be started on the queue. */
+	static unsigned int defaultWorkers();
 
 	/** Any tasks in the queue? */
 	bool isIdle();
 
-	/** Flush all queued tasks and terminate worker thread. */
+	/** Flush all queued tasks and terminate worker threads. */
 	void halt();
-	/** Put task into queue for later calculation. */
+	/** Put task into queue for later calculation. The task is started as
+	    soon as all earlier tasks it depends on are finished
+		(see BackgroundTask::dependsOn()). Earlier tasks it supersedes are
+		removed from the queue or cancelled, they report failure
+		(see BackgroundTask::setKey()). */
 	void push(BackgroundTaskPtr &task);
 	/** Cancel all tasks. */
 	void cancelTasks();
 
-	/** Background worker thread's main(). */
+	/** Background worker thread's main(). Several worker threads may run on
+	    the same queue, each of them calculates one task at a time. The
+		parallel algorithms inside the tasks share the TBB worker pool. */
 	void operator()(); 
 
 #ifdef WITH_QT
@@ -50,8 +59,31 @@ signals:
 #endif
 
 protected:
-	/** Fetch task from queue or passivelly wait on empty queue. */
-	bool pop();
+	typedef boost::mutex Mutex;
+	typedef boost::unique_lock<Mutex> Lock;
+
+	struct Job {
+		Job(const BackgroundTaskPtr &task)
+			: task(task), running(false), cancelled(false) {}
+		BackgroundTaskPtr task;
+		bool running;
+		/** Discards results of the task. */
+		bool cancelled;
+	};
+	typedef std::list<Job> JobList;
+
+	/** Fetch a task that is ready for calculation or passivelly wait until
+	    there is one. Returns an empty pointer on termination. */
+	BackgroundTaskPtr pop();
+	/** Report task completion and remove it from the queue. */
+	void finish(const BackgroundTaskPtr &task, bool success);
+	/** Whether the task does not depend on any task queued before it.
+	 *
+	 * Locking the queue mutex is responsibility of the caller.
+	 */
+	bool isReady(JobList::const_iterator job);
+	/** Drop queued tasks and cancel running ones, the lock has to be held. */
+	void cancelTasks(Lock &lock);
 
 	/** Print queue content to stdout. 
 	 *
@@ -65,21 +97,14 @@ private:
 	// do not implement
 	BackgroundTaskQueue &operator=(const BackgroundTaskQueue &other);
 
-	typedef boost::mutex Mutex;
-	typedef boost::unique_lock<Mutex> Lock;
-
 	/** Used for background thread termination. */
 	bool halted; 
-	/** Discards results of the currently calculated task. */
-	bool cancelled; 
-	/** Wakes sleeping worker thread. */
+	/** Wakes sleeping worker threads. */
 	boost::condition_variable future; 
 	/** Serializes thread access to the queue. */
 	Mutex mutex;
-	/** Currently calculated task. */
-	BackgroundTaskPtr currentTask; 
-	/** Task queue which is consumed one-by-one by worker thread. */
-	std::deque<BackgroundTaskPtr> taskQueue;
+	/** Queued and currently calculated tasks in order of submission. */
+	JobList jobs;
 };
 
 #endif
@@ -12,7 +12,10 @@ public:
 	ClampCuda(SharedMultiImgPtr image, SharedMultiImgPtr minmax,
 		bool includecache = true)
 		: BackgroundTask(), image(image), minmax(minmax), includecache(includecache)
-	{}
+	{
+		reads(minmax);
+		writes(image);
+	}
 	virtual ~ClampCuda() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
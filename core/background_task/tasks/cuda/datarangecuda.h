@@ -10,7 +10,11 @@
 class DataRangeCuda : public BackgroundTask {
 public:
 	DataRangeCuda(SharedMultiImgPtr multi, SharedMultiImgRangePtr range)
-		: BackgroundTask(), multi(multi), range(range) {}
+		: BackgroundTask(), multi(multi), range(range)
+	{
+		reads(multi);
+		writes(range);
+	}
 	virtual ~DataRangeCuda() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -16,7 +16,10 @@ public:
 		  source(source),
 		  current(current),
 		  includecache(includecache)
-	{}
+	{
+		reads(source);
+		writes(current);
+	}
 	virtual ~GradientCuda() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -13,7 +13,10 @@ class IlluminantCuda : public BackgroundTask {
 public:
 	IlluminantCuda(SharedMultiImgPtr multi, const Illuminant& il, bool remove, bool includecache = true)
 		: BackgroundTask(), multi(multi),
-		il(il), remove(remove), includecache(includecache) {}
+		il(il), remove(remove), includecache(includecache)
+	{
+		writes(multi);
+	}
 	virtual ~IlluminantCuda() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
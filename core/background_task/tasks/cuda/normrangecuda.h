@@ -11,7 +11,12 @@ public:
 		SharedMultiImgRangePtr range, multi_img::NormMode mode, int target,
 		multi_img::Value minval, multi_img::Value maxval, bool update)
 		: DataRangeCuda(multi, range),
-		mode(mode), target(target), minval(minval), maxval(maxval), update(update) {}
+		mode(mode), target(target), minval(minval), maxval(maxval), update(update)
+	{
+		// sets minval/maxval of the image
+		if (update)
+			writes(multi);
+	}
 	virtual ~NormRangeCuda() {}
 	virtual bool run();
 protected:
@@ -4,7 +4,11 @@
 class ScopeImage : public BackgroundTask {
 public:
 	ScopeImage(SharedMultiImgPtr full, SharedMultiImgPtr scoped, cv::Rect roi)
-		: BackgroundTask(), full(full), scoped(scoped), roi(roi) {}
+		: BackgroundTask(), full(full), scoped(scoped), roi(roi)
+	{
+		reads(full);
+		writes(scoped);
+	}
 	virtual ~ScopeImage() {}
 	virtual bool run() {
 		// using SharedData<multi_img_base>::getBase() to get multi_img_base object
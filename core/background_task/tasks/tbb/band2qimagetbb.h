@@ -6,7 +6,11 @@
 class Band2QImageTbb : public BackgroundTask {
 public:
 	Band2QImageTbb(SharedMultiImgPtr multi, qimage_ptr image, size_t band)
-		: BackgroundTask(), multi(multi), image(image), band(band) {}
+		: BackgroundTask(), multi(multi), image(image), band(band)
+	{
+		reads(multi);
+		writes(image);
+	}
 	virtual ~Band2QImageTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -8,7 +8,11 @@
 class BgrTbb : public BackgroundTask {
 public:
 	BgrTbb(SharedMultiImgPtr multi, mat3f_ptr bgr)
-		: BackgroundTask(), multi(multi), bgr(bgr) {}
+		: BackgroundTask(), multi(multi), bgr(bgr)
+	{
+		reads(multi);
+		writes(bgr);
+	}
 	virtual ~BgrTbb() {}
 	virtual bool run();
 
@@ -6,7 +6,10 @@ public:
 	ClampTbb(SharedMultiImgPtr image, SharedMultiImgPtr minmax, bool includecache = true)
 		: BackgroundTask(), image(image),	minmax(minmax),
 		  includecache(includecache)
-	{}
+	{
+		reads(minmax);
+		writes(image);
+	}
 	virtual ~ClampTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
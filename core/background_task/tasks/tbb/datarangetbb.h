@@ -4,7 +4,11 @@
 class DataRangeTbb : public BackgroundTask {
 public:
 	DataRangeTbb(SharedMultiImgPtr multi, SharedMultiImgRangePtr range)
-		: BackgroundTask(), multi(multi), range(range) {}
+		: BackgroundTask(), multi(multi), range(range)
+	{
+		reads(multi);
+		writes(range);
+	}
 	virtual ~DataRangeTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -5,12 +5,12 @@
 
 //#include <opencv2/gpu/gpu.hpp>
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
 
 #include <stopwatch.h>
 
 #include "multi_img/multi_img_tbb.h"
+#include "multi_img/band_ops.h"
 #include "rectangles.h"
 #include <background_task/background_task.h>
 
@@ -54,39 +54,19 @@ bool GradientTbb::run()
 
 	Stopwatch s;
 
+	// logarithm and differences of neighboring bands in one pass
+	band_ops::Mixing grad = band_ops::Mixing::differences((*source)->size());
 	std::vector<cv::Rect>::iterator it;
-	multi_img temp((*source)->height, (*source)->width, (*source)->size());
 	for (it = calc.begin(); it != calc.end(); ++it) {
 		if (it->width > 0 && it->height > 0) {
-			multi_img srcScope(**source, *it);
-			multi_img tmpScope(temp, *it);
-			Log computeLog(srcScope, tmpScope);
-			tbb::parallel_for(tbb::blocked_range<size_t>(0, temp.size()),
-				computeLog, tbb::auto_partitioner(), stopper);
-		}
-
-		if (stopper.is_group_execution_cancelled())
-			break;
-	}
-	temp.minval = 0.;
-	temp.maxval = log((*source)->maxval);
-	temp.roi = (*source)->roi;
-
-	for (it = calc.begin(); it != calc.end(); ++it) {
-		if (it->width > 0 && it->height > 0) {
-			multi_img tmpScope(temp, *it);
-			multi_img tgtScope(*target, *it);
-			Grad computeGrad(tmpScope, tgtScope);
-			tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-				computeGrad, tbb::auto_partitioner(), stopper);
+			if (!band_ops::mix((*source)->bands, target->bands, grad, *it,
+							   band_ops::LOG, stopper))
+				break;
 		}
-
-		if (stopper.is_group_execution_cancelled())
-			break;
 	}
-	target->minval = -temp.maxval;
-	target->maxval = temp.maxval;
-	target->roi = temp.roi;
+	target->maxval = log((*source)->maxval);
+	target->minval = -target->maxval;
+	target->roi = (*source)->roi;
 
 	// init multi_img::meta
 	for (unsigned int i = 0; i < (*source)->size()-1; ++i) {
@@ -101,7 +81,7 @@ bool GradientTbb::run()
 
 	if (includecache) {
 		RebuildPixels rebuildPixels(*target);
-		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->height),
 			rebuildPixels, tbb::auto_partitioner(), stopper);
 		target->dirty.setTo(0);
 		target->anydirt = false;
@@ -5,7 +5,11 @@ class GradientTbb : public BackgroundTask {
 public:
 	GradientTbb(SharedMultiImgPtr source, SharedMultiImgPtr current, bool includecache = true)
 		: BackgroundTask(), source(source),
-		current(current), includecache(includecache) {}
+		current(current), includecache(includecache)
+	{
+		reads(source);
+		writes(current);
+	}
 	virtual ~GradientTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -2,13 +2,13 @@
 
 #include <tbb/task_group.h>
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
 
 #include <stopwatch.h>
 
 #include <multi_img/illuminant.h>
 #include "multi_img/multi_img_tbb.h"
+#include "multi_img/band_ops.h"
 
 #include <background_task/background_task.h>
 #include "illuminanttbb.h"
@@ -27,15 +27,22 @@ bool IlluminantTbb::run()
 
 	Stopwatch s;
 
-	Illumination computeIllumination(*source, *target, il, remove);
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
-		computeIllumination, tbb::auto_partitioner(), stopper);
+	// removal multiplies by the reciprocal
+	std::vector<multi_img::Value> factors(source->size());
+	for (size_t d = 0; d < factors.size(); ++d) {
+		multi_img::Value c = (multi_img::Value)il.at(source->meta[d].center);
+		factors[d] = (remove ? 1.f / c : c);
+	}
+	band_ops::mix(source->bands, target->bands,
+				  band_ops::Mixing::scaling(factors),
+				  cv::Rect(0, 0, source->width, source->height),
+				  band_ops::LINEAR, stopper);
 
 	STOPWATCH_PRINT(s, "Illuminant TBB")
 
 	if (includecache) {
 		RebuildPixels rebuildPixels(*target);
-		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->size()),
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, target->height),
 			rebuildPixels, tbb::auto_partitioner(), stopper);
 		target->dirty.setTo(0);
 		target->anydirt = false;
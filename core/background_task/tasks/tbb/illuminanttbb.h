@@ -6,7 +6,10 @@ public:
 	IlluminantTbb(SharedMultiImgPtr multi, const Illuminant& il, bool remove,
 		   bool includecache = true)
 		: BackgroundTask(), multi(multi),
-		il(il), remove(remove), includecache(includecache) {}
+		il(il), remove(remove), includecache(includecache)
+	{
+		writes(multi);
+	}
 	virtual ~IlluminantTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
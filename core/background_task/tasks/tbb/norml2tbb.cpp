@@ -7,10 +7,10 @@
 #include <vector>
 
 #include <tbb/blocked_range.h>
-#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
 
 #include "multi_img/multi_img_tbb.h"
+#include "multi_img/band_ops.h"
 #include "rectangles.h"
 
 #include "norml2tbb.h"
@@ -50,12 +50,6 @@ bool NormL2Tbb::run()
 			if (stopper.is_group_execution_cancelled())
 				break;
 		}
-
-		/* reconstruct pixel cache for the region */
-		RebuildPixels rebuildPixels(*target);
-		tbb::parallel_for(tbb::blocked_range2d<int>(copySrc.y, copySrc.br().y,
-		                                            copySrc.x, copySrc.br().x),
-			rebuildPixels, tbb::auto_partitioner(), stopper);
 	}
 
 	Stopwatch s;
@@ -64,23 +58,16 @@ bool NormL2Tbb::run()
 	std::vector<cv::Rect>::iterator it;
 	for (it = calc.begin(); it != calc.end(); ++it) {
 		if (it->width > 0 && it->height > 0) {
-			NormL2 computeNormL2(**source, *target);
-			tbb::parallel_for(tbb::blocked_range2d<int>(it->y, it->br().y,
-			                                            it->x, it->br().x),
-				computeNormL2, tbb::auto_partitioner(), stopper);
-
-			// apply the new vectors to band data
-			ApplyCache applyCache(*target);
-			tbb::parallel_for(tbb::blocked_range2d<int>(it->y, it->br().y,
-			                                            it->x, it->br().x),
-				applyCache, tbb::auto_partitioner(), stopper);
+			if (!band_ops::normL2((*source)->bands, target->bands, *it,
+								  stopper))
+				break;
 		}
-
-		if (stopper.is_group_execution_cancelled())
-			break;
 	}
 
-	/* we either rebuilt the pixels, or had computation happen in the cache. */
+	/* pixel cache is filled once, from the final band data */
+	RebuildPixels rebuildPixels(*target);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, target->height),
+		rebuildPixels, tbb::auto_partitioner(), stopper);
 	target->dirty.setTo(0);
 	target->anydirt = false;
 
@@ -4,7 +4,11 @@
 class NormL2Tbb : public BackgroundTask {
 public:
 	NormL2Tbb(SharedMultiImgPtr source, SharedMultiImgPtr current)
-		: BackgroundTask(), source(source), current(current) {}
+		: BackgroundTask(), source(source), current(current)
+	{
+		reads(source);
+		writes(current);
+	}
 	virtual ~NormL2Tbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -6,7 +6,11 @@ public:
 	PcaTbb(SharedMultiImgPtr source, SharedMultiImgPtr current,
 		   unsigned int components = 0, bool includecache = true)
 		: BackgroundTask(), source(source), current(current),
-		components(components), includecache(includecache) {}
+		components(components), includecache(includecache)
+	{
+		reads(source);
+		writes(current);
+	}
 	virtual ~PcaTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
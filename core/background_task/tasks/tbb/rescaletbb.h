@@ -6,7 +6,11 @@ public:
 	RescaleTbb(SharedMultiImgPtr source, SharedMultiImgPtr current,
 		   	size_t newsize, bool includecache = true)
 		: BackgroundTask(), source(source), current(current),
-		newsize(newsize), includecache(includecache) {}
+		newsize(newsize), includecache(includecache)
+	{
+		reads(source);
+		writes(current);
+	}
 	virtual ~RescaleTbb() {}
 	virtual bool run();
 	virtual void cancel() { stopper.cancel_group_execution(); }
@@ -6,7 +6,10 @@
 class RgbTbb : public BgrTbb {
 public:
 	RgbTbb(SharedMultiImgPtr multi, mat3f_ptr bgr, qimage_ptr rgb)
-		: BgrTbb(multi, bgr), rgb(rgb) {}
+		: BgrTbb(multi, bgr), rgb(rgb)
+	{
+		writes(rgb);
+	}
 	virtual ~RgbTbb() {}
 	virtual bool run();
 protected:
@@ -0,0 +1,295 @@
+#include "band_ops.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BAND_OPS_DISPATCH
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace band_ops {
+
+/// number of columns processed together, per-row scratch stays in cache
+static const int COLUMN_TILE = 256;
+
+/// row kernels, one set per instruction set
+struct Table {
+	const char *name;
+	/// y = w * x
+	void (*scale)(const Value*, float, Value*, size_t);
+	/// y += w * x
+	void (*axpy)(const Value*, float, Value*, size_t);
+	/// acc += x * x
+	void (*sqrAcc)(const Value*, Value*, size_t);
+	/// y = x * s, element-wise
+	void (*mul)(const Value*, const Value*, Value*, size_t);
+};
+
+/* All loads and stores are unaligned, as band rows start anywhere in ROI
+   views. Products and sums are computed separately (no FMA), so results of
+   both instruction sets are identical. */
+
+static void scaleSSE2(const Value *x, float w, Value *y, size_t n)
+{
+	const __m128 vw = _mm_set1_ps(w);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(x + i), vw));
+	for (; i < n; ++i)
+		y[i] = x[i] * w;
+}
+
+static void axpySSE2(const Value *x, float w, Value *y, size_t n)
+{
+	const __m128 vw = _mm_set1_ps(w);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 p = _mm_mul_ps(_mm_loadu_ps(x + i), vw);
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), p));
+	}
+	for (; i < n; ++i)
+		y[i] += x[i] * w;
+}
+
+static void sqrAccSSE2(const Value *x, Value *acc, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_loadu_ps(x + i);
+		_mm_storeu_ps(acc + i,
+					  _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(v, v)));
+	}
+	for (; i < n; ++i)
+		acc[i] += x[i] * x[i];
+}
+
+static void mulSSE2(const Value *x, const Value *s, Value *y, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(y + i,
+					  _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(s + i)));
+	for (; i < n; ++i)
+		y[i] = x[i] * s[i];
+}
+
+static const Table sse2Table = {
+	"SSE2", scaleSSE2, axpySSE2, sqrAccSSE2, mulSSE2
+};
+
+#ifdef BAND_OPS_DISPATCH
+
+/* AVX2 code is compiled for its target only, so the binary still runs on any
+   x86 CPU. The remainder is left to the SSE2 kernels. */
+
+#define BAND_OPS_AVX2 __attribute__((target("avx2")))
+
+BAND_OPS_AVX2 static void scaleAVX2(const Value *x, float w, Value *y,
+									size_t n)
+{
+	const __m256 vw = _mm256_set1_ps(w);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), vw));
+	scaleSSE2(x + i, w, y + i, n - i);
+}
+
+BAND_OPS_AVX2 static void axpyAVX2(const Value *x, float w, Value *y, size_t n)
+{
+	const __m256 vw = _mm256_set1_ps(w);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 p = _mm256_mul_ps(_mm256_loadu_ps(x + i), vw);
+		_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), p));
+	}
+	axpySSE2(x + i, w, y + i, n - i);
+}
+
+BAND_OPS_AVX2 static void sqrAccAVX2(const Value *x, Value *acc, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 v = _mm256_loadu_ps(x + i);
+		_mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i),
+												_mm256_mul_ps(v, v)));
+	}
+	sqrAccSSE2(x + i, acc + i, n - i);
+}
+
+BAND_OPS_AVX2 static void mulAVX2(const Value *x, const Value *s, Value *y,
+								  size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(x + i),
+											  _mm256_loadu_ps(s + i)));
+	mulSSE2(x + i, s + i, y + i, n - i);
+}
+
+static const Table avx2Table = {
+	"AVX2", scaleAVX2, axpyAVX2, sqrAccAVX2, mulAVX2
+};
+
+#endif // BAND_OPS_DISPATCH
+
+static const Table &selectTable()
+{
+#ifdef BAND_OPS_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return avx2Table;
+#endif
+	return sse2Table;
+}
+
+/// chosen once, thread-safe initialization of function-local static
+static const Table &table()
+{
+	static const Table &t = selectTable();
+	return t;
+}
+
+const char *isa()
+{
+	return table().name;
+}
+
+/// same as cv::log() followed by cv::max(.., 0.), zero values map to 0
+static inline void logRow(const Value *x, Value *y, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		y[i] = (x[i] > 0.f ? std::max(std::log(x[i]), 0.f) : 0.f);
+}
+
+Mixing Mixing::differences(size_t size)
+{
+	assert(size > 1);
+	Mixing ret(size, size - 1);
+	for (size_t i = 0; i < size - 1; ++i) {
+		ret.terms[i].push_back(Term(i + 1, 1.f));
+		ret.terms[i].push_back(Term(i, -1.f));
+	}
+	return ret;
+}
+
+Mixing Mixing::resampling(size_t size, size_t newsize)
+{
+	assert(size > 0);
+	Mixing ret(size, newsize);
+	if (size == 1) {
+		for (size_t i = 0; i < newsize; ++i)
+			ret.terms[i].push_back(Term(0, 1.f));
+		return ret;
+	}
+
+	double scale = (double)size / newsize;
+	for (size_t i = 0; i < newsize; ++i) {
+		float f = (float)((i + 0.5) * scale - 0.5);
+		int s = (int)std::floor(f);
+		f -= s;
+		if (s < 0) {
+			f = 0.f;
+			s = 0;
+		}
+		if (s >= (int)size - 1) {
+			// last band only
+			s = (int)size - 2;
+			f = 1.f;
+		}
+		if (f < 1.f)
+			ret.terms[i].push_back(Term(s, 1.f - f));
+		if (f > 0.f)
+			ret.terms[i].push_back(Term(s + 1, f));
+	}
+	return ret;
+}
+
+Mixing Mixing::scaling(const std::vector<Value> &factors)
+{
+	Mixing ret(factors.size(), factors.size());
+	for (size_t i = 0; i < factors.size(); ++i)
+		ret.terms[i].push_back(Term(i, factors[i]));
+	return ret;
+}
+
+bool mix(const std::vector<Band> &source, std::vector<Band> &target,
+		 const Mixing &mixing, const cv::Rect &region, Input input,
+		 tbb::task_group_context &stopper)
+{
+	assert(source.size() == mixing.insize);
+	assert(target.size() == mixing.outsize());
+	const Table &t = table();
+	const size_t insize = mixing.insize, outsize = mixing.outsize();
+
+	tbb::parallel_for(tbb::blocked_range<int>(region.y, region.br().y),
+		[&](const tbb::blocked_range<int> &r) {
+		// transformed input rows of one tile
+		std::vector<Value> scratch(input == LINEAR ? 0 : insize * COLUMN_TILE);
+		for (int y = r.begin(); y != r.end(); ++y) {
+			for (int x0 = region.x; x0 < region.br().x; x0 += COLUMN_TILE) {
+				const size_t n = std::min(COLUMN_TILE, region.br().x - x0);
+				if (input == LOG) {
+					for (size_t b = 0; b < insize; ++b)
+						logRow(source[b][y] + x0, &scratch[b * COLUMN_TILE], n);
+				}
+
+				for (size_t o = 0; o < outsize; ++o) {
+					const std::vector<Mixing::Term> &terms = mixing.terms[o];
+					Value *dst = target[o][y] + x0;
+					if (terms.empty()) {
+						std::fill(dst, dst + n, 0.f);
+						continue;
+					}
+					for (size_t i = 0; i < terms.size(); ++i) {
+						const Value *src = (input == LINEAR
+							? source[terms[i].band][y] + x0
+							: &scratch[terms[i].band * COLUMN_TILE]);
+						if (i == 0)
+							t.scale(src, terms[i].weight, dst, n);
+						else
+							t.axpy(src, terms[i].weight, dst, n);
+					}
+				}
+			}
+		}
+	}, tbb::auto_partitioner(), stopper);
+
+	return !stopper.is_group_execution_cancelled();
+}
+
+bool normL2(const std::vector<Band> &source, std::vector<Band> &target,
+			const cv::Rect &region, tbb::task_group_context &stopper)
+{
+	assert(source.size() == target.size());
+	const Table &t = table();
+	const size_t size = source.size();
+
+	tbb::parallel_for(tbb::blocked_range<int>(region.y, region.br().y),
+		[&](const tbb::blocked_range<int> &r) {
+		// squared norms, then their inverse, of one tile
+		std::vector<Value> factor(COLUMN_TILE);
+		for (int y = r.begin(); y != r.end(); ++y) {
+			for (int x0 = region.x; x0 < region.br().x; x0 += COLUMN_TILE) {
+				const size_t n = std::min(COLUMN_TILE, region.br().x - x0);
+				std::fill(factor.begin(), factor.end(), 0.f);
+				for (size_t b = 0; b < size; ++b)
+					t.sqrAcc(source[b][y] + x0, &factor[0], n);
+				for (size_t i = 0; i < n; ++i)
+					factor[i] = (factor[i] > 0.f
+								 ? 1.f / std::sqrt(factor[i]) : 1.f);
+				for (size_t b = 0; b < size; ++b)
+					t.mul(source[b][y] + x0, &factor[0], target[b][y] + x0, n);
+			}
+		}
+	}, tbb::auto_partitioner(), stopper);
+
+	return !stopper.is_group_execution_cancelled();
+}
+
+} // namespace band_ops
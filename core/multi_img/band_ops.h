@@ -0,0 +1,75 @@
+#ifndef BAND_OPS_H
+#define BAND_OPS_H
+
+#include <multi_img.h>
+#include <tbb/task.h>
+#include <vector>
+
+/**
+* @namespace band_ops
+*
+* @brief spectral operators working directly on band data
+*
+* The operators read rows of the input bands and write rows of the output
+* bands, so computing a new representation costs one read and one write of the
+* data. The pixel cache is neither needed nor touched. Rows are processed in
+* parallel, the inner loops run with SIMD over contiguous rows. The instruction
+* set (AVX2 or SSE2) is chosen at runtime, on first use.
+*/
+namespace band_ops {
+
+typedef multi_img::Value Value;
+typedef multi_img::Band Band;
+
+/// name of the instruction set in use
+const char *isa();
+
+/** Sparse linear combination of bands.
+	Output band i is the sum of weight * input band over the terms of i.
+*/
+struct Mixing {
+	struct Term {
+		Term(size_t band, float weight) : band(band), weight(weight) {}
+		size_t band;
+		float weight;
+	};
+
+	Mixing(size_t insize, size_t outsize) : insize(insize), terms(outsize) {}
+
+	size_t outsize() const { return terms.size(); }
+
+	/// differences of neighboring bands (spectral gradient)
+	static Mixing differences(size_t size);
+	/// linear interpolation, sampled like cv::resize() (spectral rescaling)
+	static Mixing resampling(size_t size, size_t newsize);
+	/// every band multiplied by its own factor (e.g. illuminant)
+	static Mixing scaling(const std::vector<Value> &factors);
+
+	size_t insize;
+	std::vector<std::vector<Term> > terms;
+};
+
+/// transform applied to the input values before mixing
+enum Input {
+	LINEAR,
+	LOG     ///< logarithm, clamped at 0 (see multi_img::apply_logarithm())
+};
+
+/** Compute region of the target bands from the same region of the source.
+	Target bands have to be allocated.
+	@return false if cancelled through stopper
+*/
+bool mix(const std::vector<Band> &source, std::vector<Band> &target,
+		 const Mixing &mixing, const cv::Rect &region, Input input,
+		 tbb::task_group_context &stopper);
+
+/** Divide each pixel in region by its L2 norm over all bands (zero pixels
+	stay zero). Target bands have to be allocated.
+	@return false if cancelled through stopper
+*/
+bool normL2(const std::vector<Band> &source, std::vector<Band> &target,
+			const cv::Rect &region, tbb::task_group_context &stopper);
+
+} // namespace band_ops
+
+#endif // BAND_OPS_H
@@ -8,6 +8,8 @@
 
 #include "multi_img.h"
 #ifdef WITH_OPENCV2 // theoretically, vole could be built w/o opencv..
+#include <algorithm>
+#include <utility>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -67,33 +69,68 @@ multi_img & multi_img::operator=(const multi_img &a) {
 		meta = a.meta;
 		roi = a.roi;
 
-		// image data
-		bands.resize(a.bands.size());
-		for (size_t i = 0; i < bands.size(); ++i)
-			bands[i] = a.bands[i].clone();
+		// image data, shared until either image is written to
+		bands = a.bands;
+		sharedBands = a.sharedBands = true;
+#ifdef WITH_BOOST
+		backing = a.backing;
+#endif
 
-		// cache data
+		// pixel cache is rebuilt on demand
+		resetPixels(true);
+	}
+	return *this;
+}
+
+multi_img & multi_img::operator=(multi_img &&a) {
+	if (this != &a) {
+		width = a.width; height = a.height;
+		minval = a.minval; maxval = a.maxval;
+		meta.swap(a.meta);
+		roi = a.roi;
+		bands.swap(a.bands);
+		sharedBands = a.sharedBands.load();
+#ifdef WITH_BOOST
+		backing.swap(a.backing);
+#endif
 		pixels = a.pixels;
-		dirty = a.dirty.clone();
+		dirty = a.dirty;
 		anydirt = a.anydirt;
+
+		// leave a empty
+		a.width = a.height = 0;
+		a.roi = cv::Rect();
+		a.meta.clear();
+		a.bands.clear();
+		a.sharedBands = false;
+#ifdef WITH_BOOST
+		a.backing.reset();
+#endif
+		a.pixels.release();
+		a.dirty.release();
+		a.anydirt = false;
 	}
 	return *this;
 }
 
-multi_img::multi_img(const multi_img &a, bool omitCache)
- : multi_img_base(a), roi(a.roi), bands(a.size())
+multi_img::multi_img(const multi_img &a)
+ : multi_img_base(a), roi(a.roi), bands(a.bands)
 {
 	std::cerr << "multi_img: copy" << std::endl;
-	for (size_t i = 0; i < bands.size(); ++i)
-		bands[i] = a.bands[i].clone();
+	// image data, shared until either image is written to
+	sharedBands = a.sharedBands = true;
+#ifdef WITH_BOOST
+	backing = a.backing;
+#endif
 
-	if (omitCache) {
-		resetPixels();
-	} else {
-		pixels = a.pixels;
-		dirty = a.dirty.clone();
-		anydirt = a.anydirt;
-	}
+	// pixel cache is rebuilt on demand
+	resetPixels();
+}
+
+multi_img::multi_img(multi_img &&a)
+ : multi_img_base(), anydirt(false)
+{
+	*this = std::move(a);
 }
 
 multi_img::multi_img(const multi_img_base &a, const cv::Rect &roi)
@@ -101,14 +138,16 @@ multi_img::multi_img(const multi_img_base &a, const cv::Rect &roi)
 {
 	width = roi.width;
 	height = roi.height;
-	for (size_t i = 0; i < bands.size(); ++i) {
-		Band band;
-		a.getBand(i, band);
-		a.scopeBand(band, roi, bands[i]);
+	a.getScopedBands(roi, bands);
+	// bands are views on the data of a
+	sharedBands = true;
+	const multi_img *src = dynamic_cast<const multi_img*>(&a);
+	if (src) {
+		src->sharedBands = true;
+#ifdef WITH_BOOST
+		backing = src->backing;
+#endif
 	}
-	/* FIXME: - inconsistent to other copy constr.
-	          - will lead to corrupt cache data!
-                use vector of pointers for cache and copy them, too? */
 	resetPixels();
 }
 
@@ -123,17 +162,52 @@ multi_img::multi_img(const multi_img &a, unsigned int start, unsigned int end) :
 	std::cerr << "multi_img: reference w/ spectral crop" << std::endl;
 	meta.insert(meta.begin(), a.meta.begin() + start, a.meta.begin() + (end+1));
 	bands.insert(bands.begin(), a.bands.begin() + start, a.bands.begin() + (end+1));
-	/* FIXME: - inconsistent to other copy constr.
-	          - will lead to corrupt cache data!
-			  read-only flag? no constructor but const method?
-	*/
+	// bands are shared with a
+	sharedBands = a.sharedBands = true;
+#ifdef WITH_BOOST
+	backing = a.backing;
+#endif
 	resetPixels();
 }
 
+void multi_img::detach()
+{
+	if (!sharedBands)
+		return;
+
+	std::cerr << "multi_img: detach shared bands" << std::endl;
+	for (size_t i = 0; i < bands.size(); ++i)
+		bands[i] = bands[i].clone();
+	sharedBands = false;
+#ifdef WITH_BOOST
+	// our bands do not reference external data anymore
+	backing.reset();
+#endif
+}
+
+#ifdef WITH_BOOST
+multi_img::multi_img(const std::vector<Band> &bands,
+					 const std::vector<BandDesc> &meta,
+					 const boost::shared_ptr<void> &backing)
+ : multi_img_base(), bands(bands), backing(backing)
+{
+	assert(!bands.empty() && meta.size() == bands.size());
+	this->meta = meta;
+	width = bands[0].cols;
+	height = bands[0].rows;
+	roi = cv::Rect(0, 0, width, height);
+	resetPixels();
+}
+#endif
+
 void multi_img::resetPixels(bool force) const
 {
 	if (force || pixels.empty()) {
-		pixels.assign(width * height, Pixel(size()));
+		/* one contiguous buffer, each pixel padded to a multiple of four
+		   values. cv::fastMalloc() aligns the buffer itself */
+		int dim = (int)size(), stride = (dim + 3) & ~3;
+		cv::Mat_<Value> storage(width * height, stride);
+		pixels = storage.colRange(0, dim);
 	}
 	if (force || dirty.empty())
 		dirty = cv::Mat1b(height, width, 255);
@@ -148,39 +222,80 @@ void multi_img::rebuildPixels(bool optimistic) const
 		return;
 
 	std::cerr << "multi_img: complete rebuild" << std::endl;
-	Band::const_iterator it;
-	register unsigned int d, i;
-	for (d = 0; d < size(); ++d) {
-		const Band &src = bands[d];
-		for (it = src.begin(), i = 0; it != src.end(); ++it, ++i)
-			pixels[i][d] = *it;
-	}
+	cacheFromBands(cv::Rect(0, 0, width, height));
 	dirty.setTo(0);
 	anydirt = false;
 }
 
+/* tile size of the blocked transpose between bands and pixel cache:
+   16 bands (64 bytes) x 64 pixels */
+#define MULTI_IMG_TILE_BANDS 16
+#define MULTI_IMG_TILE_PIXELS 64
+
+void multi_img::cacheFromBands(const cv::Rect &region) const
+{
+	const int dim = (int)size();
+	const size_t stride = pixels.step1();
+	for (int row = region.y; row < region.br().y; ++row) {
+		for (int c0 = region.x; c0 < region.br().x;
+			 c0 += MULTI_IMG_TILE_PIXELS) {
+			int c1 = std::min(c0 + MULTI_IMG_TILE_PIXELS, region.br().x);
+			for (int d0 = 0; d0 < dim; d0 += MULTI_IMG_TILE_BANDS) {
+				int d1 = std::min(d0 + MULTI_IMG_TILE_BANDS, dim);
+				for (int d = d0; d < d1; ++d) {
+					const Value *src = bands[d][row];
+					Value *dst = pixels[row*width + c0] + d;
+					for (int col = c0; col < c1; ++col, dst += stride)
+						*dst = src[col];
+				}
+			}
+		}
+	}
+}
+
+void multi_img::bandsFromCache(const cv::Rect &region)
+{
+	const int dim = (int)size();
+	const size_t stride = pixels.step1();
+	for (int row = region.y; row < region.br().y; ++row) {
+		for (int c0 = region.x; c0 < region.br().x;
+			 c0 += MULTI_IMG_TILE_PIXELS) {
+			int c1 = std::min(c0 + MULTI_IMG_TILE_PIXELS, region.br().x);
+			for (int d0 = 0; d0 < dim; d0 += MULTI_IMG_TILE_BANDS) {
+				int d1 = std::min(d0 + MULTI_IMG_TILE_BANDS, dim);
+				for (int d = d0; d < d1; ++d) {
+					Value *dst = bands[d][row];
+					const Value *src = pixels[row*width + c0] + d;
+					for (int col = c0; col < c1; ++col, src += stride)
+						dst[col] = *src;
+				}
+			}
+		}
+	}
+}
+
 void multi_img::rebuildPixel(unsigned int row, unsigned int col) const
 {
 	std::cerr << "multi_img: rebuild pixel " << row << "." << col << std::endl;
-	Pixel &p = pixels[row*width + col];
+	Value *p = pixels[row*width + col];
 	for (size_t i = 0; i < size(); ++i)
 		p[i] = bands[i](row, col);
 
 	dirty(row, col) = 0;
 }
 
-std::vector<const multi_img::Pixel*> multi_img::getSegment(const cv::Mat1b &mask)
+std::vector<multi_img::PixelView> multi_img::getSegment(const cv::Mat1b &mask)
 {
 	assert(mask.rows == height && mask.cols == width);
 
-	std::vector<const Pixel*> ret;
+	std::vector<PixelView> ret;
 	for (int row = 0; row < height; ++row) {
 		const uchar *m = mask[row];
 		for (int col = 0; col < width; ++col) {
 			if (m[col] > 0) {
 				if (anydirt && dirty(row, col))
 					rebuildPixel(row, col);
-				ret.push_back(&pixels[row*width + col]);
+				ret.push_back(PixelView(pixels[row*width + col], size()));
 			}
 		}
 	}
@@ -198,7 +313,8 @@ std::vector<multi_img::Pixel> multi_img::getSegmentCopy(const cv::Mat1b &mask)
 			if (m[col] > 0) {
 				if (anydirt && dirty(row, col))
 					rebuildPixel(row, col);
-				ret.push_back(pixels[row*width + col]);
+				const Value *p = pixels[row*width + col];
+				ret.push_back(Pixel(p, p + size()));
 			}
 		}
 	}
@@ -208,10 +324,11 @@ std::vector<multi_img::Pixel> multi_img::getSegmentCopy(const cv::Mat1b &mask)
 void multi_img::setPixel(unsigned int row, unsigned int col,
 						 const Pixel &values)
 {
+	detach();
 	assert((int)row < height && (int)col < width);
 	assert(values.size() == size());
-	Pixel &p = pixels[row*width + col];
-	p = values;
+	Value *p = pixels[row*width + col];
+	std::copy(values.begin(), values.end(), p);
 	for (size_t i = 0; i < size(); ++i)
 		bands[i](row, col) = p[i];
 
@@ -222,10 +339,11 @@ void multi_img::setPixel(unsigned int row, unsigned int col,
 void multi_img::setPixel(unsigned int row, unsigned int col,
 						 const cv::Mat_<Value>& values)
 {
+	detach();
 	assert((int)row < height && (int)col < width);
 	assert(values.rows*values.cols == (int)size());
-	Pixel &p = pixels[row*width + col];
-	p.assign(values.begin(), values.end());
+	Value *p = pixels[row*width + col];
+	std::copy(values.begin(), values.end(), p);
 
 	for (size_t i = 0; i < size(); ++i)
 		bands[i](row, col) = p[i];
@@ -236,6 +354,7 @@ void multi_img::setPixel(unsigned int row, unsigned int col,
 void multi_img::setBand(unsigned int band, const Band &data,
 						const cv::Mat1b &mask)
 {
+	detach();
 	assert(band < size());
 	assert(data.rows == height && data.cols == width);
 	Band &b = bands[band];
@@ -251,12 +370,12 @@ void multi_img::setBand(unsigned int band, const Band &data,
 		data.copyTo(b, mask);
 		for (int i = 0; bit != b.end(); ++bit, ++dit, ++mit, ++i)
 			if ((*mit > 0)&&(*dit == 0))
-				pixels[i][band] = *bit;
+				pixels(i, band) = *bit;
 	} else {
 		data.copyTo(b);
 		for (int i = 0; bit != b.end(); ++bit, ++dit, ++i) {
 			if ((*dit == 0))
-				pixels[i][band] = *bit;
+				pixels(i, band) = *bit;
 		}
 	}
 }
@@ -294,6 +413,7 @@ void multi_img::setSegment(const std::vector<cv::Mat_<Value> > &values,
 
 void multi_img::setTo(const Pixel &p)
 {
+	detach();
 	assert(p.size() == size());
 	for (size_t i = 0; i < size(); ++i)
 		bands[i].setTo(p[i]);
@@ -301,13 +421,8 @@ void multi_img::setTo(const Pixel &p)
 
 void multi_img::applyCache()
 {
-	for (unsigned int d = 0; d < size(); ++d) {
-		Band &dst = bands[d];
-		Band::iterator it;
-		unsigned int i;
-		for (it = dst.begin(), i = 0; it != dst.end(); it++, i++)
-			*it = pixels[i][d];
-	}
+	detach();
+	bandsFromCache(cv::Rect(0, 0, width, height));
 	// cache data is now consistent with band data
 	dirty.setTo(0);
 	anydirt = false;
@@ -379,13 +494,9 @@ cv::PCA multi_img::pca(unsigned int components) const
 	// make sure cache is there
 	rebuildPixels(true);
 
-	// create input matrix
-    cv::Mat_<Value> input(size(), (int)pixels.size());
-	for (size_t i = 0; i < pixels.size(); ++i) {
-		cv::Mat_<Value> in(pixels[i]);
-        cv::Mat_<Value> out(input.col((int)i));
-		in.copyTo(out);
-	}
+	// create input matrix (one column per pixel)
+	cv::Mat_<Value> input;
+	cv::transpose(pixels, input);
 
 	// perform PCA
 	cv::PCA ret(input, cv::noArray(), CV_PCA_DATA_AS_COL, (int)components);
@@ -400,9 +511,9 @@ multi_img multi_img::project(const cv::PCA &pca) const
 	rebuildPixels(true);
 
 	// write
-	for (size_t i = 0; i < ret.pixels.size(); ++i) {
-		cv::Mat_<Value> input(pixels[i]);
-		cv::Mat_<Value> output(ret.pixels[i]);
+	for (int i = 0; i < ret.pixels.rows; ++i) {
+		cv::Mat_<Value> input((int)size(), 1, pixels[i]);
+		cv::Mat_<Value> output((int)ret.size(), 1, ret.pixels[i]);
 		pca.project(input, output);
 	}
 
@@ -441,6 +552,7 @@ multi_img::Pixel multi_img::backProject(const Pixel &p, const cv::PCA &pca)
 
 void multi_img::clamp()
 {
+	detach();
 	for (unsigned int d = 0; d < size(); ++d) {
 		Band &b = bands[d];
 		cv::max(b, minval, b);
@@ -455,6 +567,8 @@ void multi_img::data_rescale(Value newminval, Value newmaxval)
 	if (minval == newminval && maxval == newmaxval)
 		return;
 
+	detach();
+
 	Value scale = (newmaxval - newminval)/(maxval - minval);
 	for (size_t d = 0; d < size(); ++d) {
 		Band &b = bands[d];
@@ -488,6 +602,7 @@ void multi_img::data_stretch()
 
 void multi_img::data_stretch_single(Value newmin, Value newmax)
 {
+	detach();
 	if (newmin != newmax) {
 		minval = newmin;
 		maxval = newmax;
@@ -512,6 +627,7 @@ void multi_img::data_stretch_single(Value newmin, Value newmax)
 
 void multi_img::flip(int flipCode)
 {
+	detach();
 	for (size_t i = 0; i < size(); ++i)
 		cv::flip(bands[i], bands[i], flipCode);
 
@@ -537,9 +653,8 @@ void multi_img::transpose()
 void multi_img::normalize_magnitudes()
 {
 	rebuildPixels(true);
-	std::vector<Pixel>::iterator it;
-	for (it = pixels.begin(); it != pixels.end(); ++it) {
-		cv::Mat_<Value> p(*it);
+	for (int i = 0; i < pixels.rows; ++i) {
+		cv::Mat_<Value> p = pixels.row(i);
 		double n = cv::norm(p, cv::NORM_L2);
 		if (n == 0.)
 			n = 1.;
@@ -550,6 +665,7 @@ void multi_img::normalize_magnitudes()
 
 void multi_img::apply_logarithm()
 {
+	detach();
 	for (size_t i = 0; i < size(); ++i) {
 		// will assign large negative value to 0 pixels
 		cv::log(bands[i], bands[i]);
@@ -567,6 +683,7 @@ void multi_img::apply_logarithm()
 void multi_img::blur(cv::Size ksize, double sigmaX, double sigmaY,
 					 int borderType)
 {
+	detach();
 	for (size_t i = 0; i < size(); ++i) {
 		cv::GaussianBlur(bands[i], bands[i], ksize, sigmaX, sigmaY, borderType);
 	}
@@ -16,6 +16,7 @@
 
 #ifdef WITH_OPENCV2 // theoretically, vole could be built w/o opencv..
 
+#include <atomic>
 #include <cfloat>
 #include <vector>
 #include <sstream>
@@ -31,11 +32,7 @@
 class Illuminant;
 
 // FIXME what a mess
-class Grad;
-class Log;
-class NormL2;
 class Clamp;
-class Illumination;
 class PcaProjection;
 class MultiImg2BandMat;
 class GradientCuda;
@@ -55,12 +52,7 @@ class PcaTbb;
 	friend class DetermineRange;\
 	friend class Band2QImageTbb;\
 	friend class RescaleTbb;\
-	friend class Resize; \
-	friend class Grad;\
-	friend class Log;\
-	friend class NormL2;\
 	friend class Clamp;\
-	friend class Illumination;\
 	friend class PcaProjection;\
 	friend class MultiImg2BandMat;\
 	friend class GradientCuda;\
@@ -152,6 +144,27 @@ public:
 	/// returns the roi part of the given band
 	virtual void scopeBand(const Band &source, const cv::Rect &roi, Band &target) const = 0;
 
+	/// returns the roi part of band number band
+	/** Implementations that keep their data out of core override this to
+		only fetch the data within the roi. */
+	virtual void getScopedBand(size_t band, const cv::Rect &roi, Band &target) const
+	{
+		Band full;
+		getBand(band, full);
+		scopeBand(full, roi, target);
+	}
+
+	/// returns the roi part of all bands
+	/** Implementations override this when fetching bands together is cheaper
+		than fetching them one by one. */
+	virtual void getScopedBands(const cv::Rect &roi,
+								std::vector<Band> &target) const
+	{
+		target.resize(size());
+		for (size_t i = 0; i < target.size(); ++i)
+			getScopedBand(i, roi, target[i]);
+	}
+
 	/// minimum and maximum values (by data format, not actually observed data!)
 	Value minval, maxval;
 
@@ -208,6 +221,48 @@ public:
 	/** @note Pixel will always be a std::vector. You can count on this. **/
 	typedef std::vector<Value> Pixel;
 
+	/// read-only view on the spectral data of a single pixel.
+	/** The pixel cache is one contiguous buffer in BIP (band interleaved by
+		pixel) layout. A PixelView points into that buffer and does not own
+		any data. It stays valid until the cache is re-allocated (e.g. by
+		resetPixels(true) or when the number of bands changes).
+		It offers the read-only part of the Pixel interface, so most code
+		written against Pixel works unchanged. A Pixel converts implicitly
+		into a PixelView, so functions taking a PixelView accept both.
+	**/
+	class PixelView {
+	public:
+		typedef Value value_type;
+		typedef const Value* iterator;
+		typedef const Value* const_iterator;
+
+		PixelView() : ptr(0), len(0) {}
+		PixelView(const Value *data, size_t size) : ptr(data), len(size) {}
+		PixelView(const Pixel &p) : ptr(p.empty() ? 0 : &p[0]), len(p.size())
+		{}
+
+		inline const Value& operator[](size_t d) const
+		{ assert(d < len); return ptr[d]; }
+
+		inline const Value* data() const { return ptr; }
+		inline size_t size() const { return len; }
+		inline bool empty() const { return len == 0; }
+		inline const_iterator begin() const { return ptr; }
+		inline const_iterator end() const { return ptr + len; }
+
+		/// OpenCV column vector header around the data (no data copy!)
+		/** @note OpenCV ignores const, you must not write into the result. */
+		inline cv::Mat_<Value> mat() const
+		{ return cv::Mat_<Value>((int)len, 1, const_cast<Value*>(ptr)); }
+
+		/// copy into an owning Pixel
+		inline operator Pixel() const { return Pixel(ptr, ptr + len); }
+
+	private:
+		const Value *ptr;
+		size_t len;
+	};
+
 //@}
 
 	enum NormMode {
@@ -231,20 +286,39 @@ public:
 	multi_img(int height, int width, unsigned int size);
 
 	/// copy constructor
-	/** @arg omitCache only copy the image data, but start with empty cache
+	/** Band data is shared copy-on-write (see detach()) and the pixel cache
+		starts empty, to be rebuilt on demand. So this is cheap.
 	*/
-	multi_img(const multi_img &, bool omitCache = false);
+	multi_img(const multi_img &);
+
+	/// move constructor, a is left empty
+	multi_img(multi_img &&a);
 
-	/// reference (!!) a spatial region of interest (with own cache!)
+	/// spatial region of interest (own cache, bands shared copy-on-write)
 	multi_img(const multi_img_base &a, const cv::Rect &roi);
 
-	/// reference (!!) a band subrange including both ends (with own cache!)
+	/// band subrange including both ends (own cache, bands shared copy-on-write)
 	multi_img(const multi_img &a, unsigned int start, unsigned int end);
 
+#ifdef WITH_BOOST
+	/// reference (!!) externally provided band data (with own cache!)
+	/** Bands may be headers into memory not owned by OpenCV, e.g. a file
+		mapping. That memory is kept alive by @arg backing for as long as
+		this image or any image referencing its bands exists. It has to be
+		writable, as image operations work in-place on band data.
+	*/
+	multi_img(const std::vector<Band> &bands,
+			  const std::vector<BandDesc> &meta,
+			  const boost::shared_ptr<void> &backing);
+#endif
+
 	/// assignment operator
-	/** @note A copy of the image (including cache) is created **/
+	/** @note Band data is shared copy-on-write, the cache starts empty **/
 	multi_img & operator=(const multi_img &);
 
+	/// move assignment operator, a is left empty
+	multi_img & operator=(multi_img &&a);
+
 	/** reads in and processes either
 		(a) an image file containing one or several color channels
 		(b) a descriptor file that contains a file list (see read_filelist)
@@ -281,25 +355,25 @@ public:
 	{ assert(band < size()); return bands[band]; }
 
 	/// returns spectral data of a single pixel
-	inline const Pixel& operator()(unsigned int row, unsigned int col) const
+	inline PixelView operator()(unsigned int row, unsigned int col) const
 	{	assert((int)row < height && (int)col < width);
 		if (anydirt && dirty(row, col))
 			rebuildPixel(row, col);
-		return pixels[row*width + col];
+		return PixelView(pixels[row*width + col], size());
 	}
 
 	/// returns spectral data of a single pixel
-	inline const Pixel& operator()(cv::Point pt) const
+	inline PixelView operator()(cv::Point pt) const
 	{ return operator ()(pt.y, pt.x); }
 
 	/// returns spectral data of a single pixel (only if *no* pixel is dirty!)
-	inline const Pixel& atIndex(unsigned int idx) const
+	inline PixelView atIndex(unsigned int idx) const
 	{	assert(!anydirt);
-		return pixels[idx];
+		return PixelView(pixels[idx], size());
 	}
 
 	/// returns spectral data of a segment (using mask)
-	std::vector<const Pixel*> getSegment(const cv::Mat1b &mask);
+	std::vector<PixelView> getSegment(const cv::Mat1b &mask);
 	/// returns copied spectral data of a segment (using mask)
 	std::vector<Pixel> getSegmentCopy(const cv::Mat1b &mask);
 
@@ -356,6 +430,17 @@ public:
 	/// rebuild a single pixel (inefficient if many pixels are processed)
 	void rebuildPixel(unsigned int row, unsigned int col) const;
 
+	/// distance between two consecutive pixels in the cache (in Values)
+	/** The cache is padded such that every pixel starts at a 16 byte
+		boundary (SSE alignment). **/
+	inline size_t pixelStride() const { return pixels.step1(); }
+
+	/// pixel cache with one pixel per row (only if *no* pixel is dirty!)
+	/** Pixel i is in row i, i.e. at position (i % width, i / width).
+		@note OpenCV ignores const, you must not write into the result. */
+	inline const cv::Mat_<Value>& pixelMatrix() const
+	{ assert(!anydirt); return pixels; }
+
 //@}
 
 /** @name Data export and conversion **/
@@ -374,6 +459,14 @@ public:
 	std::vector<std::vector<unsigned short> >
 	export_ushort(bool useDataRange = false) const;
 
+	/// returns all pixels in one matrix, one pixel per row
+	/** Values are quantized like in export_ushort(), but read directly from
+		the bands (the pixel cache is not needed) in parallel.
+		@param align Row length is padded with zeros to a multiple of align
+	**/
+	cv::Mat_<unsigned short>
+	export_ushort_mat(bool useDataRange = false, int align = 1) const;
+
 #ifdef WITH_QT
 	/// return QImage of specific band
 	QImage export_qt(unsigned int band) const;
@@ -383,8 +476,8 @@ public:
 	cv::Mat_<cv::Vec3f> bgr() const;
 
 	/// return sRGB color space representation of a multispectral pixel
-	cv::Vec3f bgr(const Pixel &p) const;
-	static cv::Vec3f bgr(const Pixel &p, const std::vector<BandDesc> &meta,
+	cv::Vec3f bgr(const PixelView &p) const;
+	static cv::Vec3f bgr(const PixelView &p, const std::vector<BandDesc> &meta,
 						 Value maxval);
 
 //@}
@@ -540,8 +633,8 @@ public:
 
 	/// helper function to create XYZ color space representation
 	/// of a multispectral pixel
-	void pixel2xyz(const Pixel &p, cv::Vec3f &xyz) const;
-	static void pixel2xyz(const Pixel &p, cv::Vec3f &xyz, 
+	void pixel2xyz(const PixelView &p, cv::Vec3f &xyz) const;
+	static void pixel2xyz(const PixelView &p, cv::Vec3f &xyz,
 		size_t dim, const std::vector<BandDesc> &meta, Value maxval);
 
 	/// helper function to do conversion from xyz to sRGB color space
@@ -564,13 +657,38 @@ protected:
 	/// write back pixel cache into band data
 	void applyCache();
 
+	/// transpose band data of a region into the pixel cache
+	/** Works on tiles of pixels x bands to keep both the band rows read and
+		the cache lines written in L1. Does not touch the dirty flags. **/
+	void cacheFromBands(const cv::Rect &region) const;
+
+	/// transpose pixel cache of a region back into the band data
+	/** Counterpart to cacheFromBands(). Does not touch the dirty flags. **/
+	void bandsFromCache(const cv::Rect &region);
+
 	/// simple data structure initialization
 	void init(int height, int width, unsigned int size,
 			  Value minval = MULTI_IMG_MIN_DEFAULT,
 			  Value maxval = MULTI_IMG_MAX_DEFAULT);
 
+	/// get own copy of band data before it is written in-place
+	/** Copies and views of an image share its band data. Both are marked,
+		whichever is written first clones its bands. Call this before any
+		in-place modification of the bands. **/
+	void detach();
+
+
 	std::vector<Band> bands;
-	mutable std::vector<Pixel> pixels;
+	/// bands may be referenced by another image (see detach())
+	/** Set on the source of a copy or view too, which may be read by several
+		threads at once, hence atomic. **/
+	mutable std::atomic<bool> sharedBands{false};
+#ifdef WITH_BOOST
+	/// owner of external band data, if any (see constructor)
+	boost::shared_ptr<void> backing;
+#endif
+	/// pixel cache, one row per pixel (BIP layout, rows padded, see pixelStride)
+	mutable cv::Mat_<Value> pixels;
 	mutable cv::Mat1b dirty;
 	mutable bool anydirt;
 
@@ -47,9 +47,9 @@ multi_img multi_img::spec_rescale(unsigned int newsize) const
 	rebuildPixels();
 	for (int row = 0; row < height; ++row) {
 		for (int col = 0; col < width; ++col) {
-			/// delegate resizing to opencv, using mat headers over vectors
-			cv::Mat_<Value> src(pixels[row*width + col]),
-			                dst(ret.pixels[row*width + col]);
+			/// delegate resizing to opencv, using mat headers over the cache
+			cv::Mat_<Value> src((int)size(), 1, pixels[row*width + col]),
+			                dst((int)newsize, 1, ret.pixels[row*width + col]);
 			cv::resize(src, dst, cv::Size(1, newsize));
 		}
 	}
@@ -74,7 +74,7 @@ multi_img multi_img::spec_rescale(unsigned int newsize) const
 	return ret;
 }
 
-void multi_img::pixel2xyz(const Pixel &p, cv::Vec3f &v, 
+void multi_img::pixel2xyz(const PixelView &p, cv::Vec3f &v,
 	size_t dim, const std::vector<BandDesc> &meta, Value maxval)
 {
 	int idx;
@@ -115,7 +115,7 @@ void multi_img::pixel2xyz(const Pixel &p, cv::Vec3f &v,
 	_mm_store_ss(&v[0], res_reg);
 }
 
-void multi_img::pixel2xyz(const Pixel &p, cv::Vec3f &v) const
+void multi_img::pixel2xyz(const PixelView &p, cv::Vec3f &v) const
 {
 	pixel2xyz(p, v, p.size(), meta, maxval);
 }
@@ -205,7 +205,7 @@ cv::Mat_<cv::Vec3f> multi_img::bgr() const
 	return bgr;
 }
 
-cv::Vec3f multi_img::bgr(const Pixel &p) const
+cv::Vec3f multi_img::bgr(const PixelView &p) const
 {
 	cv::Vec3f xyz, ret;
 	pixel2xyz(p, xyz);
@@ -213,7 +213,7 @@ cv::Vec3f multi_img::bgr(const Pixel &p) const
 	return ret;
 }
 
-cv::Vec3f multi_img::bgr(const Pixel &p,
+cv::Vec3f multi_img::bgr(const PixelView &p,
 	const std::vector<BandDesc> &meta, Value maxval)
 {
 	cv::Vec3f xyz, ret;
@@ -224,6 +224,7 @@ cv::Vec3f multi_img::bgr(const Pixel &p,
 
 void multi_img::apply_illuminant(const Illuminant& il, bool remove)
 {
+	detach();
 	if (remove) {
 		for (size_t i = 0; i < size(); ++i)
 			bands[i] /= (Value)il.at(meta[i].center);
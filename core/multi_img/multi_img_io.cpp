@@ -12,6 +12,9 @@
 #include "qtopencv.h"
 
 #include <opencv2/highgui/highgui.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -32,10 +35,46 @@ multi_img::export_ushort(bool useDataRange) const
 	std::vector<std::vector<unsigned short> >
 			ret(width*height, std::vector<unsigned short>(size()));
 
-	std::vector<Pixel>::const_iterator it = pixels.begin();
-	for (size_t i = 0; it != pixels.end(); ++it, ++i)
+	for (int i = 0; i < pixels.rows; ++i) {
+		const Value *p = pixels[i];
 		for (size_t d = 0; d < size(); ++d)
-			ret[i][d] = ((*it)[d] - range.min) * scale;
+			ret[i][d] = (p[d] - range.min) * scale;
+	}
+
+	return ret;
+}
+
+cv::Mat_<unsigned short>
+multi_img::export_ushort_mat(bool useDataRange, int align) const
+{
+	Range range(minval, maxval);
+	if (useDataRange) {
+		// determine actual minval/maxval
+		range = data_range();
+	}
+
+	const Value scale = 65535.0/(range.max - range.min);
+	const int D = size();
+	const int cols = (D + align - 1) / align * align;
+	cv::Mat_<unsigned short> ret(width*height, cols, (unsigned short)0);
+
+	/* transpose in tiles of a few pixels, so the rows written for each band
+	   stay in cache */
+	const int tile = 64;
+	tbb::parallel_for(tbb::blocked_range<int>(0, height),
+		[&](const tbb::blocked_range<int> &r) {
+		for (int y = r.begin(); y != r.end(); ++y) {
+			for (int x0 = 0; x0 < width; x0 += tile) {
+				int x1 = std::min(x0 + tile, width);
+				unsigned short *dst = ret[y*width + x0];
+				for (int d = 0; d < D; ++d) {
+					const Value *src = bands[d][y];
+					for (int x = x0; x < x1; ++x)
+						dst[(x - x0)*cols + d] = (src[x] - range.min) * scale;
+				}
+			}
+		}
+	});
 
 	return ret;
 }
@@ -138,7 +177,7 @@ void multi_img::read_image(const std::vector<std::string> &files,
 
 	/* invalidate pixel cache as pixel length has changed
 	   This step is _mandatory_ also to initialize cache containers */
-	pixels.clear();
+	pixels.release();
 	resetPixels();
 
 	/* add meta information if present. */
@@ -5,7 +5,6 @@
 #include <opencv2/core/core.hpp>
 
 #include <multi_img.h>
-#include <multi_img/illuminant.h>
 
 #include "multi_img_tbb.h"
 #include "cieobserver.h"
@@ -13,47 +12,31 @@
 
 void RebuildPixels::operator()(const tbb::blocked_range<size_t> &r) const
 {
-	for (size_t d = r.begin(); d != r.end(); ++d) {
-		multi_img::Band &src = multi.bands[d];
-		if (src.empty()) {
-			return;
-		}
-		multi_img::Band::const_iterator it; size_t i;
-		for (it = src.begin(), i = 0; it != src.end(); ++it, ++i)
-			multi.pixels[i][d] = *it;
-	}
+	if (multi.empty() || multi.bands[0].empty())
+		return;
+
+	multi.cacheFromBands(cv::Rect(0, (int)r.begin(),
+	                              multi.width, (int)(r.end() - r.begin())));
 }
 
 void RebuildPixels::operator()(const tbb::blocked_range2d<int> &r) const
 {
-	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
-		int loc = row * multi.width;
-		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
-			for (size_t d = 0; d < multi.size(); ++d)
-				multi.pixels[loc + col][d] = multi.bands[d](row, col);
-		}
-	}
+	multi.cacheFromBands(cv::Rect(r.cols().begin(), r.rows().begin(),
+	                              r.cols().end() - r.cols().begin(),
+	                              r.rows().end() - r.rows().begin()));
 }
 
 void ApplyCache::operator()(const tbb::blocked_range<size_t> &r) const
 {
-	for (size_t d = r.begin(); d != r.end(); ++d) {
-		multi_img::Band &dst = multi.bands[d];
-		multi_img::Band::iterator it; size_t i;
-		for (it = dst.begin(), i = 0; it != dst.end(); ++it, ++i)
-			*it = multi.pixels[i][d];
-	}
+	multi.bandsFromCache(cv::Rect(0, (int)r.begin(),
+	                              multi.width, (int)(r.end() - r.begin())));
 }
 
 void ApplyCache::operator()(const tbb::blocked_range2d<int> &r) const
 {
-	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
-		int loc = row * multi.width;
-		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
-			for (size_t d = 0; d < multi.size(); ++d)
-				multi.bands[d](row, col) = multi.pixels[loc + col][d];
-		}
-	}
+	multi.bandsFromCache(cv::Rect(r.cols().begin(), r.rows().begin(),
+	                              r.cols().end() - r.cols().begin(),
+	                              r.rows().end() - r.rows().begin()));
 }
 
 void DetermineRange::operator()(const tbb::blocked_range<size_t> &r)
@@ -130,46 +113,6 @@ void Bgr::operator()(const tbb::blocked_range2d<int> &r) const
 
 
 
-void Grad::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-	for (size_t i = r.begin(); i != r.end(); ++i) {
-		//target.bands[i] = source.bands[i + 1] - source.bands[i];
-		cv::subtract(source.bands[i + 1], source.bands[i], target.bands[i]);
-		if (!source.meta[i].empty && !source.meta[i + 1].empty) {
-			target.meta[i] = multi_img::BandDesc(
-				source.meta[i].center, source.meta[i + 1].center);
-		}
-	}
-}
-
-
-void Log::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-	{
-		for (size_t i = r.begin(); i != r.end(); ++i) {
-			cv::log(source.bands[i], target.bands[i]);
-			//target.bands[i] = cv::max(target.bands[i], 0.);
-			cv::max(target.bands[i], 0., target.bands[i]);
-		}
-	}
-}
-
-void NormL2::operator()(const tbb::blocked_range2d<int> &r) const
-{
-	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
-		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
-			cv::Mat_<multi_img::Value> src(
-						source.pixels[row * source.width + col], false);
-			cv::Mat_<multi_img::Value> dst(
-						target.pixels[row * source.width + col], false);
-			double n = cv::norm(src, cv::NORM_L2);
-			if (n == 0.)
-				n = 1.;
-			dst = src / n;
-		}
-	}
-}
-
 void Clamp::operator ()(const tbb::blocked_range<size_t> &r) const
 {
 	for (size_t d = r.begin(); d != r.end(); ++d) {
@@ -180,29 +123,12 @@ void Clamp::operator ()(const tbb::blocked_range<size_t> &r) const
 	}
 }
 
-void Illumination::operator ()(const tbb::blocked_range<size_t> &r) const
-{
-   if (remove) {
-	   for (size_t d = r.begin(); d != r.end(); ++d) {
-		   multi_img::Band &src = source.bands[d];
-		   multi_img::Band &tgt = target.bands[d];
-		   tgt = src / (multi_img::Value)il.at(source.meta[d].center);
-	   }
-   } else {
-	   for (size_t d = r.begin(); d != r.end(); ++d) {
-		   multi_img::Band &src = source.bands[d];
-		   multi_img::Band &tgt = target.bands[d];
-		   tgt = src * (multi_img::Value)il.at(source.meta[d].center);
-	   }
-   }
-}
-
-
 void PcaProjection::operator ()(const tbb::blocked_range<size_t> &r) const
 {
 	for (size_t i = r.begin(); i != r.end(); ++i) {
 		cv::Mat_<multi_img::Value> input = source.col(i);
-		cv::Mat_<multi_img::Value> output(target.pixels[i], false);
+		cv::Mat_<multi_img::Value> output((int)target.size(), 1,
+		                                  target.pixels[(int)i]);
 		pca.project(input, output);
 	}
 }
@@ -217,16 +143,3 @@ void MultiImg2BandMat::operator ()(const tbb::blocked_range<size_t> &r) const
 			target(d, i) = *it;
 	}
 }
-
-void Resize::operator()(const tbb::blocked_range2d<int> &r) const
-{
-	for (int row = r.rows().begin(); row != r.rows().end(); ++row) {
-		for (int col = r.cols().begin(); col != r.cols().end(); ++col) {
-			cv::Mat_<multi_img::Value> src(
-			            source.pixels[row * source.width + col], false);
-			cv::Mat_<multi_img::Value> dst(
-			            target.pixels[row * source.width + col], false);
-			cv::resize(src, dst, cv::Size(1, newsize));
-		}
-	}
-}
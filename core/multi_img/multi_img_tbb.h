@@ -2,7 +2,7 @@
 #define MULTI_IMG_TBB_H
 
 
-// TODO doc
+// fill pixel cache from band data, range is over image rows
 class RebuildPixels {
 public:
 	RebuildPixels(multi_img &multi) : multi(multi) {}
@@ -13,7 +13,7 @@ private:
 	multi_img &multi;
 };
 
-// TODO doc
+// write pixel cache back into band data, range is over image rows
 class ApplyCache {
 public:
 	ApplyCache(multi_img &multi) : multi(multi) {}
@@ -67,42 +67,6 @@ private:
 	float greensum;
 };
 
-// TODO doc
-class Grad {
-public:
-	Grad(multi_img &source, multi_img &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-
-private:
-	multi_img &source;
-	multi_img &target;
-};
-
-// TODO doc
-class Log {
-public:
-	Log(multi_img &source, multi_img &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-
-private:
-	multi_img &source;
-	multi_img &target;
-};
-
-// TODO doc
-class NormL2 {
-public:
-	NormL2(multi_img &source, multi_img &target)
-		: source(source), target(target) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
-
-private:
-	multi_img &source;
-	multi_img &target;
-};
-
 // TODO doc
 class Clamp {
 public:
@@ -113,19 +77,6 @@ private:
 	multi_img &target;
 };
 
-// TODO doc
-class Illumination {
-public:
-	Illumination(multi_img &source, multi_img &target, Illuminant& il, bool remove)
-		: source(source), target(target), il(il), remove(remove) {}
-	void operator()(const tbb::blocked_range<size_t> &r) const;
-private:
-	multi_img &source;
-	multi_img &target;
-	Illuminant &il;
-	bool remove;
-};
-
 class PcaProjection {
 public:
 	PcaProjection(cv::Mat_<multi_img::Value> &source, multi_img &target, cv::PCA &pca)
@@ -148,15 +99,4 @@ private:
 	cv::Mat_<multi_img::Value> &target;
 };
 
-class Resize {
-public:
-	Resize(multi_img &source, multi_img &target, size_t newsize)
-		: source(source), target(target), newsize(newsize) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
-private:
-	multi_img &source;
-	multi_img &target;
-	size_t newsize;
-};
-
 #endif // MULTI_IMG_TBB_H
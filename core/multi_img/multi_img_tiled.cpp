@@ -0,0 +1,342 @@
+#include "multi_img_tiled.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <iostream>
+
+#define TILE MULTI_IMG_TILED_SIZE
+
+static bool seekStorage(FILE *file, long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+multi_img_tiled::multi_img_tiled(const std::vector<std::string> &files,
+								 const std::vector<BandDesc> &descs,
+								 size_t cacheLimit)
+	: storage(NULL), nbands(0), tilesX(0), tilesY(0), blocks(0),
+	  cachedBytes(0), cacheLimit(cacheLimit), pendingBlock(-1)
+{
+	int channels = 0;
+	width = 0;
+	height = 0;
+
+	/* default to our favorite range */
+	minval = MULTI_IMG_MIN_DEFAULT;
+	maxval = MULTI_IMG_MAX_DEFAULT;
+
+	storage = tmpfile();
+	if (!storage) {
+		std::cerr << "ERROR: Could not create temporary file for image data"
+				  << std::endl;
+		return;
+	}
+
+	for (size_t fi = 0; fi < files.size(); ++fi) {
+		cv::Mat src = cv::imread(files[fi], -1); // flag -1: preserve format
+
+		if (src.empty()) {
+			std::cerr << "ERROR: Failed to load " << files[fi] << std::endl;
+			continue;
+		}
+
+		// test spatial size
+		if (width > 0 && (src.cols != width || src.rows != height)) {
+			std::cerr << "ERROR: Size mismatch for image "
+					  << files[fi] << std::endl;
+			continue;
+		}
+
+		// find original data range, we assume minimum is 0
+		Value srcmaxval = 0.;
+		// we expect CV_8U, CV_16U or floating point in [0..1]
+		switch (src.depth()) {
+		case CV_8U:	 { srcmaxval = 255.; break; }
+		case CV_16U: { srcmaxval = 65535.; break; }
+		case CV_32F:
+		case CV_64F: { srcmaxval = 1.; break; }
+		default: // we don't handle other formats!
+			std::cerr << "Input data type of " << files[fi]
+					  << " is not compatible!" << std::endl;
+			continue;
+		}
+
+		// set spatial size
+		width = src.cols;
+		height = src.rows;
+		tilesX = (width + TILE - 1) / TILE;
+		tilesY = (height + TILE - 1) / TILE;
+
+		// split & store every channel as a band
+		channels = src.channels();
+		if (channels > 1) {
+			std::vector<cv::Mat> splitted(channels);
+			cv::split(src, splitted);
+			for (size_t c = 0; c < splitted.size(); ++c)
+				storeBand(nbands++, splitted[c], srcmaxval);
+		} else {
+			storeBand(nbands++, src, srcmaxval);
+		}
+
+		std::cout << "Added " << files[fi] << ":\t" << channels
+			 << (channels == 1 ? " channel, " : " channels, ")
+			 << (src.depth() == CV_16U ? 16 : 8) << " bits";
+		if (descs.empty() || descs[fi].empty)
+			std::cout << std::endl;
+		else
+			std::cout << ", " << descs[fi].center << " nm" << std::endl;
+	}
+	blocks = (nbands + MULTI_IMG_TILED_BANDS - 1) / MULTI_IMG_TILED_BANDS;
+
+	/* add meta information if present. */
+	if (!descs.empty()) {
+		assert(meta.size() + descs.size() == nbands);
+		meta.insert(meta.end(), descs.begin(), descs.end());
+	} else {
+		/* Hack: when input was single RGB image, we assume RGB peak wavelengths
+				 (from Hamamatsu) to enable re-calculation of RGB image */
+		// NOTE: for this to work as expected, incoming data still needs to
+		//	have linear response, which is not true for typical RGB imaging
+		if (files.size() == 1 && channels == 3) {
+			meta.push_back(BandDesc(460));
+			meta.push_back(BandDesc(540));
+			meta.push_back(BandDesc(620));
+		} else {
+			meta.resize(nbands);
+		}
+	}
+
+	if (nbands)
+		std::cout << "Total of " << nbands << " bands. "
+			 << "Spatial size: " << width << "x" << height
+			 << "   (" << nbands*width*height*sizeof(Value)/1048576.
+			 << " MB, " << tilesX*tilesY*blocks << " chunks)" << std::endl;
+}
+
+multi_img_tiled::~multi_img_tiled()
+{
+	if (storage)
+		fclose(storage);
+}
+
+size_t multi_img_tiled::size() const
+{
+	return nbands;
+}
+
+bool multi_img_tiled::empty() const
+{
+	return nbands == 0;
+}
+
+void multi_img_tiled::storeBand(size_t band, const cv::Mat &src,
+								Value srcmaxval)
+{
+	// convert to right datatype, scaling
+	Band tmp;
+	src.convertTo(tmp, ValueType);
+
+	// rescale data accordingly (we assume source minimum is 0)
+	if (minval == 0.) {
+		if (maxval != srcmaxval)
+			tmp *= maxval/srcmaxval;
+	} else {
+		Value scale = (maxval - minval)/srcmaxval;
+		tmp = tmp * scale + minval;
+	}
+
+	/* write each tile of the band into its chunk. Tiles at the image border
+	   are padded, so all chunks have the same size */
+	int block = band / MULTI_IMG_TILED_BANDS;
+	long long inChunk = (long long)(band % MULTI_IMG_TILED_BANDS)
+			* TILE * TILE * sizeof(Value);
+	Band tile(TILE, TILE);
+	for (int ty = 0; ty < tilesY; ++ty) {
+		for (int tx = 0; tx < tilesX; ++tx) {
+			cv::Rect region(tx*TILE, ty*TILE, TILE, TILE);
+			region &= cv::Rect(0, 0, width, height);
+			tile.setTo(0.f);
+			tmp(region).copyTo(tile(cv::Rect(0, 0, region.width, region.height)));
+
+			if (!seekStorage(storage, chunkOffset(ty*tilesX + tx, block) + inChunk)
+				|| fwrite(tile.ptr(), sizeof(Value), tile.total(), storage)
+				   != tile.total()) {
+				std::cerr << "ERROR: Failed to write image data to temporary "
+							 "file" << std::endl;
+				return;
+			}
+		}
+	}
+}
+
+long long multi_img_tiled::chunkOffset(int tile, int block) const
+{
+	// block-major, so the layout does not depend on the total band count
+	long long chunkSize = (long long)MULTI_IMG_TILED_BANDS
+			* TILE * TILE * sizeof(Value);
+	return ((long long)block * tilesX * tilesY + tile) * chunkSize;
+}
+
+multi_img_tiled::Band multi_img_tiled::fetchChunk(int tile, int block) const
+{
+	long long key = chunkOffset(tile, block);
+	tbb::mutex::scoped_lock lock(mutex);
+
+	std::map<long long, ChunkList::iterator>::iterator it = chunkIndex.find(key);
+	if (it != chunkIndex.end()) {
+		// move to front
+		chunks.splice(chunks.begin(), chunks, it->second);
+		return it->second->second;
+	}
+
+	Band chunk(MULTI_IMG_TILED_BANDS * TILE, TILE);
+	if (!seekStorage(storage, key)
+		|| fread(chunk.ptr(), sizeof(Value), chunk.total(), storage)
+		   != chunk.total()) {
+		/* short read happens for the padding of the last band block, which
+		   was never written. These bands do not exist, so we ignore it */
+		clearerr(storage);
+	}
+
+	chunks.push_front(std::make_pair(key, chunk));
+	chunkIndex[key] = chunks.begin();
+	cachedBytes += chunk.total() * sizeof(Value);
+
+	// always keep the new one
+	evictChunks(1);
+	return chunk;
+}
+
+void multi_img_tiled::evictChunks(size_t keep) const
+{
+	// least recently used first
+	while (cachedBytes > cacheLimit && chunks.size() > keep) {
+		cachedBytes -= chunks.back().second.total() * sizeof(Value);
+		chunkIndex.erase(chunks.back().first);
+		chunks.pop_back();
+	}
+}
+
+void multi_img_tiled::dropPending() const
+{
+	for (size_t i = 0; i < pendingBands.size(); ++i)
+		cachedBytes -= pendingBands[i].total() * sizeof(Value);
+	pendingBands.clear();
+	pendingBlock = -1;
+}
+
+void multi_img_tiled::getBand(size_t band, Band &data) const
+{
+	assert(band < nbands);
+	int block = band / MULTI_IMG_TILED_BANDS;
+	size_t inBlock = band % MULTI_IMG_TILED_BANDS;
+	{
+		tbb::mutex::scoped_lock lock(mutex);
+		if (block == pendingBlock && !pendingBands[inBlock].empty()) {
+			// hand out without copy, it is not requested again
+			data = pendingBands[inBlock];
+			cachedBytes -= data.total() * sizeof(Value);
+			pendingBands[inBlock] = Band();
+			return;
+		}
+		// not needed anymore, the block is read again below
+		dropPending();
+	}
+
+	/* callers typically request all bands one after another. Reading band by
+	   band would fetch each chunk of the block once per band, and the chunks
+	   of a large image do not stay in the cache in between.
+	   A band requested out of block order (another block, or a band of the
+	   pending block handed out before) costs a read of its whole block. */
+	std::vector<Band> bands(blockSize(block));
+	scopeBlock(block, cv::Rect(0, 0, width, height), &bands[0]);
+	data = bands[inBlock];
+	bands[inBlock] = Band();
+
+	size_t bytes = (bands.size() - 1) * width * height * sizeof(Value);
+	tbb::mutex::scoped_lock lock(mutex);
+	if (bytes <= cacheLimit) {
+		// pending bands count against the cache limit, chunks make room
+		dropPending();
+		pendingBands.swap(bands);
+		pendingBlock = block;
+		cachedBytes += bytes;
+		evictChunks(0);
+	}
+}
+
+void multi_img_tiled::scopeBand(const Band &source, const cv::Rect &roi, Band &target) const
+{
+	Band scoped(source, roi);
+	target = scoped.clone();
+}
+
+size_t multi_img_tiled::blockSize(int block) const
+{
+	return std::min<size_t>(MULTI_IMG_TILED_BANDS,
+							nbands - block * MULTI_IMG_TILED_BANDS);
+}
+
+void multi_img_tiled::scopeBlock(int block, const cv::Rect &roi, Band *target) const
+{
+	assert((roi & cv::Rect(0, 0, width, height)) == roi);
+
+	const size_t count = blockSize(block);
+	for (size_t i = 0; i < count; ++i)
+		target[i] = Band(roi.height, roi.width);
+	if (roi.area() == 0)
+		return;
+
+	int tx0 = roi.x / TILE, tx1 = (roi.x + roi.width - 1) / TILE;
+	int ty0 = roi.y / TILE, ty1 = (roi.y + roi.height - 1) / TILE;
+	for (int ty = ty0; ty <= ty1; ++ty) {
+		for (int tx = tx0; tx <= tx1; ++tx) {
+			cv::Rect tileRect(tx*TILE, ty*TILE, TILE, TILE);
+			cv::Rect region = tileRect & roi;
+
+			Band chunk = fetchChunk(ty*tilesX + tx, block);
+			for (size_t i = 0; i < count; ++i) {
+				Band tile = chunk.rowRange(i * TILE, (i + 1) * TILE);
+				tile(region - tileRect.tl()).copyTo(target[i](region - roi.tl()));
+			}
+		}
+	}
+}
+
+void multi_img_tiled::getScopedBands(const cv::Rect &roi,
+									 std::vector<Band> &target) const
+{
+	target.resize(nbands);
+	for (int block = 0; block < blocks; ++block)
+		scopeBlock(block, roi, &target[block * MULTI_IMG_TILED_BANDS]);
+}
+
+void multi_img_tiled::getScopedBand(size_t band, const cv::Rect &roi, Band &target) const
+{
+	assert(band < nbands);
+	assert((roi & cv::Rect(0, 0, width, height)) == roi);
+
+	target = Band(roi.height, roi.width);
+	if (roi.area() == 0)
+		return;
+
+	int block = band / MULTI_IMG_TILED_BANDS;
+	int inChunk = (band % MULTI_IMG_TILED_BANDS) * TILE;
+
+	// only visit tiles intersecting the roi
+	int tx0 = roi.x / TILE, tx1 = (roi.x + roi.width - 1) / TILE;
+	int ty0 = roi.y / TILE, ty1 = (roi.y + roi.height - 1) / TILE;
+	for (int ty = ty0; ty <= ty1; ++ty) {
+		for (int tx = tx0; tx <= tx1; ++tx) {
+			cv::Rect tileRect(tx*TILE, ty*TILE, TILE, TILE);
+			cv::Rect region = tileRect & roi;
+
+			Band chunk = fetchChunk(ty*tilesX + tx, block);
+			Band tile = chunk.rowRange(inChunk, inChunk + TILE);
+			tile(region - tileRect.tl()).copyTo(target(region - roi.tl()));
+		}
+	}
+}
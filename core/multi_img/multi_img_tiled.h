@@ -0,0 +1,105 @@
+#ifndef MULTI_IMG_TILED_H
+#define MULTI_IMG_TILED_H
+
+#include <multi_img.h>
+#include <tbb/mutex.h>
+#include <cstdio>
+#include <list>
+#include <map>
+
+/// spatial edge length of a tile in pixels
+#define MULTI_IMG_TILED_SIZE 256
+/// number of bands stored together in one chunk
+#define MULTI_IMG_TILED_BANDS 16
+/// default memory limit of the chunk cache in bytes
+#define MULTI_IMG_TILED_CACHE_DEFAULT (256 * 1048576)
+
+/** multi_img_base with bands kept in a chunked temporary file ("limited mode").
+	The image is read once and stored as chunks of one spatial tile times a
+	block of bands. A bounded LRU cache holds recently used chunks in memory.
+	Requests for a region (getScopedBand()) only touch the intersecting tiles,
+	so the cost of scoping an ROI is proportional to the ROI size.
+*/
+class multi_img_tiled : public multi_img_base {
+public:
+	/// reads in the files and writes their data into the chunk file
+	/** @arg cacheLimit maximum memory used for cached chunks (in bytes) */
+	multi_img_tiled(const std::vector<std::string> &files,
+					const std::vector<BandDesc> &descs,
+					size_t cacheLimit = MULTI_IMG_TILED_CACHE_DEFAULT);
+
+	/// closes (and thereby deletes) the chunk file
+	virtual ~multi_img_tiled();
+
+	/// returns number of bands
+	virtual size_t size() const;
+
+	/// returns true if image is uninitialized
+	virtual bool empty() const;
+
+	/// returns one band
+	virtual void getBand(size_t band, Band &data) const;
+
+	/// returns the roi part of the given band
+	virtual void scopeBand(const Band &source, const cv::Rect &roi, Band &target) const;
+
+	/// returns the roi part of band number band, reading only needed tiles
+	virtual void getScopedBand(size_t band, const cv::Rect &roi, Band &target) const;
+
+	/// returns the roi part of all bands, reading each needed chunk once
+	virtual void getScopedBands(const cv::Rect &roi,
+								std::vector<Band> &target) const;
+
+protected:
+	/// converts an input band to our value range and stores it
+	void storeBand(size_t band, const cv::Mat &src, Value srcmaxval);
+
+	/// returns chunk of given tile and band block, from cache or file
+	/** The chunk holds MULTI_IMG_TILED_BANDS consecutive tiles on top of
+		each other. It stays valid after eviction (reference counted). */
+	Band fetchChunk(int tile, int block) const;
+
+	/// fills the roi part of all bands of a band block into target
+	/** Each chunk intersecting the roi is fetched once, so a large roi
+		does not need to fit into the cache. */
+	void scopeBlock(int block, const cv::Rect &roi, Band *target) const;
+
+	/// evicts least recently used chunks until under cacheLimit
+	/** Keeps at least keep chunks. Needs mutex to be locked. */
+	void evictChunks(size_t keep) const;
+
+	/// releases the pending bands. Needs mutex to be locked.
+	void dropPending() const;
+
+	/// number of bands in a band block (the last one may be incomplete)
+	size_t blockSize(int block) const;
+
+	/// position of a tile/band chunk in the file (in bytes)
+	long long chunkOffset(int tile, int block) const;
+
+	/// file holding the chunks, removed automatically when closed
+	FILE *storage;
+	size_t nbands;
+	int tilesX, tilesY, blocks;
+
+	/// chunk cache, most recently used chunk in front
+	typedef std::list<std::pair<long long, Band> > ChunkList;
+	mutable ChunkList chunks;
+	mutable std::map<long long, ChunkList::iterator> chunkIndex;
+	/// memory used by cached chunks and pending bands (in bytes)
+	mutable size_t cachedBytes;
+	size_t cacheLimit;
+	/** bands of the last block read by getBand(), not yet requested.
+		Consecutive requests within a block are served from here. They are
+		counted in cachedBytes, so chunks are evicted to make room. */
+	mutable std::vector<Band> pendingBands;
+	mutable int pendingBlock;
+	/// guards cache and file access
+	mutable tbb::mutex mutex;
+
+private:
+	multi_img_tiled(const multi_img_tiled&);
+	multi_img_tiled& operator=(const multi_img_tiled&);
+};
+
+#endif // MULTI_IMG_TILED_H
@@ -0,0 +1,125 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace radix_sort_detail {
+
+/// map float bit pattern to unsigned integer of same order
+inline boost::uint32_t floatBits(float f)
+{
+	boost::uint32_t u;
+	if (f == 0.f) // -0 equals 0
+		f = 0.f;
+	std::memcpy(&u, &f, sizeof(u));
+	// negative: flip all bits, positive: flip sign bit
+	return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+template <typename T, typename Key>
+struct KeyLess {
+	KeyLess(Key key) : key(key) {}
+	bool operator()(const T &a, const T &b) const { return key(a) < key(b); }
+	Key key;
+};
+
+}
+
+/** Stable parallel radix sort of [first, last) by a float key.
+ *
+ * key(item) returns the float key of an item, items are sorted by ascending
+ * key. Equal keys keep their order, so the result does not depend on the
+ * number of threads. NaN keys end up at either end.
+ *
+ * LSD radix sort, 8 bits per pass. The items are split into blocks that are
+ * counted and scattered in parallel. Passes where all keys share the same
+ * digit are skipped. Small inputs are handed to std::stable_sort.
+ */
+template <typename T, typename Key>
+void radixSortFloat(T *first, T *last, Key key)
+{
+	using namespace radix_sort_detail;
+	typedef boost::uint32_t uint32;
+
+	const size_t n = last - first;
+	if (n < 4096) {
+		std::stable_sort(first, last, KeyLess<T, Key>(key));
+		return;
+	}
+
+	const size_t blockSize = 1 << 16;
+	const size_t blocks = (n + blockSize - 1) / blockSize;
+
+	std::vector<uint32> keys(n), keysTmp(n);
+	std::vector<T> tmp(n);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t i = r.begin(); i != r.end(); ++i)
+			keys[i] = floatBits(key(first[i]));
+	});
+
+	// counts and write offsets per block and digit
+	std::vector<size_t> hist(blocks * 256);
+
+	uint32 *srcKeys = &keys[0], *dstKeys = &keysTmp[0];
+	T *src = first, *dst = &tmp[0];
+	for (int shift = 0; shift < 32; shift += 8) {
+		std::fill(hist.begin(), hist.end(), 0);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, blocks, 1),
+			[&](const tbb::blocked_range<size_t> &r) {
+			for (size_t b = r.begin(); b != r.end(); ++b) {
+				size_t *h = &hist[b * 256];
+				size_t end = std::min(n, (b + 1) * blockSize);
+				for (size_t i = b * blockSize; i < end; ++i)
+					h[(srcKeys[i] >> shift) & 0xff]++;
+			}
+		});
+
+		// digit-major prefix sum keeps blocks (and thus items) in order
+		size_t offset = 0;
+		bool trivial = false;
+		for (int d = 0; d < 256; ++d) {
+			size_t count = 0;
+			for (size_t b = 0; b < blocks; ++b) {
+				size_t c = hist[b * 256 + d];
+				hist[b * 256 + d] = offset;
+				offset += c;
+				count += c;
+			}
+			if (count == n)
+				trivial = true;
+		}
+		if (trivial)
+			continue;
+
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, blocks, 1),
+			[&](const tbb::blocked_range<size_t> &r) {
+			for (size_t b = r.begin(); b != r.end(); ++b) {
+				size_t *h = &hist[b * 256];
+				size_t end = std::min(n, (b + 1) * blockSize);
+				for (size_t i = b * blockSize; i < end; ++i) {
+					size_t pos = h[(srcKeys[i] >> shift) & 0xff]++;
+					dstKeys[pos] = srcKeys[i];
+					dst[pos] = src[i];
+				}
+			}
+		});
+		std::swap(srcKeys, dstKeys);
+		std::swap(src, dst);
+	}
+
+	// odd number of passes: result is in the buffer
+	if (src != first) {
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+			[&](const tbb::blocked_range<size_t> &r) {
+			std::copy(src + r.begin(), src + r.end(), first + r.begin());
+		});
+	}
+}
+
+#endif // RADIX_SORT_H
@@ -51,9 +51,10 @@ typedef boost::unique_lock<SharedDataMutex> SharedDataLock;
 /** Lock that should be used by background worker thread to swap embedded raw
     pointer once the calculation of new version of data is finished. Note that
 	this should enforce usage of a simple variant of read-copy-update pattern.
-	Simple in a sense that there can be only one swapper thread, which is
-	expected to be background worker thread dispatching background tasks
-	from the queue. Also note that it is perfectly fine if background worker
+	Simple in a sense that there can be only one swapper thread per data at a
+	time, which is expected to be a background worker thread dispatching
+	background tasks from the queue (the queue does not run tasks writing
+	the same data concurrently). Also note that it is perfectly fine if background worker
 	modify locked data in-place instead of using RCU pattern - this might be 
 	reasonable if it involves assignment of only a couple of primitive values. */
 typedef boost::unique_lock<SharedDataMutex> SharedDataSwapLock;
@@ -32,7 +32,6 @@ Controller::Controller(const QString &filename,
       cm(nullptr),
 #endif
       dvc(nullptr),
-      queuethread(nullptr),
       subs(new Subscriptions)
 {
 	// reset internal ROI state tracking
@@ -195,6 +194,8 @@ void Controller::initGraphSegmentation()
 
 	connect(gsm, SIGNAL(alterLabelRequested(short,cv::Mat1b,bool)),
 	        lm, SLOT(alterLabel(short,cv::Mat1b,bool)));
+	connect(im, SIGNAL(imageUpdate(representation::t,SharedMultiImgPtr,bool)),
+	        gsm, SLOT(processImageUpdate(representation::t,SharedMultiImgPtr,bool)));
 	// (gsm seedingDone <-> bandDock seedingDone connection in initDocks)
 }
 
@@ -405,20 +406,16 @@ void Controller::unsubscribeRepresentation(QObject *subscriber,
 
 void Controller::startQueue()
 {
-	// start worker thread
-	//boost::ref h(queue);
-	queuethread = new boost::thread(boost::ref(queue));
-	// h is not needed anymore
+	// start worker threads, independent tasks are calculated concurrently
+	for (unsigned int i = 0; i < BackgroundTaskQueue::defaultWorkers(); ++i)
+		queuethreads.create_thread(boost::ref(queue));
 }
 
 void Controller::stopQueue()
 {
-	// cancel all jobs, then wait for thread to return
+	// cancel all jobs, then wait for threads to return
 	queue.halt();
-	queuethread->join();
-	// queuethread is not a QObject, delete it here.
-	delete queuethread;
-	queuethread = 0;
+	queuethreads.join_all();
 }
 
 // method for debugging focus
@@ -331,7 +331,7 @@ protected:
 /// QUEUE
 
 	BackgroundTaskQueue queue;
-	boost::thread *queuethread;
+	boost::thread_group queuethreads;
 
 /// SUBSCRIPTIONS
 	// The current ROI.
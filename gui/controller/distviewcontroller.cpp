@@ -342,11 +342,8 @@ void DistViewController::updateBinning(representation::t repr,
 
 void DistViewController::changeBinCount(representation::t type, int bins)
 {
-	// FIXME: we cannot queue->cancelTasks(): might be called on
-	// initialization -> nasty!
-	// We need a better way to replace active binning tasks.
-	//queue->cancelTasks();
-
+	// we cannot queue->cancelTasks(): might be called on initialization.
+	// Obsolete binning tasks are replaced by the model instead.
 	payloadMap[type]->model.updateBinning(bins);
 }
 
@@ -4,36 +4,164 @@
 #include <multi_img.h>
 
 #include <algorithm>
+#include <unordered_map>
+#include <stdint.h>
 #include <tbb/partitioner.h>
-#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 #include <gerbil_gui_debug.h>
 
 #define REUSE_THRESHOLD 0.1
 
 
+/* Binning works on thread-local hash maps that are merged in the end, so
+ * threads do not contend on the shared BinSet maps. Keys of the local maps
+ * are packed into 128 bit if N*log2(D) allows it, otherwise we fall back to
+ * one byte per band (in a buffer that is reused for lookups).
+ */
+struct PackedKey {
+	PackedKey() { w[0] = w[1] = 0; }
+	bool operator==(const PackedKey &o) const
+	{ return w[0] == o.w[0] && w[1] == o.w[1]; }
+	uint64_t w[2];
+};
+
+struct PackedKeyTraits {
+	typedef PackedKey Key;
+	struct Hash {
+		size_t operator()(const PackedKey &k) const {
+			size_t seed = BinSet::hashSeed();
+			boost::hash_combine(seed, k.w[0]);
+			boost::hash_combine(seed, k.w[1]);
+			return seed;
+		}
+	};
+	static inline void make(const unsigned char *q, size_t dim, int bits,
+							Key &k)
+	{
+		k.w[0] = k.w[1] = 0;
+		for (size_t d = 0, pos = 0; d < dim; ++d, pos += bits) {
+			int word = pos >> 6, off = pos & 63;
+			k.w[word] |= (uint64_t)q[d] << off;
+			if (off + bits > 64) // spill into second word
+				k.w[1] |= (uint64_t)q[d] >> (64 - off);
+		}
+	}
+	static inline void toHashKey(const Key &k, size_t dim, int bits,
+								 BinSet::HashKey &h)
+	{
+		h.resize(dim);
+		uint64_t mask = (1u << bits) - 1;
+		for (size_t d = 0, pos = 0; d < dim; ++d, pos += bits) {
+			int word = pos >> 6, off = pos & 63;
+			uint64_t v = k.w[word] >> off;
+			if (off + bits > 64)
+				v |= k.w[1] << (64 - off);
+			h[d] = (unsigned char)(v & mask);
+		}
+	}
+};
+
+struct ByteKeyTraits {
+	typedef BinSet::HashKey Key;
+	struct Hash {
+		size_t operator()(const Key &k) const {
+			return BinSet::vector_char_hash_compare().hash(k);
+		}
+	};
+	static inline void make(const unsigned char *q, size_t dim, int,
+							Key &k)
+	{
+		k.assign(q, q + dim); // no allocation once capacity is reached
+	}
+	static inline void toHashKey(const Key &k, size_t, int,
+								 BinSet::HashKey &h)
+	{
+		h = k;
+	}
+};
+
+template<class Traits>
 class Accumulate {
 public:
-	Accumulate(bool subtract, multi_img &multi, const cv::Mat1s &labels, const cv::Mat1b &mask,
-		int nbins, multi_img::Value binsize, multi_img::Value minval, bool ignoreLabels,
-		std::vector<multi_img::Value> &illuminant,
-		std::vector<BinSet> &sets)
-		: subtract(subtract), multi(multi), labels(labels), mask(mask), nbins(nbins), binsize(binsize),
-		minval(minval), illuminant(illuminant), ignoreLabels(ignoreLabels), sets(sets) {}
-	void operator()(const tbb::blocked_range2d<int> &r) const;
+	typedef std::unordered_map<typename Traits::Key, Bin,
+							   typename Traits::Hash> LocalMap;
+
+	Accumulate(multi_img &multi, const cv::Mat1s &labels,
+		const cv::Mat1b &mask, int nbins, int bits, multi_img::Value binsize,
+		multi_img::Value minval, bool ignoreLabels,
+		const std::vector<multi_img::Value> &illuminant, size_t nsets)
+		: multi(multi), labels(labels), mask(mask), dim(multi.size()),
+		  bits(bits), maxbin((multi_img::Value)(nbins - 1)), binsize(binsize),
+		  minval(minval), ignoreLabels(ignoreLabels), divisor(dim, 1.f),
+		  maps(nsets), quantized(dim)
+	{
+		if (!illuminant.empty())
+			std::copy(illuminant.begin(), illuminant.begin() + dim,
+					  divisor.begin());
+	}
+	Accumulate(Accumulate &toSplit, tbb::split)
+		: multi(toSplit.multi), labels(toSplit.labels), mask(toSplit.mask),
+		  dim(toSplit.dim), bits(toSplit.bits), maxbin(toSplit.maxbin),
+		  binsize(toSplit.binsize), minval(toSplit.minval),
+		  ignoreLabels(toSplit.ignoreLabels), divisor(toSplit.divisor),
+		  maps(toSplit.maps.size()), quantized(dim) {}
+
+	void operator()(const tbb::blocked_range2d<int> &r);
+	void join(Accumulate &toJoin);
+	/// add or subtract the accumulated bins to/from the target sets
+	void apply(bool subtract, std::vector<BinSet> &sets) const;
+
 private:
-	bool subtract;
+	/* same as floor(Compute::curpos()) clamped to [0, nbins-1]. For values
+	 * >= 0 floor() is truncation, negative values are clamped anyways.
+	 * Written branch-free for the compiler to vectorize. */
+	inline void quantize(const multi_img::Value *pixel, unsigned char *q) const
+	{
+		const multi_img::Value *div = &divisor[0];
+		for (size_t d = 0; d < dim; ++d) {
+			multi_img::Value pos = ((pixel[d] - minval) / binsize) / div[d];
+			pos = std::min(std::max(pos, (multi_img::Value)0.f), maxbin);
+			q[d] = (unsigned char)(int)pos;
+		}
+	}
+
 	multi_img &multi;
 	const cv::Mat1s &labels;
 	const cv::Mat1b &mask;
-	int nbins;
+	size_t dim;
+	int bits;
+	multi_img::Value maxbin;
 	multi_img::Value binsize;
 	multi_img::Value minval;
 	bool ignoreLabels;
-	std::vector<multi_img::Value> &illuminant;
-	std::vector<BinSet> &sets;
+	std::vector<multi_img::Value> divisor;
+	// one map per label
+	std::vector<LocalMap> maps;
+	// reused buffers
+	std::vector<unsigned char> quantized;
+	typename Traits::Key key;
 };
 
+template<class Traits>
+static void accumulate(bool subtract, const cv::Rect &region,
+		multi_img &multi, const cv::Mat1s &labels, const cv::Mat1b &mask,
+		int nbins, int bits, multi_img::Value binsize,
+		multi_img::Value minval, bool ignoreLabels,
+		const std::vector<multi_img::Value> &illuminant,
+		std::vector<BinSet> &sets, tbb::task_group_context &stopper)
+{
+	Accumulate<Traits> acc(multi, labels, mask, nbins, bits, binsize, minval,
+						   ignoreLabels, illuminant, sets.size());
+	tbb::parallel_reduce(
+		tbb::blocked_range2d<int>(region.y, region.y + region.height,
+								  region.x, region.x + region.width),
+			acc, tbb::auto_partitioner(), stopper);
+	if (stopper.is_group_execution_cancelled())
+		return;
+	acc.apply(subtract, sets);
+}
+
 bool DistviewBinsTbb::run()
 {
 	bool reuse = ((!add.empty() || !sub.empty()) && !inplace);
@@ -80,26 +208,28 @@ bool DistviewBinsTbb::run()
 	if (!keepOldContext)
 		updateContext();
 
+	// bits needed per band for a bin index
+	int bits = 1;
+	while ((1 << bits) < args.nbins)
+		++bits;
+	bool packed = ((*multi)->size() * bits <= 128);
+
 	std::vector<cv::Rect>::iterator it;
-	/* substract pixels from bins */
-	for (it = sub.begin(); it != sub.end(); ++it) {
-		Accumulate substract(true, **multi, labels, mask, args.nbins,
-							 args.binsize, args.minval, args.ignoreLabels,
-							 illuminant, *result);
-		tbb::parallel_for(
-			tbb::blocked_range2d<int>(it->y, it->y + it->height,
-									  it->x, it->x + it->width),
-				substract, tbb::auto_partitioner(), stopper);
-	}
-	/* add pixels to bins */
-	for (it = add.begin(); it != add.end(); ++it) {
-		Accumulate add(
-			false, **multi, labels, mask, args.nbins, args.binsize,
-					args.minval, args.ignoreLabels, illuminant, *result);
-		tbb::parallel_for(
-			tbb::blocked_range2d<int>(it->y, it->y + it->height,
-									  it->x, it->x + it->width),
-				add, tbb::auto_partitioner(), stopper);
+	/* substract pixels from bins, then add pixels to bins */
+	for (int pass = 0; pass < 2; ++pass) {
+		bool subtract = (pass == 0);
+		std::vector<cv::Rect> &regions = (subtract ? sub : add);
+		for (it = regions.begin(); it != regions.end(); ++it) {
+			if (packed) {
+				accumulate<PackedKeyTraits>(subtract, *it, **multi, labels,
+					mask, args.nbins, bits, args.binsize, args.minval,
+					args.ignoreLabels, illuminant, *result, stopper);
+			} else {
+				accumulate<ByteKeyTraits>(subtract, *it, **multi, labels,
+					mask, args.nbins, bits, args.binsize, args.minval,
+					args.ignoreLabels, illuminant, *result, stopper);
+			}
+		}
 	}
 
 	/* throwaway result if something wrong */
@@ -143,7 +273,8 @@ void DistviewBinsTbb::updateContext()
 	args.valid = true;
 }
 
-void Accumulate::operator()(const tbb::blocked_range2d<int> &r) const
+template<class Traits>
+void Accumulate<Traits>::operator()(const tbb::blocked_range2d<int> &r)
 {
 	for (int y = r.rows().begin(); y != r.rows().end(); ++y) {
 		const short *lr = labels[y];
@@ -153,33 +284,65 @@ void Accumulate::operator()(const tbb::blocked_range2d<int> &r) const
 				continue;
 
 			int label = (ignoreLabels ? 0 : lr[x]);
-			label = (label >= (int)sets.size()) ? 0 : label;
-			const multi_img::Pixel& pixel = multi(y, x);
-			BinSet &s = sets[label];
-
-			BinSet::HashKey hashkey(multi.size());
-            for (unsigned int d = 0; d < multi.size(); ++d) {
-				int pos = floor(Compute::curpos(
-									pixel[d], d, minval, binsize, illuminant));
-				pos = std::max(pos, 0); pos = std::min(pos, nbins-1);
-				hashkey[d] = (unsigned char)pos;
-			}
+			label = (label >= (int)maps.size()) ? 0 : label;
+			multi_img::PixelView pixel = multi(y, x);
+
+			quantize(pixel.data(), &quantized[0]);
+			Traits::make(&quantized[0], dim, bits, key);
 
+			LocalMap &m = maps[label];
+			typename LocalMap::iterator bit = m.find(key);
+			if (bit == m.end())
+				m.insert(std::make_pair(key, Bin(pixel)));
+			else
+				bit->second.add(pixel);
+		}
+	}
+}
+
+template<class Traits>
+void Accumulate<Traits>::join(Accumulate &toJoin)
+{
+	for (size_t l = 0; l < maps.size(); ++l) {
+		LocalMap &m = maps[l];
+		LocalMap &other = toJoin.maps[l];
+		// merge the smaller map into the larger one
+		if (m.size() < other.size())
+			m.swap(other);
+		typename LocalMap::const_iterator it;
+		for (it = other.begin(); it != other.end(); ++it) {
+			typename LocalMap::iterator bit = m.find(it->first);
+			if (bit == m.end())
+				m.insert(*it);
+			else
+				bit->second.add(it->second);
+		}
+	}
+}
+
+template<class Traits>
+void Accumulate<Traits>::apply(bool subtract, std::vector<BinSet> &sets) const
+{
+	BinSet::HashKey hashkey(dim);
+	for (size_t l = 0; l < maps.size(); ++l) {
+		BinSet &s = sets[l];
+		const LocalMap &m = maps[l];
+		typename LocalMap::const_iterator it;
+		for (it = m.begin(); it != m.end(); ++it) {
+			Traits::toHashKey(it->first, dim, bits, hashkey);
+			const Bin &b = it->second;
+			BinSet::HashMap::accessor ac;
 			if (subtract) {
-				BinSet::HashMap::accessor ac;
 				if (s.bins.find(ac, hashkey)) {
-					ac->second.sub(pixel);
+					ac->second.sub(b);
 					if (ac->second.weight == 0.f)
 						s.bins.erase(ac);
 				}
-				ac.release();
-				s.totalweight--; // atomic
+				s.totalweight -= (int)b.weight; // atomic
 			} else {
-				BinSet::HashMap::accessor ac;
 				s.bins.insert(ac, hashkey);
-				ac->second.add(pixel);
-				ac.release();
-				s.totalweight++; // atomic
+				ac->second.add(b);
+				s.totalweight += (int)b.weight; // atomic
 			}
 		}
 	}
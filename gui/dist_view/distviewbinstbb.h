@@ -28,7 +28,13 @@ public:
 		bool inplace = false, bool apply = true)
 		: BackgroundTask(), multi(multi), labels(labels), colors(colors),
 		illuminant(illuminant), args(args), context(context),
-		current(current), temp(temp), sub(sub), add(add), mask(mask), inplace(inplace), apply(apply) {}
+		current(current), temp(temp), sub(sub), add(add), mask(mask), inplace(inplace), apply(apply)
+	{
+		reads(multi);
+		writes(context);
+		writes(current);
+		writes(temp);
+	}
 	virtual ~DistviewBinsTbb() {}
 	virtual bool run();
 	// helper to run(): update viewport context
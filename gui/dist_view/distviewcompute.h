@@ -31,13 +31,13 @@
  */
 struct Bin {
 	Bin() : weight(0.f) {}
-	Bin(const multi_img::Pixel& initial_means)
-		: weight(1.f), means(initial_means) {} //, points(initial_means.size()) {}
+	Bin(const multi_img::PixelView& initial_means)
+		: weight(1.f), means(initial_means.begin(), initial_means.end()) {} //, points(initial_means.size()) {}
 
 	/* we store the mean/avg. of all pixel vectors represented by this bin
 	 * the mean is not normalized during filling the bin, only afterwards
 	 */
-	inline void add(const multi_img::Pixel& p) {
+	inline void add(const multi_img::PixelView& p) {
 		/* weight holds the number of pixels this bin represents
 		 */
 		weight += 1.f;
@@ -48,13 +48,29 @@ struct Bin {
 	}
 
 	/* in incremental update of our BinSet, we can also remove pixels from a bin */
-	inline void sub(const multi_img::Pixel& p) {
+	inline void sub(const multi_img::PixelView& p) {
 		weight -= 1.f;
 		assert(!means.empty());
 		std::transform(means.begin(), means.end(), p.begin(), means.begin(),
 					   std::minus<multi_img::Value>());
 	}
 
+	/* add/remove all pixels represented by another bin (partial result) */
+	inline void add(const Bin& b) {
+		weight += b.weight;
+		if (means.empty())
+			means.resize(b.means.size(), 0.f);
+		std::transform(means.begin(), means.end(), b.means.begin(),
+					   means.begin(), std::plus<multi_img::Value>());
+	}
+
+	inline void sub(const Bin& b) {
+		weight -= b.weight;
+		assert(!means.empty());
+		std::transform(means.begin(), means.end(), b.means.begin(),
+					   means.begin(), std::minus<multi_img::Value>());
+	}
+
 	float weight;
 	std::vector<multi_img::Value> means;
 	/* each bin can have a color calculated for the mean vector
@@ -67,12 +83,18 @@ struct BinSet {
 		: label(c), boundary(size, std::make_pair((int)255, (int)0))
 	{ totalweight = 0; }
 
+	/// large random init for bin hashes, chosen to fit into size_t
+	static size_t hashSeed()
+	{
+		return (sizeof(size_t) >= 8 ? (size_t)1878709926690269970ULL
+									: (size_t)0x9e3779b9UL);
+	}
+
 	// Hash function for tbb::concurrent_hash_map
 	struct vector_char_hash_compare {
 		size_t hash( const  std::vector<unsigned char> & a ) const
 		{
-			// large random init
-			size_t seed = 1878709926690269970;
+			size_t seed = hashSeed();
 			boost::hash_range(seed, a.begin(), a.end());
 			return seed;
 		}
@@ -66,6 +66,8 @@ void DistViewModel::updateBinning(int bins)
 
 	BackgroundTaskPtr taskBins(new DistviewBinsTbb(
 		image, labels, labelColors, illuminant, args, context, binsets));
+	// only the latest bin count matters, replace pending binning
+	taskBins->setKey(context, "binning");
 	QObject::connect(taskBins.get(), SIGNAL(finished(bool)),
 					 this, SLOT(propagateBinning(bool)), Qt::QueuedConnection);
 	queue->push(taskBins);
@@ -336,7 +338,7 @@ QPolygonF DistViewModel::getPixelOverlay(int y, int x)
 		return QPolygonF();
 	}
 
-	const multi_img::Pixel &pixel = (**image)(y, x);
+	multi_img::PixelView pixel = (**image)(y, x);
 	QPolygonF points((*image)->size());
 
 	for (unsigned int d = 0; d < (*image)->size(); ++d) {
@@ -55,7 +55,7 @@ void fillMaskLimitersBody::operator ()(
 		unsigned char *row = mask[y];
 		for (size_t x = r.cols().begin(); x != r.cols().end(); ++x) {
 			row[x] = 1;
-			const multi_img::Pixel &p = image(y, x);
+			multi_img::PixelView p = image(y, x);
 			for (unsigned int d = 0; d < image.size(); ++d) {
 				int pos = floor(Compute::curpos(
 									p[d], d, minval, binsize, illuminant));
@@ -95,7 +95,7 @@ void updateMaskLimitersBody::operator ()(
 				mrow[x] = 0;
 			} else if (mrow[x] == 0) { // we need to do exhaustive test
 				mrow[x] = 1;
-				const multi_img::Pixel& p = image(y, x);
+				multi_img::PixelView p = image(y, x);
 				for (unsigned int d = 0; d < image.size(); ++d) {
 					int pos = floor(Compute::curpos(
 										p[d], d, minval, binsize, illuminant));
@@ -11,7 +11,8 @@
 GraphSegmentationModel::GraphSegmentationModel(
 		BackgroundTaskQueue *queue,
 		QObject *parent)
-	: QObject(parent), queue(queue), graphsegResult(new cv::Mat1s()), curLabel(1) {}
+	: QObject(parent), queue(queue), graphsegResult(new cv::Mat1s()), curLabel(1),
+	  sessionType(representation::IMG), sessionBand(-1) {}
 
 GraphSegmentationModel::~GraphSegmentationModel() { }
 
@@ -23,6 +24,17 @@ void GraphSegmentationModel::setMultiImage(representation::t type,
 		map.insert(type, image);
 	else // tryed setting an image of an unsupported representation type
 		assert(false);
+
+	if (type == sessionType)
+		session.reset();
+}
+
+void GraphSegmentationModel::processImageUpdate(representation::t type,
+												SharedMultiImgPtr,
+												bool duplicate)
+{
+	if (!duplicate && type == sessionType)
+		session.reset();
 }
 
 void GraphSegmentationModel::setCurLabel(int curLabel)
@@ -39,7 +51,7 @@ void GraphSegmentationModel::runGraphseg(representation::t type,
 	if (!input) // image of type type was not set with setMultiImg
 		assert(false);
 
-	startGraphseg(input, seedMap, config, resetLabel);
+	startGraphseg(type, -1, input, seedMap, config, resetLabel);
 }
 
 void GraphSegmentationModel::runGraphsegBand(representation::t type, int bandId,
@@ -51,10 +63,12 @@ void GraphSegmentationModel::runGraphsegBand(representation::t type, int bandId,
 	SharedMultiImgPtr img = map.value(type);
 	multi_img::Band band = (**img)[bandId];
 	SharedMultiImgPtr input(new SharedMultiImgBase(new multi_img(band)));
-	startGraphseg(input, seedMap, config, resetLabel);
+	startGraphseg(type, bandId, input, seedMap, config, resetLabel);
 }
 
-void GraphSegmentationModel::startGraphseg(SharedMultiImgPtr input,
+void GraphSegmentationModel::startGraphseg(representation::t type,
+										   int bandId,
+										   SharedMultiImgPtr input,
 										   cv::Mat1s seedMap,
 										   const seg_graphs::GraphSegConfig
 										   &config,
@@ -68,9 +82,21 @@ void GraphSegmentationModel::startGraphseg(SharedMultiImgPtr input,
 								 false);
 	}
 
+	/* re-use the graph of the last run if only the seeds changed. Band input
+	   is a new image on every run, so it is identified by the band */
+	std::string configString = config.getString();
+	if (!session || type != sessionType || bandId != sessionBand
+	    || configString != sessionConfig) {
+		session = boost::shared_ptr<seg_graphs::GraphSegSession>(
+					new seg_graphs::GraphSegSession(config));
+		sessionType = type;
+		sessionBand = bandId;
+		sessionConfig = configString;
+	}
+
 	// TODO: should this be a commandrunner instead? arguable..
 	BackgroundTaskPtr taskGraphseg(new GraphSegTask(
-		config, input, seedMap, graphsegResult));
+		config, input, seedMap, graphsegResult, session));
 	QObject::connect(taskGraphseg.get(), SIGNAL(finished(bool)),
 		this, SLOT(finishGraphSeg(bool)), Qt::QueuedConnection);
 	queue->push(taskGraphseg);
@@ -14,6 +14,7 @@
 namespace seg_graphs
 {
 class GraphSegConfig;
+class GraphSegSession;
 }
 
 class GraphSegmentationModel : public QObject
@@ -28,7 +29,9 @@ public:
 	void setMultiImage(representation::t type, SharedMultiImgPtr image);
 
 protected:
-	void startGraphseg(SharedMultiImgPtr input, cv::Mat1s seedMap,
+	/// bandId is -1 for input with all bands of representation type
+	void startGraphseg(representation::t type, int bandId,
+	                   SharedMultiImgPtr input, cv::Mat1s seedMap,
 	                   const seg_graphs::GraphSegConfig &config,
 	                   bool resetLabel);
 
@@ -39,6 +42,9 @@ public slots:
 	void runGraphsegBand(representation::t type, int bandId, cv::Mat1s seedMap,
 	                     const seg_graphs::GraphSegConfig &config,
 	                     bool resetLabel);
+	/** Drop the kept graph when the image data changed (e.g. new ROI). */
+	void processImageUpdate(representation::t type, SharedMultiImgPtr image,
+	                        bool duplicate);
 
 protected slots:
 	void finishGraphSeg(bool success);
@@ -56,6 +62,14 @@ protected:
 	int curLabel;
 
 	boost::shared_ptr<cv::Mat1s> graphsegResult;
+
+	/* graph of the last run, re-used while only the seeds change. It belongs
+	   to the image of representation sessionType (band sessionBand, or -1 for
+	   all bands), segmented with configuration sessionConfig. */
+	boost::shared_ptr<seg_graphs::GraphSegSession> session;
+	representation::t sessionType;
+	int sessionBand;
+	std::string sessionConfig;
 };
 
 #endif // GRAPH_SEGMENTATION_MODEL_H
@@ -19,7 +19,7 @@
 #include <background_task/tasks/tbb/rescaletbb.h>
 #include <background_task/tasks/tbb/rgbqttbb.h>
 
-#include <multi_img/multi_img_offloaded.h>
+#include <multi_img/multi_img_tiled.h>
 #include <imginput.h>
 
 #include <boost/make_shared.hpp>
@@ -81,11 +81,11 @@ cv::Rect ImageModel::loadImage(const QString &filename)
 	// do a more complicated transformation to preserve non-ascii filenames
 	std::string fn = filename.toLocal8Bit().constData();
 	if (limitedMode) {
-		// create offloaded image
+		// create tiled image, ROIs are read from its chunk cache
 		std::pair<std::vector<std::string>, std::vector<multi_img::BandDesc> >
 				filelist = multi_img::parse_filelist(fn);
 		image_lim = boost::make_shared<SharedMultiImgBase>
-				(new multi_img_offloaded(filelist.first, filelist.second));
+				(new multi_img_tiled(filelist.first, filelist.second));
 	} else {
 		// create using ImgInput
 		imginput::ImgInputConfig inputConfig;
@@ -250,6 +250,9 @@ void ImageModel::spawn(representation::t type, const cv::Rect &newROI, int bands
 
 	// emit signal after all tasks are finished and fully updated data available
 	BackgroundTaskPtr taskEpilog(new BackgroundTask());
+	// wait only for tasks of this representation, others continue
+	taskEpilog->reads(map[type]->image);
+	taskEpilog->reads(map[type]->normRange);
 	QObject::connect(taskEpilog.get(), SIGNAL(finished(bool)),
 					 map[type], SLOT(processImageDataTaskFinished(bool)));
 	queue.push(taskEpilog);
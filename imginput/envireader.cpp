@@ -0,0 +1,490 @@
+#ifdef __unix__
+
+#include "imginput.h"
+#include "envireader.h"
+
+#include <boost/shared_ptr.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace imginput {
+
+namespace {
+
+/// read-only file contents, mapped copy-on-write
+struct MappedFile {
+	MappedFile() : data(0), length(0) {}
+	~MappedFile() { if (data) munmap(data, length); }
+
+	bool map(const std::string &file)
+	{
+		int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+			close(fd);
+			return false;
+		}
+		length = st.st_size;
+		/* private writable mapping: pages are shared with the page cache
+		   until they get written to (image operations work in-place on the
+		   band data, but must never alter the file) */
+		void *p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd); // the mapping stays valid
+		if (p == MAP_FAILED) {
+			length = 0;
+			return false;
+		}
+		data = (char*)p;
+		return true;
+	}
+
+	char *data;
+	size_t length;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+// band index in file with its metadata, to sort bands by wavelength
+struct BandEntry {
+	int index;
+	multi_img::BandDesc desc;
+};
+
+// same ordering as GdalReader: empty descs first, then by wavelength
+struct BandEntryCompare {
+	bool operator()(const BandEntry &a, const BandEntry &b) const
+	{
+		if (b.desc.empty) return false;
+		if (a.desc.empty) return true;
+		return a.desc.center < b.desc.center;
+	}
+};
+
+bool fileExists(const std::string &file)
+{
+	struct stat st;
+	return stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+std::string toLower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+	return str;
+}
+
+std::string trim(const std::string &str)
+{
+	const char *ws = " \t\r\n";
+	std::string::size_type begin = str.find_first_not_of(ws);
+	if (begin == std::string::npos)
+		return std::string();
+	return str.substr(begin, str.find_last_not_of(ws) - begin + 1);
+}
+
+std::vector<float> parseList(const std::string &str)
+{
+	std::vector<float> ret;
+	std::stringstream in(str);
+	std::string item;
+	while (std::getline(in, item, ','))
+		ret.push_back((float)atof(item.c_str()));
+	return ret;
+}
+
+bool hostIsBigEndian()
+{
+	const unsigned short one = 1;
+	return *(const unsigned char*)&one == 0;
+}
+
+template<typename T>
+inline void byteSwap(T &v)
+{
+	unsigned char *b = (unsigned char*)&v;
+	std::reverse(b, b + sizeof(T));
+}
+
+template<typename T>
+inline multi_img::Value load(const char *src, bool swap)
+{
+	T v;
+	memcpy(&v, src, sizeof(T));
+	if (swap)
+		byteSwap(v);
+	return (multi_img::Value)v;
+}
+
+/* copy the requested bands out of the mapping in one pass over the lines of
+   the ROI, so every page is touched once. src points to the first sample of
+   the ROI, strides and band offsets are in elements. The header offset does
+   not need to be aligned, so we use memcpy for each value.
+   Returns the maximum value (at least 0). */
+template<typename T>
+multi_img::Value convertBands(const char *src,
+							  const std::vector<size_t> &bandOffset,
+							  size_t lineStride, size_t sampleStride,
+							  bool swap, std::vector<multi_img::Band> &dst)
+{
+	const size_t n = dst.size();
+	multi_img::Value maxVal = 0.f;
+	std::vector<multi_img::Value*> drow(n);
+	for (int y = 0; y < dst[0].rows; ++y) {
+		const char *line = src + y * lineStride * sizeof(T);
+		for (size_t i = 0; i < n; ++i)
+			drow[i] = dst[i][y];
+
+		if (sampleStride == 1) { // BSQ, BIL: band lines are contiguous
+			for (size_t i = 0; i < n; ++i) {
+				const char *s = line + bandOffset[i] * sizeof(T);
+				for (int x = 0; x < dst[i].cols; ++x) {
+					multi_img::Value v = load<T>(s + x * sizeof(T), swap);
+					drow[i][x] = v;
+					maxVal = std::max(maxVal, v);
+				}
+			}
+		} else { // BIP: spectra are contiguous
+			for (int x = 0; x < dst[0].cols; ++x) {
+				const char *s = line + x * sampleStride * sizeof(T);
+				for (size_t i = 0; i < n; ++i) {
+					multi_img::Value v =
+							load<T>(s + bandOffset[i] * sizeof(T), swap);
+					drow[i][x] = v;
+					maxVal = std::max(maxVal, v);
+				}
+			}
+		}
+	}
+	return maxVal;
+}
+
+/// maximum value of all bands (at least 0), bands are scanned in parallel
+double bandsMax(const std::vector<multi_img::Band> &bands)
+{
+	std::vector<double> maxima(bands.size(), 0.);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, bands.size()),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t i = r.begin(); i != r.end(); ++i)
+			cv::minMaxLoc(bands[i], NULL, &maxima[i]);
+	});
+	return std::max(0., *std::max_element(maxima.begin(), maxima.end()));
+}
+
+} // anonymous namespace
+
+multi_img::ptr EnviReader::readFile()
+{
+	std::string hdrfile, rawfile;
+	if (!findFiles(hdrfile, rawfile))
+		return multi_img::ptr(new multi_img());
+
+	Header hdr;
+	if (!parseHeader(hdrfile, hdr))
+		return multi_img::ptr(new multi_img());
+
+	size_t typesize = typeSize(hdr.datatype);
+	if (typesize == 0) {
+		std::cerr << "ENVI data type " << hdr.datatype << " is not supported."
+				  << std::endl;
+		return multi_img::ptr(new multi_img());
+	}
+
+	boost::shared_ptr<MappedFile> mapping(new MappedFile());
+	if (!mapping->map(rawfile)) {
+		std::cerr << "Could not map " << rawfile << " into memory."
+				  << std::endl;
+		return multi_img::ptr(new multi_img());
+	}
+	size_t total = (size_t)hdr.samples * hdr.lines * hdr.bands * typesize;
+	if (mapping->length < hdr.offset + total) {
+		std::cerr << "ENVI file " << rawfile << " is smaller than announced "
+					 "by its header." << std::endl;
+		return multi_img::ptr(new multi_img());
+	}
+
+	// strides (in elements) of the file layout
+	size_t bandStride, lineStride, sampleStride;
+	if (hdr.interleave == "bsq") {
+		sampleStride = 1;
+		lineStride = hdr.samples;
+		bandStride = (size_t)hdr.samples * hdr.lines;
+	} else if (hdr.interleave == "bil") {
+		sampleStride = 1;
+		bandStride = hdr.samples;
+		lineStride = (size_t)hdr.samples * hdr.bands;
+	} else { // bip
+		bandStride = 1;
+		sampleStride = hdr.bands;
+		lineStride = (size_t)hdr.samples * hdr.bands;
+	}
+
+	std::cout << "Reading image: " << rawfile << " (ENVI, "
+			  << hdr.interleave << ")" << std::endl;
+
+	// band metadata and ordering
+	std::vector<BandEntry> entries(hdr.bands);
+	bool haveWavelengths = ((int)hdr.wavelength.size() == hdr.bands);
+	bool haveFwhm = ((int)hdr.fwhm.size() == hdr.bands);
+	for (int b = 0; b < hdr.bands; ++b) {
+		entries[b].index = b;
+		if (!haveWavelengths)
+			continue;
+		float center = hdr.wavelength[b] * hdr.unitscale;
+		if (haveFwhm && hdr.fwhm[b] > 0.f) {
+			float half = hdr.fwhm[b] * hdr.unitscale * 0.5f;
+			entries[b].desc = multi_img::BandDesc(center - half, center + half);
+		} else {
+			entries[b].desc = multi_img::BandDesc(center);
+		}
+	}
+	// stable_sort: do not change the order of bands with unknown wavelength
+	std::stable_sort(entries.begin(), entries.end(), BandEntryCompare());
+
+	// find ROI
+	int xOff = 0, yOff = 0, sizeX = hdr.samples, sizeY = hdr.lines;
+	if (!config.roi.empty()) {
+		// Do not print an error message here, as it will be printed in ImgInput anyways
+		std::vector<int> roiVals;
+		if (ImgInput::parseROIString(config.roi, roiVals)) {
+			xOff = roiVals[0];
+			yOff = roiVals[1];
+			sizeX = roiVals[2];
+			sizeY = roiVals[3];
+		}
+	}
+	if (xOff < 0 || yOff < 0 || sizeX <= 0 || sizeY <= 0 ||
+		xOff + sizeX > hdr.samples || yOff + sizeY > hdr.lines) {
+		std::cerr << "ROI exceeds image dimensions!" << std::endl;
+		return multi_img::ptr(new multi_img());
+	}
+
+	// crop spectrum
+	int bandlow = 0;
+	int bandhigh = hdr.bands - 1; // inclusive, just like config.bandhigh
+	if ((config.bandlow > 0) ||
+		(config.bandhigh > 0 && config.bandhigh < hdr.bands - 1))
+	{
+		// if bandhigh is not specified, do not limit
+		bandhigh = (config.bandhigh == 0) ? (hdr.bands - 1) : config.bandhigh;
+
+		// correct input?
+		if (config.bandlow > bandhigh || bandhigh > hdr.bands - 1) {
+			std::cerr << "Inconsistent bandlow, bandhigh values specified!" << std::endl;
+			return multi_img::ptr(new multi_img());
+		}
+		bandlow = config.bandlow;
+	}
+
+	/* float32 BSQ in host byte order is exactly our band layout. In this case
+	   the bands become views into the mapping */
+	bool swap = (hdr.bigendian != hostIsBigEndian());
+	bool zerocopy = (hdr.datatype == 4 && hdr.interleave == "bsq" && !swap
+					 && multi_img::ValueType == CV_32F
+					 && hdr.offset % sizeof(multi_img::Value) == 0);
+
+	const size_t count = bandhigh - bandlow + 1;
+	const char *roiStart = mapping->data + hdr.offset +
+			(yOff * lineStride + xOff * sampleStride) * typesize;
+	std::vector<size_t> bandOffset(count);
+	std::vector<multi_img::Band> bands(count);
+	std::vector<multi_img::BandDesc> descs(count);
+	for (size_t i = 0; i < count; ++i) {
+		bandOffset[i] = entries[bandlow + i].index * bandStride;
+		descs[i] = entries[bandlow + i].desc;
+	}
+
+	double maxVal = 0;
+	if (zerocopy) {
+		for (size_t i = 0; i < count; ++i) {
+			bands[i] = multi_img::Band(sizeY, sizeX,
+				(multi_img::Value*)(roiStart + bandOffset[i] * typesize),
+				lineStride * typesize);
+		}
+		/* scanning for the maximum touches every page of the mapping, so
+		   only do it if the header does not tell the range */
+		if (hdr.reflectancescale > 0.f)
+			maxVal = hdr.reflectancescale;
+		else
+			maxVal = bandsMax(bands);
+	} else {
+		for (size_t i = 0; i < count; ++i)
+			bands[i] = multi_img::Band(sizeY, sizeX);
+		switch (hdr.datatype) {
+		case 1:  maxVal = convertBands<unsigned char>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 2:  maxVal = convertBands<short>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 3:  maxVal = convertBands<int>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 4:  maxVal = convertBands<float>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 5:  maxVal = convertBands<double>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 12: maxVal = convertBands<unsigned short>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		case 13: maxVal = convertBands<unsigned int>(roiStart, bandOffset, lineStride, sampleStride, swap, bands); break;
+		default: assert(false); // checked by typeSize()
+		}
+	}
+
+	/* if our image data has more than 8 bit (values > 255), then
+	 * determine dynamic range of camera (we assume it is a power of two) */
+	double powMax = 256;
+	for (; powMax < maxVal; powMax *= 2) {
+		// nothing
+	}
+	maxVal = powMax;
+
+	/* keep the mapping alive only if we reference it, converted bands
+	   own their data */
+	boost::shared_ptr<void> backing;
+	if (zerocopy)
+		backing = mapping;
+	multi_img::ptr img_ptr(new multi_img(bands, descs, backing));
+
+	// set min & max
+	img_ptr->minval = 0;
+	img_ptr->maxval = (multi_img::Value)maxVal;
+
+	std::cout << "Total of " << img_ptr->size() << " bands. "
+			  << "Spatial size: " << sizeX << "x" << sizeY
+			  << (zerocopy ? "   (mapped)" : "   (converted)") << std::endl;
+
+	return img_ptr;
+}
+
+bool EnviReader::findFiles(std::string &hdrfile, std::string &rawfile) const
+{
+	const std::string &file = config.file;
+	std::string::size_type dot = file.find_last_of('.');
+	std::string::size_type slash = file.find_last_of('/');
+	bool hasExt = (dot != std::string::npos &&
+				   (slash == std::string::npos || dot > slash));
+	std::string base = (hasExt ? file.substr(0, dot) : file);
+
+	if (hasExt && toLower(file.substr(dot)) == ".hdr") {
+		// header given, find the data file
+		hdrfile = file;
+		const char *exts[] = { "", ".raw", ".img", ".dat",
+							   ".bsq", ".bil", ".bip", 0 };
+		for (int i = 0; exts[i]; ++i) {
+			if (fileExists(base + exts[i])) {
+				rawfile = base + exts[i];
+				return true;
+			}
+		}
+		std::cerr << "No data file found for ENVI header " << file
+				  << std::endl;
+		return false;
+	}
+
+	// data file given, find the header (foo.raw.hdr or foo.hdr)
+	rawfile = file;
+	if (fileExists(file + ".hdr")) {
+		hdrfile = file + ".hdr";
+		return true;
+	}
+	if (hasExt && fileExists(base + ".hdr")) {
+		hdrfile = base + ".hdr";
+		return true;
+	}
+	return false;
+}
+
+bool EnviReader::parseHeader(const std::string &file, Header &hdr)
+{
+	std::ifstream in(file.c_str());
+	std::string line;
+	if (!std::getline(in, line) || line.compare(0, 4, "ENVI") != 0)
+		return false;
+
+	while (std::getline(in, line)) {
+		std::string::size_type eq = line.find('=');
+		if (eq == std::string::npos)
+			continue;
+		std::string key = toLower(trim(line.substr(0, eq)));
+		std::string value = trim(line.substr(eq + 1));
+
+		// lists in braces may span several lines
+		if (!value.empty() && value[0] == '{') {
+			while (value.find('}') == std::string::npos
+				   && std::getline(in, line))
+				value.append(" ").append(line);
+			std::string::size_type end = value.find('}');
+			value = trim(value.substr(1, (end == std::string::npos)
+											? std::string::npos : end - 1));
+		}
+
+		if (key == "samples")
+			hdr.samples = atoi(value.c_str());
+		else if (key == "lines")
+			hdr.lines = atoi(value.c_str());
+		else if (key == "bands")
+			hdr.bands = atoi(value.c_str());
+		else if (key == "header offset")
+			hdr.offset = strtoul(value.c_str(), NULL, 10);
+		else if (key == "data type")
+			hdr.datatype = atoi(value.c_str());
+		else if (key == "interleave")
+			hdr.interleave = toLower(value);
+		else if (key == "byte order")
+			hdr.bigendian = (atoi(value.c_str()) == 1);
+		else if (key == "wavelength")
+			hdr.wavelength = parseList(value);
+		else if (key == "fwhm")
+			hdr.fwhm = parseList(value);
+		else if (key == "data reflectance scale factor")
+			hdr.reflectancescale = (float)atof(value.c_str());
+		else if (key == "wavelength units") {
+			std::string unit = toLower(value);
+			if (unit == "micrometers" || unit == "um" || unit == "microns")
+				hdr.unitscale = 1000.f;
+			else if (unit == "millimeters" || unit == "mm")
+				hdr.unitscale = 1000000.f;
+		}
+	}
+
+	if (hdr.samples <= 0 || hdr.lines <= 0 || hdr.bands <= 0) {
+		std::cerr << "ENVI header " << file << " lacks image dimensions."
+				  << std::endl;
+		return false;
+	}
+	if (hdr.interleave != "bsq" && hdr.interleave != "bil"
+		&& hdr.interleave != "bip") {
+		std::cerr << "ENVI interleave " << hdr.interleave
+				  << " is not supported." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+size_t EnviReader::typeSize(int datatype)
+{
+	switch (datatype) {
+	case 1:  return 1; // 8 bit unsigned
+	case 2:  return 2; // 16 bit signed
+	case 3:  return 4; // 32 bit signed
+	case 4:  return 4; // 32 bit float
+	case 5:  return 8; // 64 bit float
+	case 12: return 2; // 16 bit unsigned
+	case 13: return 4; // 32 bit unsigned
+	default: return 0; // complex and 64 bit integer types
+	}
+}
+
+} //namespace
+
+#endif // __unix__
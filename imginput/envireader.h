@@ -0,0 +1,63 @@
+#ifdef __unix__
+
+#ifndef ENVIREADER_H
+#define ENVIREADER_H
+
+#include <string>
+#include <vector>
+#include <multi_img.h>
+#include "imginput.h"
+#include "imginput_config.h"
+
+namespace imginput {
+
+/** Reader for raw image cubes (BSQ, BIL or BIP) described by an ENVI header.
+	The raw file is memory-mapped. If it holds native float32 data in BSQ
+	layout, the bands of the resulting image are views into the mapping and
+	no image data is copied at all. Other layouts are converted in one pass
+	over the lines of the requested ROI and band range, so each page of the
+	mapping is read once.
+	The value range is determined during conversion. Mapped bands are only
+	scanned for it (once, in parallel) if the header does not provide a data
+	reflectance scale factor, as the scan touches every page of the mapping.
+*/
+class EnviReader {
+public:
+	EnviReader(const ImgInputConfig& config)
+		: config(config) { }
+
+	/// returns empty image if config.file is not an ENVI image
+	multi_img::ptr readFile();
+
+private:
+	/// metadata parsed from the .hdr file
+	struct Header {
+		Header() : samples(0), lines(0), bands(0), offset(0), datatype(0),
+				   interleave("bsq"), bigendian(false), unitscale(1.f),
+				   reflectancescale(0.f) {}
+		int samples, lines, bands;
+		size_t offset;
+		int datatype;
+		std::string interleave;
+		bool bigendian;
+		std::vector<float> wavelength, fwhm;
+		float unitscale; // to get nm
+		float reflectancescale; // value of full reflectance, 0 if unknown
+	};
+
+	const ImgInputConfig &config;
+
+	/// find header and raw file belonging to config.file
+	bool findFiles(std::string &hdrfile, std::string &rawfile) const;
+
+	static bool parseHeader(const std::string &file, Header &hdr);
+
+	/// size of one value of given ENVI data type in bytes, 0 if unsupported
+	static size_t typeSize(int datatype);
+};
+
+} // namespace
+
+#endif // ENVIREADER_H
+
+#endif // __unix__
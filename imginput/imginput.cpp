@@ -1,5 +1,7 @@
 #include "imginput.h"
 #include "gdalreader.h"
+#include "envireader.h"
+#include "pipeline.h"
 #include <multi_img/illuminant.h>
 #include <string>
 #include <vector>
@@ -19,13 +21,18 @@ multi_img::ptr ImgInput::execute()
 	bool bandsCropped = false;
 
 	multi_img::ptr img_ptr;
+	// raw cubes with ENVI header are mapped into memory instead of read in
+#ifdef __unix__
+	img_ptr = EnviReader(config).readFile();
+#endif
 	// try GDAL first as it is better for some formats OpenCV reads, too (e.g. TIFF)
 #ifdef WITH_GDAL
-	img_ptr = GdalReader(config).readFile();
+	if (!img_ptr || img_ptr->empty())
+		img_ptr = GdalReader(config).readFile();
 #endif
 	
 	if (img_ptr && !img_ptr->empty()) {
-		// GdalReader was used successfully, applied roiChanges & bandCropping
+		// Envi/GdalReader was used successfully, applied roiChanges & bandCropping
 		roiChanged = true;
 		bandsCropped = true;
 	} else {
@@ -37,6 +44,9 @@ multi_img::ptr ImgInput::execute()
 	if (img_ptr->empty())
 		return img_ptr;
 
+	// ROI and band cropping are views on the data read in
+	bool cropped = false;
+
 	// apply ROI
 	if (!roiChanged && !config.roi.empty())
 	{
@@ -45,36 +55,49 @@ multi_img::ptr ImgInput::execute()
 			// Parsing of ROI String failed
 			std::cerr << "Ignoring invalid ROI specification" << std::endl;
 		} else {
-			applyROI(*img_ptr, roiVals);
+			applyROI(img_ptr, roiVals);
+			cropped = true;
 		}
 	}
 
 	// crop spectrum - maybe we used a fancy file reader that cropped the bands already
 	if (!bandsCropped)
-		cropSpectrum(*img_ptr);
+		cropped |= cropSpectrum(img_ptr);
 
 	// return empty image on failure
 	if (img_ptr->empty())
 		return img_ptr;
 
+	// all further preprocessing is done in one pass over the data
+	Pipeline pipeline;
+	size_t size = img_ptr->size();
+
 	// normalize L2 magnitudes
 	if (config.normalize) {
-		img_ptr->normalize_magnitudes();
+		pipeline.normalizeMagnitudes();
 	}
 
 	// compute gradient
 	if (config.gradient) {
-		img_ptr->apply_logarithm();
-		*img_ptr = img_ptr->spec_gradient();
+		pipeline.logarithm();
+		pipeline.gradient();
+		size--;
 	}
 
 	// reduce number of bands
-	if (config.bands > 0 && config.bands < (int)img_ptr->size()) {
-		*img_ptr = img_ptr->spec_rescale(config.bands);
+	if (config.bands > 0 && config.bands < (int)size) {
+		pipeline.rescale(config.bands);
 	}
 
 	// alter illumination
-	applyIllumination(*img_ptr);
+	if (config.removeIllum > 0)
+		pipeline.illuminant(Illuminant(config.removeIllum), true);
+	if (config.addIllum > 0)
+		pipeline.illuminant(Illuminant(config.addIllum), false);
+
+	// also copy cropped data, so the full input is released
+	if (cropped || !pipeline.empty())
+		img_ptr = pipeline.execute(*img_ptr);
 
 	return img_ptr;
 }
@@ -92,45 +115,33 @@ bool ImgInput::parseROIString(const std::string &str, std::vector<int> &vals)
 	return ctr == 3;
 }
 
-void ImgInput::applyROI(multi_img &img, std::vector<int>& vals)
+void ImgInput::applyROI(multi_img::ptr &img, std::vector<int>& vals)
 {
-	img = multi_img(img, cv::Rect(vals[0], vals[1], vals[2], vals[3]));
+	img = multi_img::ptr(new multi_img(*img,
+	                                   cv::Rect(vals[0], vals[1], vals[2], vals[3])));
 }
 
-void ImgInput::cropSpectrum(multi_img& img)
+bool ImgInput::cropSpectrum(multi_img::ptr &img)
 {
 	if ((config.bandlow > 0) ||
-		(config.bandhigh > 0 && config.bandhigh < (int)img.size() - 1)) {
+		(config.bandhigh > 0 && config.bandhigh < (int)img->size() - 1)) {
 
 		// if bandhigh is not specified, do not limit
 		int bandhigh =
-		        (config.bandhigh == 0) ? (img.size() - 1) : config.bandhigh;
+		        (config.bandhigh == 0) ? (img->size() - 1) : config.bandhigh;
 
 		// correct input?
-		if (config.bandlow > bandhigh || bandhigh > (int)img.size() - 1) {
+		if (config.bandlow > bandhigh || bandhigh > (int)img->size() - 1) {
 			std::cerr << "Inconsistent bandlow, bandhigh values specified!"
 			          << std::endl;
-			img = multi_img();
-			return;
+			img = multi_img::ptr(new multi_img());
+			return false;
 		}
 
-        img = multi_img(img, config.bandlow, bandhigh);
-	}
-}
-
-void ImgInput::applyIllumination(multi_img &img)
-{
-	if (config.removeIllum > 0) {
-		Illuminant il(config.removeIllum);
-		// first get normalization right for our range
-		il.setNormalization(img.meta[0].center, img.meta[img.size()-1].center);
-		img.apply_illuminant(il, true);
-	}
-	if (config.addIllum > 0) {
-		Illuminant il(config.addIllum);
-		il.setNormalization(img.meta[0].center, img.meta[img.size()-1].center);
-		img.apply_illuminant(il);
+		img = multi_img::ptr(new multi_img(*img, config.bandlow, bandhigh));
+		return true;
 	}
+	return false;
 }
 
 } //namespace
@@ -19,11 +19,11 @@ public:
 private:
 	const ImgInputConfig &config;
 
-	void applyROI(multi_img &img, std::vector<int> &vals);
+	// replace img by a view on the ROI
+	void applyROI(multi_img::ptr &img, std::vector<int> &vals);
 
-	void cropSpectrum(multi_img &img);
-
-	void applyIllumination(multi_img& img_ptr);
+	// replace img by a view on the band range, returns true if cropped
+	bool cropSpectrum(multi_img::ptr &img);
 };
 
 } // namespace
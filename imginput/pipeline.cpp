@@ -0,0 +1,245 @@
+#include "pipeline.h"
+
+#include <multi_img/band_ops.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <boost/make_shared.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace imginput {
+
+/// number of pixels sent through the stages together
+static const int TILE_WIDTH = 64;
+
+namespace {
+
+typedef Pipeline::Value Value;
+
+class NormalizeStage : public Pipeline::Stage {
+public:
+	virtual void setup(Pipeline::Format &format) { dim = format.size(); }
+
+	virtual void apply(const Value *in, Value *out, size_t count) const {
+		for (size_t p = 0; p < count; ++p, in += dim, out += dim) {
+			double n = 0.;
+			for (size_t d = 0; d < dim; ++d)
+				n += (double)in[d] * in[d];
+			n = std::sqrt(n);
+			if (n == 0.)
+				n = 1.;
+			double scale = 1. / n;
+			for (size_t d = 0; d < dim; ++d)
+				out[d] = (Value)(in[d] * scale);
+		}
+	}
+
+protected:
+	size_t dim;
+};
+
+class LogarithmStage : public Pipeline::Stage {
+public:
+	virtual void setup(Pipeline::Format &format) {
+		dim = format.size();
+		format.minval = 0.;
+		format.maxval = std::log(format.maxval);
+	}
+
+	virtual void apply(const Value *in, Value *out, size_t count) const {
+		const size_t n = count * dim;
+		// zero (and negative) values are mapped to 0
+		for (size_t i = 0; i < n; ++i)
+			out[i] = (in[i] > 0.f ? std::max(std::log(in[i]), 0.f) : 0.f);
+	}
+
+protected:
+	size_t dim;
+};
+
+class GradientStage : public Pipeline::Stage {
+public:
+	virtual void setup(Pipeline::Format &format) {
+		dim = format.size();
+		assert(dim > 1);
+		std::vector<Pipeline::BandDesc> meta(dim - 1);
+		for (size_t i = 0; i < dim - 1; ++i) {
+			if (!format.meta[i].empty && !format.meta[i+1].empty)
+				meta[i] = Pipeline::BandDesc(format.meta[i].center,
+											 format.meta[i+1].center);
+		}
+		format.meta.swap(meta);
+		format.minval = -format.maxval;
+	}
+
+	virtual void apply(const Value *in, Value *out, size_t count) const {
+		for (size_t p = 0; p < count; ++p, in += dim, out += dim - 1) {
+			for (size_t d = 0; d < dim - 1; ++d)
+				out[d] = in[d+1] - in[d];
+		}
+	}
+
+protected:
+	size_t dim;
+};
+
+/** Linear interpolation with the sampling of cv::resize(), expressed as
+	weighted source bands per output band (see band_ops::Mixing). */
+class RescaleStage : public Pipeline::Stage {
+public:
+	RescaleStage(size_t newsize)
+		: newsize(newsize), mixing(0, 0) {}
+
+	virtual void setup(Pipeline::Format &format) {
+		dim = format.size();
+		assert(newsize <= dim);
+		mixing = band_ops::Mixing::resampling(dim, newsize);
+
+		// interpolate wavelength metadata accordingly
+		cv::Mat_<float> tmpmeta1(cv::Size(dim, 1)), tmpmeta2;
+		for (size_t i = 0; i < dim; ++i)
+			tmpmeta1(0, i) = format.meta[i].center;
+		cv::resize(tmpmeta1, tmpmeta2, cv::Size(newsize, 1));
+		format.meta.resize(newsize);
+		for (size_t i = 0; i < newsize; ++i)
+			format.meta[i] = Pipeline::BandDesc(tmpmeta2(0, i));
+	}
+
+	virtual void apply(const Value *in, Value *out, size_t count) const {
+		for (size_t p = 0; p < count; ++p, in += dim, out += newsize) {
+			for (size_t d = 0; d < newsize; ++d) {
+				const std::vector<band_ops::Mixing::Term> &t = mixing.terms[d];
+				Value v = 0.f;
+				for (size_t i = 0; i < t.size(); ++i)
+					v += in[t[i].band] * t[i].weight;
+				out[d] = v;
+			}
+		}
+	}
+
+protected:
+	size_t newsize, dim;
+	band_ops::Mixing mixing;
+};
+
+class IlluminantStage : public Pipeline::Stage {
+public:
+	IlluminantStage(const Illuminant &il, bool remove)
+		: il(il), remove(remove) {}
+
+	virtual void setup(Pipeline::Format &format) {
+		il.setNormalization(format.meta.front().center,
+							format.meta.back().center);
+		coeff.resize(format.size());
+		for (size_t i = 0; i < coeff.size(); ++i)
+			coeff[i] = (Value)il.at(format.meta[i].center);
+	}
+
+	virtual void apply(const Value *in, Value *out, size_t count) const {
+		const size_t dim = coeff.size();
+		for (size_t p = 0; p < count; ++p, in += dim, out += dim) {
+			if (remove) {
+				for (size_t d = 0; d < dim; ++d)
+					out[d] = in[d] / coeff[d];
+			} else {
+				for (size_t d = 0; d < dim; ++d)
+					out[d] = in[d] * coeff[d];
+			}
+		}
+	}
+
+protected:
+	Illuminant il;
+	bool remove;
+	std::vector<Value> coeff;
+};
+
+}
+
+void Pipeline::normalizeMagnitudes()
+{
+	add(boost::make_shared<NormalizeStage>());
+}
+
+void Pipeline::logarithm()
+{
+	add(boost::make_shared<LogarithmStage>());
+}
+
+void Pipeline::gradient()
+{
+	add(boost::make_shared<GradientStage>());
+}
+
+void Pipeline::rescale(size_t newsize)
+{
+	add(boost::make_shared<RescaleStage>(newsize));
+}
+
+void Pipeline::illuminant(const Illuminant &il, bool remove)
+{
+	add(boost::make_shared<IlluminantStage>(il, remove));
+}
+
+multi_img::ptr Pipeline::execute(const multi_img &src)
+{
+	// determine the format of each stage's output
+	Format format;
+	format.meta = src.meta;
+	format.minval = src.minval;
+	format.maxval = src.maxval;
+	std::vector<size_t> sizes(1, format.size());
+	for (size_t i = 0; i < stages.size(); ++i) {
+		stages[i]->setup(format);
+		sizes.push_back(format.size());
+	}
+	const size_t maxsize = *std::max_element(sizes.begin(), sizes.end());
+	const size_t insize = sizes.front(), outsize = sizes.back();
+	const int width = src.width, height = src.height;
+
+	std::vector<multi_img::Band> bands(outsize);
+	for (size_t b = 0; b < outsize; ++b)
+		bands[b] = multi_img::Band(height, width);
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, height),
+		[&](const tbb::blocked_range<int> &r) {
+		std::vector<Value> buf1(TILE_WIDTH * maxsize), buf2(buf1.size());
+		for (int y = r.begin(); y != r.end(); ++y) {
+			for (int x0 = 0; x0 < width; x0 += TILE_WIDTH) {
+				const int n = std::min(TILE_WIDTH, width - x0);
+
+				// gather spectra of the tile
+				for (size_t b = 0; b < insize; ++b) {
+					const Value *row = src[b][y] + x0;
+					Value *dst = &buf1[b];
+					for (int x = 0; x < n; ++x, dst += insize)
+						*dst = row[x];
+				}
+
+				Value *cur = &buf1[0], *next = &buf2[0];
+				for (size_t i = 0; i < stages.size(); ++i) {
+					stages[i]->apply(cur, next, n);
+					std::swap(cur, next);
+				}
+
+				// scatter result into the output bands
+				for (size_t b = 0; b < outsize; ++b) {
+					Value *row = bands[b][y] + x0;
+					const Value *s = cur + b;
+					for (int x = 0; x < n; ++x, s += outsize)
+						row[x] = *s;
+				}
+			}
+		}
+	});
+
+	multi_img::ptr ret(new multi_img(bands, format.meta,
+									 boost::shared_ptr<void>()));
+	ret->minval = format.minval;
+	ret->maxval = format.maxval;
+	ret->roi = src.roi;
+	return ret;
+}
+
+} // namespace
@@ -0,0 +1,67 @@
+#ifndef IMGINPUT_PIPELINE_H
+#define IMGINPUT_PIPELINE_H
+
+#include <multi_img.h>
+#include <multi_img/illuminant.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+namespace imginput {
+
+/** Chain of spectral operators that is applied to a multi_img in one pass.
+	Each stage transforms the spectra of pixels, it may change the number of
+	bands. The image is processed tile by tile in parallel: a tile is gathered
+	from the input bands, sent through all stages in a small buffer and
+	scattered into the output bands. The input is read once, the result is
+	written once and no intermediate image is created.
+*/
+class Pipeline {
+public:
+	typedef multi_img::Value Value;
+	typedef multi_img::BandDesc BandDesc;
+
+	/// spectral layout and data range of the image between stages
+	struct Format {
+		std::vector<BandDesc> meta;
+		Value minval, maxval;
+		size_t size() const { return meta.size(); }
+	};
+
+	class Stage {
+	public:
+		virtual ~Stage() {}
+		/// prepare for input format, then update it to the output format
+		virtual void setup(Format &format) = 0;
+		/** transform count spectra. Spectra are stored one after another,
+			in with the input number of bands, out with the output number. */
+		virtual void apply(const Value *in, Value *out, size_t count) const = 0;
+	};
+	typedef boost::shared_ptr<Stage> StagePtr;
+
+	void add(StagePtr stage) { stages.push_back(stage); }
+
+	/// see multi_img::normalize_magnitudes()
+	void normalizeMagnitudes();
+	/// see multi_img::apply_logarithm()
+	void logarithm();
+	/// see multi_img::spec_gradient()
+	void gradient();
+	/// see multi_img::spec_rescale()
+	void rescale(size_t newsize);
+	/** see multi_img::apply_illuminant(), the illuminant is normalized to the
+		spectral range of the stage's input */
+	void illuminant(const Illuminant &il, bool remove);
+
+	bool empty() const { return stages.empty(); }
+
+	/** Run all stages on src. Without stages, the result is a copy.
+		Stages are set up for the format of src on every run. */
+	multi_img::ptr execute(const multi_img &src);
+
+protected:
+	std::vector<StagePtr> stages;
+};
+
+} // namespace
+
+#endif // IMGINPUT_PIPELINE_H
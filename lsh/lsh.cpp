@@ -16,14 +16,24 @@
 #include <iostream>
 #include "lsh.h"
 
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 //#define DEBUG
 //#define DEBUG_VERBOSE
 //#define VERBOSE_RANDOM
 
-LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
-		 bool dataDrivenPartitions, const vector<unsigned int> &subSet) :
+LSH::LSH(const data_t *data, unsigned int npoints, int dims, size_t stride,
+		 int K, int L,
+		 bool dataDrivenPartitions, const vector<unsigned int> &subSet,
+		 unsigned int seed) :
 		data(data),
-		dims(data[0].size()),
+		npoints(npoints),
+		dims(dims),
+		stride(stride),
 		K(K),
 		L(L),
 		dataDrivenPartitions(dataDrivenPartitions),
@@ -31,7 +41,8 @@ LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
 
 		/// variety of hashes should depend solely on dims and K
 		/// (original implementation used 3 * npoints * L / 256, but has fixed bucket lengths)
-		nbuckets(GetPrime(dims * K))
+		nbuckets(GetPrime(dims * K)),
+		rng(seed ? seed : rand())
 {
 #ifdef DEBUG
 	fprintf(stderr, "nbuckets=%d, bucketSize=%d\n", nbuckets, bucketSize);
@@ -41,16 +52,20 @@ LSH::LSH(const vector<vector<data_t> > &data, int K, int L,
 	assert(K > 0);
 	assert(L > 0);
 
-	/// initialize L hash tables, with nbuckets each
-	tables.assign(L, Htable(nbuckets));
-
 	/// initialize hash coefficients
 	for (int i = 0; i < max(K, L); i++)
-		hashCoeffs.push_back(rand());
+		hashCoeffs.push_back((int)(rng() & RAND_MAX));
 
+	/// cuts are drawn sequentially from our own generator
 	makeCuts();
 
-	fillTable();
+	/// tables are independent of each other
+	tables.resize(L);
+	tbb::parallel_for(tbb::blocked_range<int>(0, L),
+					  [&](const tbb::blocked_range<int> &r) {
+		for (int l = r.begin(); l != r.end(); ++l)
+			fillTable(l);
+	});
 }
 
 int LSH::GetPrime(int minp) {
@@ -71,11 +86,12 @@ int LSH::GetPrime(int minp) {
 
 void LSH::makeCuts()
 {
-	partitions.assign(L, vector<cut_t>(K));
+	cutDims.resize(L * K);
+	cutPos.resize(L * K);
+	vector<cut_t> cuts(K);
 
 	/// for each partition...
 	for (int l = 0; l < L; l++) {
-		partition_t &cuts = partitions[l];
 		int ncuts = 0;
 
 		/// every dimension gets K/dims cuts (that's the average)
@@ -103,11 +119,17 @@ void LSH::makeCuts()
 			fprintf(stderr, "(%d,%d) ", cuts[i].dim, cuts[i].pos);
 		fprintf(stderr, "\n");
 #endif // VERBOSE_RANDOM
+
+		for (int i = 0; i < K; i++) {
+			cutDims[l * K + i] = cuts[i].dim;
+			cutPos[l * K + i] = cuts[i].pos;
+		}
 	}
 }
 
 int LSH::random(int max) const {
-	return min((int) ((double) rand() / RAND_MAX * (max)), max);
+	return min((int) ((double) (rng() - rng.min()) / (rng.max() - rng.min())
+					  * (max)), max);
 }
 
 LSH::cut_t LSH::randomCut(int dim) const
@@ -117,7 +139,7 @@ LSH::cut_t LSH::randomCut(int dim) const
 	if (dataDrivenPartitions) {
 		int p;
 		if (subSet.empty()) {
-			p = random(data.size() - 1);
+			p = random(npoints - 1);
 		} else {
 			p = random(subSet.size() - 1);
 			p = subSet[p];
@@ -126,64 +148,111 @@ LSH::cut_t LSH::randomCut(int dim) const
 		fprintf(stderr, "LSH: rand: -> %d\n", p);
 #endif // VERBOSE_RANDOM
 		ret.dim = dim;
-		ret.pos = data[p][dim];
+		ret.pos = point(p)[dim];
 	} else {
 		ret.dim = dim;
 		/// assuming data_t is unsigned, this should yield the maximum value
 		double maxval = (data_t) -1;
-		ret.pos = min((int) ((double) rand() / RAND_MAX * (maxval)), (int) maxval);
+		ret.pos = random((int) maxval);
 	}
 
 	return ret;
 }
 
-void LSH::fillTable()
+void LSH::fillTable(int partIdx)
 {
-	/// for each partition
-	for (int l = 0; l < L; l++) {
-		Htable &table = tables[l];
-		/// for each point...
-		int n = subSet.empty() ? data.size() : subSet.size();
-		for (int p_i = 0; p_i < n; p_i++) {
-			int p = subSet.empty() ? p_i : subSet[p_i];
-			std::vector<bool> boolVec = getBoolVec(p, partitions[l]);
-			pair<int, int> hashes = hashFunc(boolVec, l);
-			int primaryHash = abs(hashes.first) % nbuckets;
+	Htable &table = tables[partIdx];
+	int n = subSet.empty() ? npoints : subSet.size();
+
+	/// hash all points, count bucket sizes
+	vector<int> buckets(n), secondaryHashes(n);
+	table.offsets.assign(nbuckets + 1, 0);
+	for (int p_i = 0; p_i < n; p_i++) {
+		int p = subSet.empty() ? p_i : subSet[p_i];
+		pair<int, int> hashes = hashFunc(point(p), partIdx);
+		int primaryHash = abs(hashes.first) % nbuckets;
 
 #ifdef DEBUG_VERBOSE
-			fprintf(stderr, "LSH::hashFunc point=%d, l=%d -> hashes.second=%d\n", p, l, hashes.second);
-			fprintf(stderr, "LSH::fillTable() Putting point %i into bucket %i (hashes.second=%d)\n", p, primaryHash, hashes.second);
+		fprintf(stderr, "LSH::hashFunc point=%d, l=%d -> hashes.second=%d\n", p, partIdx, hashes.second);
+		fprintf(stderr, "LSH::fillTable() Putting point %i into bucket %i (hashes.second=%d)\n", p, primaryHash, hashes.second);
 #endif // DEBUG_VERBOSE
 
-			/// insert new entry
-			table[primaryHash].push_back(Entry(p, hashes.second));;
-		}
+		buckets[p_i] = primaryHash;
+		secondaryHashes[p_i] = hashes.second;
+		table.offsets[primaryHash + 1]++;
+	}
+
+	/// bucket offsets
+	for (int b = 0; b < nbuckets; b++)
+		table.offsets[b + 1] += table.offsets[b];
+
+	/// insert entries, keeping the order of points within each bucket
+	table.entries.resize(n);
+	vector<unsigned int> fill(table.offsets.begin(), table.offsets.end() - 1);
+	for (int p_i = 0; p_i < n; p_i++) {
+		int p = subSet.empty() ? p_i : subSet[p_i];
+		table.entries[fill[buckets[p_i]]++] = Entry(p, secondaryHashes[p_i]);
 	}
 }
 
-std::vector<bool> LSH::getBoolVec(const std::vector<data_t> &point,
-								  const partition_t &part) const
+LSH::word_t LSH::getBits(const data_t *point, int first, int n) const
 {
-	std::vector<bool> ret(K);
-	for (int k = 0; k < K; k++)
-		ret[k] = point[part[k].dim] >= part[k].pos;
+	const int *dim = &cutDims[first];
+	const data_t *pos = &cutPos[first];
+	word_t ret = 0;
+	int k = 0;
+#ifdef __SSE2__
+	/// compare eight cuts at once. SSE2 only knows signed comparison, so
+	/// we flip the sign bit of both sides
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+	const __m128i zero = _mm_setzero_si128();
+	for (; k + 8 <= n; k += 8) {
+		__m128i vp = _mm_set_epi16(
+					point[dim[k+7]], point[dim[k+6]], point[dim[k+5]],
+					point[dim[k+4]], point[dim[k+3]], point[dim[k+2]],
+					point[dim[k+1]], point[dim[k]]);
+		__m128i vc = _mm_loadu_si128((const __m128i*)(pos + k));
+		/// pos > point, i.e. the inverse of our test
+		__m128i lt = _mm_cmpgt_epi16(_mm_xor_si128(vc, bias),
+									 _mm_xor_si128(vp, bias));
+		int mask = _mm_movemask_epi8(_mm_packs_epi16(lt, zero));
+		ret |= (word_t)(~mask & 0xFF) << k;
+	}
+#endif
+	for (; k < n; k++)
+		ret |= (word_t)(point[dim[k]] >= pos[k]) << k;
 	return ret;
 }
 
-std::vector<bool> LSH::getBoolVec(unsigned int point, const partition_t &part) const
+/// index of lowest set bit (w != 0)
+static inline int lowestBit(uint64_t w)
 {
-	return getBoolVec(data[point], part);
+#ifdef __GNUC__
+	return __builtin_ctzll(w);
+#else
+	int ret = 0;
+	while (!(w & 1)) {
+		w >>= 1;
+		ret++;
+	}
+	return ret;
+#endif
 }
 
-pair<int, int> LSH::hashFunc(const std::vector<bool>& boolVec, int partIdx) const
+pair<int, int> LSH::hashFunc(const data_t *point, int partIdx) const
 {
 	int primary = partIdx;
 	int secondary = partIdx;
-	for (int i = 1; i < K; i++) {
-		if (boolVec[i]) {
+	/// evaluate cuts 64 at a time, then visit the set bits
+	for (int first = 0; first < K; first += 64) {
+		word_t bits = getBits(point, partIdx * K + first, min(64, K - first));
+		if (first == 0)
+			bits &= ~(word_t)1; /// first bool does not contribute
+		while (bits) {
+			int i = first + lowestBit(bits);
 			primary += hashCoeffs[i];
-			if (i != 0) /// secondary skips first bool
-				secondary += hashCoeffs[i - 1];
+			secondary += hashCoeffs[i - 1]; /// secondary is shifted by one
+			bits &= bits - 1;
 		}
 	}
 
@@ -193,16 +262,15 @@ pair<int, int> LSH::hashFunc(const std::vector<bool>& boolVec, int partIdx) cons
 vector< vector<unsigned int> > LSH::getLargestBuckets(double p) const
 {
 	vector< vector<unsigned int> > ret;
-	unsigned int minCount = (int)p * data.size();
+	unsigned int minCount = (int)p * npoints;
 	for (int l = 0; l < L; ++l) {
 		const Htable &table = tables[l];
 		for (int k = 0; k < nbuckets; ++k) {
-			const vector<Entry> &bucket = table[k];
-			if (bucket.size() > minCount) {
+			unsigned int begin = table.offsets[k], end = table.offsets[k + 1];
+			if (end - begin > minCount) {
 				ret.push_back(vector<unsigned int>());
-				vector<Entry>::const_iterator it;
-				for (it = bucket.begin(); it != bucket.end(); ++it) {
-					ret.back().push_back(it->point);
+				for (unsigned int i = begin; i < end; ++i) {
+					ret.back().push_back(table.entries[i].point);
 				}
 			}
 		}
@@ -11,6 +11,8 @@
 
 #include <vector>
 #include <map>
+#include <random>
+#include <stdint.h>
 
 /// fixed size for partition data type
 #define K_MAX 70
@@ -29,7 +31,11 @@ class LSH
 
 	typedef unsigned short data_t;
 
+	/// boolean vectors are packed into words of this type
+	typedef uint64_t word_t;
+
 	struct Entry {
+		Entry() {}
 		Entry(unsigned int point, int secondaryHash)
 			: point(point), secondaryHash(secondaryHash) {}
 
@@ -44,14 +50,22 @@ class LSH
 		data_t pos;
 	};
 
-	typedef vector<cut_t> partition_t;
-
-	typedef vector< vector<Entry> > Htable;
+	/// hash table in CSR layout: entries of bucket b are found in
+	/// entries[offsets[b]] to entries[offsets[b+1]-1]
+	struct Htable {
+		vector<unsigned int> offsets;
+		vector<Entry> entries;
+	};
 
 public:
-	LSH(const vector<vector<data_t> > &data, int K, int L,
+	/// seed initializes the random cuts of this instance, with 0 it is
+	/// drawn from rand(). Instances with given seed can be built concurrently.
+	/// point p is found at data + p*stride and has dims elements
+	LSH(const data_t *data, unsigned int npoints, int dims, size_t stride,
+		int K, int L,
 		bool dataDrivenPartitions = true,
-		const vector<unsigned int> &subSet = vector<unsigned int>());
+		const vector<unsigned int> &subSet = vector<unsigned int>(),
+		unsigned int seed = 0);
 
 	~LSH() {}
 
@@ -61,12 +75,18 @@ public:
 private:
 	/// members:
 
-	/// interleaved data points
-	const vector<vector<data_t> > &data;
+	/// interleaved data points, row-wise
+	const data_t *data;
+
+	/// number of data points
+	const unsigned int npoints;
 
 	/// number of dimensions
 	const int dims;
 
+	/// distance between data points (in elements)
+	const size_t stride;
+
 	/// number of cuts per partition
 	const int K;
 
@@ -85,9 +105,19 @@ private:
 	/// hash tables
 	vector<Htable> tables;
 
-	vector< vector<cut_t> > partitions;
+	/// cuts of all partitions, K consecutive cuts for each partition
+	/// (dimension and position stored separately for vectorized tests)
+	vector<int> cutDims;
+	vector<data_t> cutPos;
+
 	vector<int> hashCoeffs;
 
+	/// random number generator of this instance
+	mutable std::minstd_rand rng;
+
+	/// coordinates of data point p
+	const data_t *point(unsigned int p) const { return data + p*stride; }
+
 	/// return random number in [0;size)
 	int random(int max) const;
 
@@ -98,17 +128,13 @@ private:
 
 	void makeCuts();
 
-	void fillTable();
-
-	/// determine boolean vector for given coordinates in a certain partition
-	std::vector<bool> getBoolVec(const std::vector<data_t> &point,
-								 const partition_t &part) const;
+	void fillTable(int partIdx);
 
-	/// determine boolean vector for an existing point in a certain partition
-	std::vector<bool> getBoolVec(unsigned int point, const partition_t &part) const;
+	/// determine boolean vector of cuts [first, first + n) (n <= 64)
+	word_t getBits(const data_t *point, int first, int n) const;
 
-	/// calculate primary and secondary hash
-	std::pair<int, int> hashFunc(const std::vector<bool>& boolVec, int partIdx) const;
+	/// calculate primary and secondary hash for coordinates in a partition
+	std::pair<int, int> hashFunc(const data_t *point, int partIdx) const;
 
 	/// return the smallest prime number greater than a given value
 	static int GetPrime(int minp);
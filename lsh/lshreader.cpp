@@ -3,36 +3,39 @@
 #include <cstdlib> // for int abs(int)
 #include <algorithm>
 
-LSHReader::LSHReader(const LSH& master)
+LSHReader::LSHReader(const LSH& master, ShortcutTable *shortcuts)
 	: lsh(master),
+	  primaryHashes(master.L), secondaryHashes(master.L),
+	  shortcuts(shortcuts ? shortcuts : &ownShortcuts),
 	  /// metadata array is initialized to 0, so first query gets tag 1
 	  queryTag(1)
 {
 	/// initialize metadata array
-	queryTags.assign(lsh.data.size(), 0);
+	queryTags.assign(lsh.npoints, 0);
 
 	/// initialize result state
 	result.valid = false;
-
-	/// initialize shortcut table
-	/// loosely based on original implementation, but should actually use nsel instead of npoints
-	shortcutTableSize = lsh.GetPrime(lsh.data.size() * 4);
-	shortcutTable.assign(shortcutTableSize, vector<ShortcutEntry>());
 }
 
+LSHReader::LSHReader(const LSHReader& other)
+	: lsh(other.lsh), result(other.result),
+	  primaryHashes(other.primaryHashes),
+	  secondaryHashes(other.secondaryHashes),
+	  ownShortcuts(other.ownShortcuts),
+	  /// keep sharing a shared table, but not the other's own table
+	  shortcuts(other.shortcuts == &other.ownShortcuts
+				? &ownShortcuts : other.shortcuts),
+	  queryTags(other.queryTags), queryTag(other.queryTag)
+{}
+
 /// perform query on given coordinates
 /// (expects array with dims elements)
-const void* LSHReader::query(const vector<LSH::data_t> &point,
+const void* LSHReader::query(const LSH::data_t *point,
 							 const void *endResult)
 {
-	vector<vector<bool> > boolVecs(lsh.L);
-	vector<int> primaryHashes(lsh.L);
-	vector<int> secondaryHashes(lsh.L);
-
-	/// determine boolean vector for all partitions
+	/// determine hashes for all partitions
 	for (int l = 0; l < lsh.L; l++) {
-		boolVecs[l] = lsh.getBoolVec(point, lsh.partitions[l]);
-		std::pair<int, int> hashes = lsh.hashFunc(boolVecs[l], l);
+		std::pair<int, int> hashes = lsh.hashFunc(point, l);
 		primaryHashes[l] = hashes.first;
 		secondaryHashes[l] = hashes.second;
 	}
@@ -49,29 +52,14 @@ const void* LSHReader::query(const vector<LSH::data_t> &point,
 			shortcutHash2 += primaryHashes[l + lsh.L/2] * lsh.hashCoeffs[l];
 		}
 
-		shortcutHash1 = abs(shortcutHash1) % shortcutTableSize;
-
-		/// find match in result cache
-		vector<ShortcutEntry> &bucket = shortcutTable.at(shortcutHash1);
-		vector<ShortcutEntry>::const_iterator bucketIt = bucket.begin();
-
-		const void *match = NULL;
-		for (; bucketIt != bucket.end(); ++bucketIt) {
-			const ShortcutEntry &entry = *bucketIt;
-			if (entry.secondaryHash == shortcutHash2) {
-				match = entry.p;
-				break;
-			}
-		}
-
-		if (match != NULL) {
-			return match;
-		} else {
-			/// no match, insert into result cache
-			ShortcutEntry newentry;
-			newentry.p = endResult;
-			newentry.secondaryHash = shortcutHash2;
-			shortcutTable.at(shortcutHash1).push_back(newentry);
+		/// find match in result cache, insert ourselves if there is none
+		/// (atomic, in case the table is shared)
+		uint64_t key = ((uint64_t)(unsigned int)shortcutHash1 << 32)
+				| (unsigned int)shortcutHash2;
+		ShortcutTable::const_accessor acc;
+		if (!shortcuts->insert(acc, std::make_pair(key, endResult))) {
+			if (acc->second != NULL)
+				return acc->second;
 		}
 	}
 
@@ -103,10 +91,11 @@ const void* LSHReader::query(const vector<LSH::data_t> &point,
 #endif // DEBUG_VERBOSE
 
 		/// inspect all entries in bucket
-		const vector<LSH::Entry> &bucket = lsh.tables[l][primaryHash];
-		vector<LSH::Entry>::const_iterator bucketIt;
+		const LSH::Htable &table = lsh.tables[l];
+		const LSH::Entry *bucketIt = table.entries.data() + table.offsets[primaryHash];
+		const LSH::Entry *bucketEnd = table.entries.data() + table.offsets[primaryHash + 1];
 
-		for (bucketIt = bucket.begin(); bucketIt != bucket.end(); ++bucketIt) {
+		for (; bucketIt != bucketEnd; ++bucketIt) {
 			const LSH::Entry &entry = *bucketIt;
 			int p = entry.point;
 			if (queryTags[p] == queryTag)
@@ -138,7 +127,7 @@ const void* LSHReader::query(const vector<LSH::data_t> &point,
 
 void LSHReader::query(unsigned int point)
 {
-	query(lsh.data[point], NULL);
+	query(lsh.point(point), NULL);
 }
 
 const std::vector<unsigned int>& LSHReader::getResult() const
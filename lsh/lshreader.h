@@ -2,19 +2,23 @@
 #define LSHREADER_H
 
 #include "lsh.h"
+#include <tbb/concurrent_hash_map.h>
+#include <stdint.h>
 
+/// Query interface to an LSH.
+/// The LSH itself is read-only, so any number of readers (e.g. one per
+/// thread) can work on the same LSH at the same time.
 class LSHReader
 {
-	struct ShortcutEntry {
-		/// secondary hash for more accurate results
-		int secondaryHash;
-
-		/// result pointer
-		const void *p;
-	};
-
 public:
-	LSHReader(const LSH& master);
+	/// shortcut hash table (maps both shortcut hashes, packed into 64 bit,
+	/// to a given pointer), may be shared between readers of the same LSH
+	typedef tbb::concurrent_hash_map<uint64_t, const void*> ShortcutTable;
+
+	/// If shortcuts is given, the reader uses this table instead of its own.
+	/// The table must outlive the reader.
+	LSHReader(const LSH& master, ShortcutTable *shortcuts = NULL);
+	LSHReader(const LSHReader& other);
 
 	/// Perform query on given coordinates.
 	/// If endResult is not NULL, the queried point will be associated
@@ -22,8 +26,13 @@ public:
 	/// the same intersection (i.e. same boolean vectors) will return
 	/// the pointer's value instead of NULL. The actual result will be empty.
 	/// This can serve as shortcut to the calling algorithm's final result.
-	const void *query(const vector<LSH::data_t> &point,
+	/// With a shared table, the pointer may stem from a query of another
+	/// reader. The caller is responsible to synchronize access to its target.
+	const void *query(const LSH::data_t *point,
 					  const void *endResult = 0);
+	const void *query(const vector<LSH::data_t> &point,
+					  const void *endResult = 0)
+	{ return query(&point[0], endResult); }
 
 	/// perform query on existing data point
 	void query(unsigned int point);
@@ -47,9 +56,12 @@ private:
 		vector<int> numByPartition;
 	} result;
 
-	/// shortcut hash table (maps queried points to a given pointer)
-	int shortcutTableSize;
-	vector< vector<ShortcutEntry> > shortcutTable;
+	/// hashes of the current query (kept to avoid re-allocation)
+	vector<int> primaryHashes, secondaryHashes;
+
+	/// shortcut hash table, either ownShortcuts or a shared one
+	ShortcutTable ownShortcuts;
+	ShortcutTable *shortcuts;
 
 	/// query tag for each data point
 	vector<unsigned int> queryTags;
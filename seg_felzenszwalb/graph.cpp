@@ -17,6 +17,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
 */
 
 #include "felzenszwalb.h"
+#include <radix_sort.h>
 #include <algorithm>
 #include <cmath>
 
@@ -25,6 +26,8 @@ namespace seg_felzenszwalb {
 // threshold function
 #define THRESHOLD(size, c) (c/size)
 
+static inline float edgeWeight(const edge &e) { return e.w; }
+
 //disjoint-set forest functions
 
 universe::universe(int elements) {
@@ -75,7 +78,7 @@ void universe::join(int x, int y) {
 universe* segment_graph(int num_vertices, int num_edges, edge *edges, float c)
 {
   // sort edges by weight
-  std::sort(edges, edges + num_edges);
+  radixSortFloat(edges, edges + num_edges, edgeWeight);
 
   // make a disjoint-set forest
   universe *u = new universe(num_vertices);
@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
 #include <sm_factory.h>
 #include <cstdlib>
 #include <boost/unordered_map.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 namespace seg_felzenszwalb {
 
@@ -37,65 +39,60 @@ std::pair<cv::Mat1i, segmap> segment_image(const multi_img &im,
 	int height = im.height;
 
 	// build graph
-	edge *edges = new edge[width*height*4];
-	std::vector<float> weights;
-	
-	int num = 0;
+	/* every pixel has edges to its right, lower, lower right and upper right
+	 * neighbor, if present. We know the number of edges of each row, so rows
+	 * are processed in parallel and write to their part of the array. */
+	std::vector<int> rowOffset(height + 1, 0);
 	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			cv::Point coord1(x, y);
-			const multi_img::Pixel &p1 = im(coord1);
-
-			if (x < width-1) {
-				edges[num].a = y * width + x;
-				edges[num].b = y * width + (x+1);
-				cv::Point coord2(x+1, y);
-				const multi_img::Pixel &p2 = im(coord2);
-				weights.push_back((float)distfun->
-								  getSimilarity(p1, p2, coord1, coord2));
-				num++;
-			}
-
-			if (y < height-1) {
-				edges[num].a = y * width + x;
-				edges[num].b = (y+1) * width + x;
-				cv::Point coord2(x, y+1);
-				const multi_img::Pixel &p2 = im(coord2);
-				weights.push_back((float)distfun->getSimilarity(p1, p2, coord1, coord2));
-				num++;
-			}
-
-			if ((x < width-1) && (y < height-1)) {
-				edges[num].a = y * width + x;
-				edges[num].b = (y+1) * width + (x+1);
-				cv::Point coord2(x+1, y+1);
-				const multi_img::Pixel &p2 = im(coord2);
-				weights.push_back((float)distfun->getSimilarity(p1, p2, coord1, coord2));
-				num++;
+		int count = (width - 1)
+				+ (y < height-1 ? width + (width - 1) : 0)
+				+ (y > 0 ? width - 1 : 0);
+		rowOffset[y + 1] = rowOffset[y] + count;
+	}
+	int num = rowOffset[height];
+	std::vector<edge> edges(num);
+
+	im.rebuildPixels();
+	tbb::parallel_for(tbb::blocked_range<int>(0, height),
+		[&](const tbb::blocked_range<int> &r) {
+		// compute edge weights of the row range in one batch
+		edge *first = edges.data() + rowOffset[r.begin()];
+		std::vector<std::pair<int, int> > pairs;
+		pairs.reserve(rowOffset[r.end()] - rowOffset[r.begin()]);
+		for (int y = r.begin(); y != r.end(); y++) {
+			for (int x = 0; x < width; x++) {
+				int i = y * width + x;
+				if (x < width-1)
+					pairs.push_back(std::make_pair(i, i + 1));
+				if (y < height-1)
+					pairs.push_back(std::make_pair(i, i + width));
+				if ((x < width-1) && (y < height-1))
+					pairs.push_back(std::make_pair(i, i + width + 1));
+				if ((x < width-1) && (y > 0))
+					pairs.push_back(std::make_pair(i, i - width + 1));
 			}
+		}
 
-			if ((x < width-1) && (y > 0)) {
-				edges[num].a = y * width + x;
-				edges[num].b = (y-1) * width + (x+1);
-				cv::Point coord2(x+1, y-1);
-				const multi_img::Pixel &p2 = im(coord2);
-				weights.push_back((float)distfun->getSimilarity(p1, p2, coord1, coord2));
-				num++;
-			}
+		std::vector<double> distances;
+		distfun->getSimilarities(im.pixelMatrix(), width, pairs, distances);
+		for (size_t i = 0; i < pairs.size(); ++i) {
+			first[i].a = pairs[i].first;
+			first[i].b = pairs[i].second;
+			first[i].w = (float)distances[i];
 		}
-	}
-	
+	});
+
 	if (config.eqhist) {
-		cv::Mat_<float> tmp(weights);
+		cv::Mat_<float> tmp(num, 1);
+		for (int i = 0; i < num; i++)
+			tmp(i) = edges[i].w;
 		equalizeHist(tmp, 20000);
+		for (int i = 0; i < num; i++)
+			edges[i].w = tmp(i);
 	}
-	
-	for (size_t i = 0; i < weights.size(); ++i)
-		edges[i].w = weights[i];
-	
 
 	// segment
-	universe *u = segment_graph(width*height, num, edges, config.c);
+	universe *u = segment_graph(width*height, num, edges.data(), config.c);
 
 	// post process small components
 	for (int i = 0; i < num; i++) {
@@ -105,7 +102,6 @@ std::pair<cv::Mat1i, segmap> segment_image(const multi_img &im,
 	    ((u->size(a) < config.min_size) || (u->size(b) < config.min_size)))
 		u->join(a, b);
 	}
-	delete[] edges;
 
 	// create index map and sets of segments
 	cv::Mat1i indices(height, width);
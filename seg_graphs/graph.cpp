@@ -58,6 +58,8 @@
 
 #include "graph.h"
 #include "graph_alg.h" // for geodesic
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
 namespace seg_graphs {
 
@@ -263,46 +265,95 @@ int Graph::neighbor_edge(int i,  /* edge index */
 	return -1; //never happens
 }
 
+void Graph::compute_distances(const multi_img &image, SimMeasure *distfun)
+{
+	bool gray = (image.size() == 1);
+
+	// make sure we don't run into cache misses
+	if (!gray)
+		image.rebuildPixels();
+	const multi_img::Band& band0 = image[0];
+
+	/* Rows are processed in tiles, in parallel. Vertical edges come first in
+	   the edge list (one per pixel of rows 0..height-2), then horizontal
+	   edges (width - 1 per row). Both parts of a tile are contiguous. */
+	int V = (height - 1) * width;
+	tbb::parallel_for(tbb::blocked_range<int>(0, height, 16),
+		[&](const tbb::blocked_range<int> &r) {
+		int vfirst = r.begin() * width;
+		int vlast = std::min(r.end(), height - 1) * width;
+		int hfirst = V + r.begin() * (width - 1);
+		int hlast = V + r.end() * (width - 1);
+
+		std::vector<int> index;
+		for (int i = vfirst; i < vlast; i++)
+			index.push_back(i);
+		for (int i = hfirst; i < hlast; i++)
+			index.push_back(i);
+
+		if (gray) {
+			for (size_t k = 0; k < index.size(); k++) {
+				Edge &e = edges[index[k]];
+				// hackish! rewrite edges code! width == number of columns
+				cv::Point coord1(e.nodes[0] % width, e.nodes[0] / width),
+				          coord2(e.nodes[1] % width, e.nodes[1] / width);
+				e.weight = std::abs(band0(coord1) - band0(coord2));
+			}
+			return;
+		}
+
+		// node indices are pixel indices, compute weights in one batch
+		std::vector<std::pair<int, int> > pairs(index.size());
+		for (size_t k = 0; k < index.size(); k++) {
+			const Edge &e = edges[index[k]];
+			pairs[k] = std::make_pair(e.nodes[0], e.nodes[1]);
+		}
+		std::vector<double> weights;
+		distfun->getSimilarities(image.pixelMatrix(), width, pairs, weights);
+		for (size_t k = 0; k < index.size(); k++)
+			edges[index[k]].weight = (float)weights[k];
+	});
+}
+
 /* ================================================================================================= */
 void Graph::color_standard_weights(const multi_img & image,
 						SimMeasure *distfun,
-						bool geodesic) {
+						bool geodesic,
+						EdgeWeightCache *cache) {
 /* ================================================================================================== */
 /* Computes weights inversely proportional to the image gradient for 2D images */
 
 	bool gray = (image.size() == 1);
 
-	// make sure we don't run into cache misses
-	if (!gray)
-		image.rebuildPixels();
-	const multi_img::Band& band0 = image[0];
+	if (cache && cache->size() == edges.size()) {
+		// same image as before, only seeds changed
+		for (unsigned int i = 0; i < edges.size(); i++)
+			edges[i].weight = (*cache)[i];
+	} else {
+		compute_distances(image, distfun);
+		if (cache) {
+			cache->resize(edges.size());
+			for (unsigned int i = 0; i < edges.size(); i++)
+				(*cache)[i] = edges[i].weight;
+		}
+	}
 
 	if (gray) {
 		max_weight = 255.f; // we will never adjust it
 	} else {
 		max_weight = 0.f;
-	}
-
-	// import edge coloring from image
-	for (unsigned int i = 0; i < edges.size(); i++) {
-		// hackish! rewrite edges code! width == number of columns
-		cv::Point coord1(edges[i].nodes[0] % width, edges[i].nodes[0] / width),
-		          coord2(edges[i].nodes[1] % width, edges[i].nodes[1] / width);
-
-		if (gray) {
-			edges[i].weight = std::abs(band0(coord1) - band0(coord2));
-		} else {
-			const multi_img::Pixel &p1 = image(coord1), &p2 = image(coord2);
-			edges[i].weight = (float)distfun->getSimilarity(p1, p2, coord1, coord2);
+		for (unsigned int i = 0; i < edges.size(); i++)
 			max_weight = std::max<float>(edges[i].weight, max_weight);
-		}
 	}
 
 	bucketsize = max_weight / 250.f; // TODO: make this user-selectable
 
 	if (!geodesic) {
-		for (unsigned int i = 0; i < edges.size(); i++)
-			edges[i].weight = max_weight - edges[i].weight;
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, edges.size()),
+			[&](const tbb::blocked_range<size_t> &r) {
+			for (size_t i = r.begin(); i != r.end(); i++)
+				edges[i].weight = max_weight - edges[i].weight;
+		});
 
 	/* RESULT:
 		edges[].weight: regular weights (maxw - X)
@@ -311,8 +362,11 @@ void Graph::color_standard_weights(const multi_img & image,
 		return;
 	}
 
-	for (unsigned int i = 0; i < edges.size(); i++)
-		edges[i].norm_weight = max_weight - edges[i].weight;
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, edges.size()),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t i = r.begin(); i != r.end(); i++)
+			edges[i].norm_weight = max_weight - edges[i].weight;
+	});
 
 	/* fill in initial weights for edges originating from seeds */
 	float *seeds_function = (float*)calloc(edges.size(), sizeof(float));
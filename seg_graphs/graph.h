@@ -17,6 +17,12 @@ namespace seg_graphs {
 
 typedef similarity_measures::SimilarityMeasure<multi_img::Value> SimMeasure;
 
+/** Distances of an image's edges, as computed by
+	Graph::color_standard_weights(). Allows to re-run segmentation with other
+	seeds without recomputation. Clear it when the image, its size or the
+	similarity measure change. */
+typedef std::vector<float> EdgeWeightCache;
+
 struct Edge {
 	int nodes[2];
 	float weight, norm_weight;
@@ -33,9 +39,9 @@ struct Graph {
 	/* buckets (for PowerWatershed_q2) */
 	int bucket(float weight);
 
-	/* graph coloring */
+	/* graph coloring, distances are taken from/stored in cache if given */
 	void color_standard_weights(const multi_img &image, SimMeasure *distfun,
-								bool geodesic);
+								bool geodesic, EdgeWeightCache *cache = 0);
 
 	/* graph algorithms: geodesic reconstruction */
 	void element_link_geod_dilate(int n, int p, int *Fth);
@@ -44,6 +50,10 @@ struct Graph {
 	/* graph algorithms: spanning forest & power watersheds */
 	cv::Mat1b MSF_Prim();
 	cv::Mat1b MSF_Kruskal();
+	/* seed independent maximum spanning tree, edges by decreasing weight */
+	std::vector<int> spanning_tree();
+	/* same as MSF_Kruskal, but only visits the edges of spanning_tree() */
+	cv::Mat1b MSF_Tree(const std::vector<int> &tree);
 	cv::Mat1b PowerWatershed_q2(bool geodesic, cv::Mat1b *out_proba);
 
 
@@ -59,6 +69,8 @@ struct Graph {
 private:
 	// build mesh. called by constructor
 	void generateEdges();
+	// set edge weights to pixel distances (in parallel)
+	void compute_distances(const multi_img &image, SimMeasure *distfun);
 };
 
 }
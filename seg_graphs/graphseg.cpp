@@ -26,10 +26,10 @@ namespace seg_graphs {
 
 cv::Mat1b GraphSeg::execute(const multi_img& input,
                                   const cv::Mat1b& seeds,
-                                  cv::Mat1b *proba_map) {
+                                  cv::Mat1b *proba_map,
+                                  EdgeWeightCache *weightCache) {
 	Stopwatch running_time("Total Running Time");
 	cv::Mat1b output;
-	int i;
 
 	if ((seeds.cols != input.width)||(seeds.rows != input.height)) {
 		std::cerr << "ERROR: Seed file dimensions do not match image dimensions!"
@@ -38,6 +38,35 @@ cv::Mat1b GraphSeg::execute(const multi_img& input,
 	}
 
 	Graph graph(seeds.cols, seeds.rows);
+	setSeeds(graph, seeds);
+
+	Stopwatch watch;
+	if (config.algo == WATERSHED2) {
+		/* Kruskal & RW on plateaus multiseeds linear time */
+
+		colorGraph(graph, input, true, weightCache);
+		watch.print_reset("Graph coloring");
+		// for PW, color_standard_weights is always called with geodesic = true
+		output = graph.PowerWatershed_q2(config.geodesic, proba_map);
+		watch.print("Segmentation");
+	} else {
+		colorGraph(graph, input, config.geodesic, weightCache);
+		watch.print_reset("Graph coloring");
+		if (config.algo == KRUSKAL) { // Kruskal
+			output = graph.MSF_Kruskal();
+		} else if (config.algo == PRIM) { // Prim RB tree
+			output = graph.MSF_Prim();
+		}
+		watch.print("Segmentation");
+	}
+
+	return output;
+}
+
+void GraphSeg::setSeeds(Graph &graph, const cv::Mat1b &seeds) const
+{
+	int i;
+	graph.seeds.clear();
 
 	/* extract seeds */
 	cv::Mat1b::const_iterator it;
@@ -60,12 +89,19 @@ cv::Mat1b GraphSeg::execute(const multi_img& input,
 			}
 		}
 	}
+}
 
-	// edge weights
-	similarity_measures::SimilarityMeasure<multi_img::Value> *distfun;
+void GraphSeg::colorGraph(Graph &graph, const multi_img &input, bool geodesic,
+                          EdgeWeightCache *weightCache) const
+{
+	// edge weights (distances are not needed if we have them already)
+	bool cached = (weightCache && weightCache->size() == graph.edges.size());
+	similarity_measures::SimilarityMeasure<multi_img::Value> *distfun = 0;
 #ifdef WITH_SOM
 	boost::shared_ptr<som::GenSOM> som; // create in this scope for survival
-	if (!config.som_similarity) {
+	if (cached) {
+		// nothing to do
+	} else if (!config.som_similarity) {
 		distfun = similarity_measures::SMFactory<multi_img::Value>
 				::spawn(config.similarity);
 	} else {
@@ -75,33 +111,46 @@ cv::Mat1b GraphSeg::execute(const multi_img& input,
 		distfun = new som::SOMDistance<multi_img::Value>(*som, input);
 	}
 #else
-	distfun = SMFactory<multi_img::Value>::spawn(config.similarity);
+	if (!cached)
+		distfun = similarity_measures::SMFactory<multi_img::Value>
+				::spawn(config.similarity);
 #endif
 
-	assert(distfun);
+	assert(cached || distfun);
 
-	Stopwatch watch;
-	if (config.algo == WATERSHED2) {
-		/* Kruskal & RW on plateaus multiseeds linear time */
+	graph.color_standard_weights(input, distfun, geodesic, weightCache);
 
-		graph.color_standard_weights(input, distfun, true);
-		watch.print_reset("Graph coloring");
-		// for PW, color_standard_weights is always called with geodesic = true
-		output = graph.PowerWatershed_q2(config.geodesic, proba_map);
-		watch.print("Segmentation");
-	} else {
-		graph.color_standard_weights(input, distfun, config.geodesic);
-		watch.print_reset("Graph coloring");
-		if (config.algo == KRUSKAL) { // Kruskal
-			output = graph.MSF_Kruskal();
-		} else if (config.algo == PRIM) { // Prim RB tree
-			output = graph.MSF_Prim();
-		}
-		watch.print("Segmentation");
+	delete distfun;
+}
+
+cv::Mat1b GraphSegSession::execute(const multi_img& input,
+                                   const cv::Mat1b& seeds) {
+	GraphSeg seg(config);
+
+	/* With geodesic reconstruction, the weights depend on the seeds, and
+	   power watersheds needs the whole graph. Only distances are kept. */
+	if (config.algo == WATERSHED2 || config.geodesic)
+		return seg.execute(input, seeds, 0, &weights);
+
+	if ((seeds.cols != input.width)||(seeds.rows != input.height)) {
+		std::cerr << "ERROR: Seed file dimensions do not match image dimensions!"
+		          << std::endl;
+		return cv::Mat1b();
 	}
 
-	delete distfun;
+	Stopwatch watch;
+	if (!graph || graph->width != input.width
+	    || graph->height != input.height) {
+		graph = boost::shared_ptr<Graph>(new Graph(input.width, input.height));
+		seg.colorGraph(*graph, input, false, &weights);
+		watch.print_reset("Graph coloring");
+		tree = graph->spanning_tree();
+		watch.print_reset("Spanning tree");
+	}
 
+	seg.setSeeds(*graph, seeds);
+	cv::Mat1b output = graph->MSF_Tree(tree);
+	watch.print("Segmentation");
 	return output;
 }
 
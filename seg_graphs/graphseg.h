@@ -2,7 +2,9 @@
 #define GRAPHSEG_H
 
 #include "graphseg_config.h"
+#include "graph.h"
 #include <multi_img.h>
+#include <boost/shared_ptr.hpp>
 
 namespace seg_graphs {
 
@@ -10,9 +12,21 @@ class GraphSeg {
 public:
 	GraphSeg(const GraphSegConfig& config) : config(config) {}
 
+	/** Segment input according to seeds.
+	    @arg weightCache if given, edge distances are read from it when it is
+	                     filled, or stored in it otherwise (see EdgeWeightCache)
+	*/
 	cv::Mat1b execute(const multi_img& input,
 	                       const cv::Mat1b& seeds,
-	                       cv::Mat1b *proba_map = 0);
+	                       cv::Mat1b *proba_map = 0,
+	                       EdgeWeightCache *weightCache = 0);
+
+	/// fill graph.seeds and graph.max_label from a seed image
+	void setSeeds(Graph &graph, const cv::Mat1b &seeds) const;
+
+	/// set edge weights of graph according to the configured measure
+	void colorGraph(Graph &graph, const multi_img &input, bool geodesic,
+	                EdgeWeightCache *weightCache = 0) const;
 
 private:
 	static cv::Rect bbox(const cv::Mat1b& seeds);
@@ -20,5 +34,30 @@ private:
 	const GraphSegConfig &config;
 };
 
+/** Repeated segmentation of one image with changing seeds, e.g. while the
+	user edits them in the GUI.
+
+	The weighted graph and its seed independent maximum spanning tree are kept
+	between calls. Each call then only propagates the seeds along the tree
+	edges, which are already sorted. The result is the same as with
+	GraphSeg::execute() (up to the order of equal weights).
+
+	For geodesic weights and power watersheds, only the edge distances are
+	kept. Create a new session when the image or the configuration change.
+*/
+class GraphSegSession {
+public:
+	GraphSegSession(const GraphSegConfig& config) : config(config) {}
+
+	/// segment input according to seeds
+	cv::Mat1b execute(const multi_img& input, const cv::Mat1b& seeds);
+
+private:
+	GraphSegConfig config;
+	EdgeWeightCache weights;
+	boost::shared_ptr<Graph> graph;
+	std::vector<int> tree;
+};
+
 }
 #endif
@@ -7,12 +7,19 @@ class GraphSegTask : public BackgroundTask {
 public:
 	GraphSegTask(const seg_graphs::GraphSegConfig &config,
 				 SharedMultiImgPtr input,
-				 const cv::Mat1s &seedMap, boost::shared_ptr<cv::Mat1s> result)
-		: config(config), input(input), seedMap(seedMap), result(result) {}
+				 const cv::Mat1s &seedMap, boost::shared_ptr<cv::Mat1s> result,
+				 boost::shared_ptr<seg_graphs::GraphSegSession> session =
+					 boost::shared_ptr<seg_graphs::GraphSegSession>())
+		: config(config), input(input), seedMap(seedMap), result(result),
+		  session(session) {}
 	virtual ~GraphSegTask() {}
 	virtual bool run()	{
-		seg_graphs::GraphSeg seg(config);
-		*(result.get()) = seg.execute(**input, seedMap);
+		if (session) {
+			*(result.get()) = session->execute(**input, seedMap);
+		} else {
+			seg_graphs::GraphSeg seg(config);
+			*(result.get()) = seg.execute(**input, seedMap);
+		}
 		return true;
 	}
 
@@ -21,6 +28,8 @@ protected:
 	SharedMultiImgPtr input;
 	cv::Mat1s seedMap;
 	boost::shared_ptr<cv::Mat1s> result;
+	// keeps the graph between runs, may be empty
+	boost::shared_ptr<seg_graphs::GraphSegSession> session;
 };
 
 #endif // GRAPH_SEG_TASK_H
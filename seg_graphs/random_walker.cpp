@@ -60,9 +60,222 @@ extern "C" {
 }
 #include "graph_alg.h"
 #include "sorting.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
 
 namespace seg_graphs {
 
+/* systems up to this size are solved by LU factorization, larger ones by
+   conjugate gradients (the LU factors of big laplacians become huge) */
+#define RW_DIRECT_MAX_SIZE 20000
+/* relative residual at which conjugate gradients stop */
+#define RW_CG_TOLERANCE 1e-8
+
+/*===============================*/
+class LaplacianSolver {
+/*===============================*/
+/* Solves A x = b for several right hand sides, A being the laplacian of the
+   unseeded nodes (symmetric positive definite). The matrix is analyzed once:
+   small systems are LU-factorized, for large ones an incomplete Cholesky
+   factorization IC(0) serves as preconditioner for conjugate gradients.
+   solve() does not modify the solver and may be called concurrently. */
+public:
+	LaplacianSolver(const cs *A)
+		: n(A->n), S(NULL), F(NULL)
+	{
+		if (n == 0) {
+			good = true;                         // nothing to solve
+		} else if (n <= RW_DIRECT_MAX_SIZE) {
+			S = cs_sqr(1, A, 0);                 // ordering, symbolic analysis
+			F = (S ? cs_lu(A, S, 1e-7) : NULL);  // numeric LU factorization
+			good = (S && F);
+		} else {
+			good = incompleteCholesky(A);
+		}
+	}
+
+	~LaplacianSolver()
+	{
+		cs_sfree(S);
+		cs_nfree(F);
+	}
+
+	bool ok() const { return good; }
+
+	/* b is overwritten with the solution */
+	bool solve(double *b) const
+	{
+		if (!good)
+			return false;
+		if (n == 0)
+			return true;
+		if (F)
+			return solveDirect(b);
+		return solveCG(b);
+	}
+
+private:
+	bool solveDirect(double *b) const
+	{
+		std::vector<double> x(n);
+		cs_ipvec(F->pinv, b, &x[0], n);      // x = b(p)
+		cs_lsolve(F->L, &x[0]);              // x = L\x
+		cs_usolve(F->U, &x[0]);              // x = U\x
+		cs_ipvec(S->q, &x[0], b, n);         // b(q) = x
+		return true;
+	}
+
+	/* A is symmetric, so its columns (CSC) are also its rows. We keep a copy
+	   with sorted rows, and the lower triangle of the IC(0) factor L with the
+	   same pattern (diagonal last in each row). */
+	bool incompleteCholesky(const cs *A)
+	{
+		rowptr.assign(n + 1, 0);
+		std::vector<std::pair<int, double> > row;
+		for (int j = 0; j < n; j++) {
+			row.clear();
+			for (int p = A->p[j]; p < A->p[j + 1]; p++)
+				row.push_back(std::make_pair(A->i[p], A->x[p]));
+			std::sort(row.begin(), row.end());
+			for (size_t k = 0; k < row.size(); k++) {
+				cols.push_back(row[k].first);
+				vals.push_back(row[k].second);
+			}
+			rowptr[j + 1] = cols.size();
+		}
+
+		lptr.assign(n + 1, 0);
+		for (int i = 0; i < n; i++) {
+			for (int p = rowptr[i]; p < rowptr[i + 1] && cols[p] <= i; p++) {
+				lcol.push_back(cols[p]);
+				lval.push_back(vals[p]);
+			}
+			lptr[i + 1] = lcol.size();
+			if (lcol.empty() || lcol.back() != i)
+				return false; // missing diagonal
+		}
+
+		for (int i = 0; i < n; i++) {
+			int diag = lptr[i + 1] - 1;
+			for (int p = lptr[i]; p < diag; p++) {
+				int k = lcol[p];
+				// dot product of rows i and k left of column k
+				double sum = lval[p];
+				int q = lptr[i], r = lptr[k];
+				while (q < p && r < lptr[k + 1] - 1) {
+					if (lcol[q] < lcol[r])
+						q++;
+					else if (lcol[q] > lcol[r])
+						r++;
+					else
+						sum -= lval[q++] * lval[r++];
+				}
+				lval[p] = sum / lval[lptr[k + 1] - 1];
+			}
+			double d = lval[diag];
+			for (int p = lptr[i]; p < diag; p++)
+				d -= lval[p] * lval[p];
+			if (d <= 0.)
+				return false; // not positive definite
+			lval[diag] = std::sqrt(d);
+		}
+		return true;
+	}
+
+	/* z = (L L^T)^-1 r */
+	void precondition(const std::vector<double> &r,
+					  std::vector<double> &z) const
+	{
+		for (int i = 0; i < n; i++) {
+			int diag = lptr[i + 1] - 1;
+			double sum = r[i];
+			for (int p = lptr[i]; p < diag; p++)
+				sum -= lval[p] * z[lcol[p]];
+			z[i] = sum / lval[diag];
+		}
+		for (int i = n - 1; i >= 0; i--) {
+			int diag = lptr[i + 1] - 1;
+			z[i] /= lval[diag];
+			for (int p = lptr[i]; p < diag; p++)
+				z[lcol[p]] -= lval[p] * z[i];
+		}
+	}
+
+	/* y = A x, rows in parallel */
+	void multiply(const std::vector<double> &x, std::vector<double> &y) const
+	{
+		tbb::parallel_for(tbb::blocked_range<int>(0, n, 4096),
+			[&](const tbb::blocked_range<int> &range) {
+			for (int i = range.begin(); i != range.end(); i++) {
+				double sum = 0.;
+				for (int p = rowptr[i]; p < rowptr[i + 1]; p++)
+					sum += vals[p] * x[cols[p]];
+				y[i] = sum;
+			}
+		});
+	}
+
+	static double dot(const std::vector<double> &a,
+					  const std::vector<double> &b)
+	{
+		double sum = 0.;
+		for (size_t i = 0; i < a.size(); i++)
+			sum += a[i] * b[i];
+		return sum;
+	}
+
+	bool solveCG(double *b) const
+	{
+		std::vector<double> x(n, 0.), r(b, b + n), z(n), p(n), q(n);
+		double norm_b = std::sqrt(dot(r, r));
+		if (norm_b == 0.) {
+			std::fill(b, b + n, 0.);
+			return true;
+		}
+
+		precondition(r, z);
+		p = z;
+		double rz = dot(r, z);
+		bool converged = false;
+		for (int it = 0; it < n && !converged; it++) {
+			multiply(p, q);
+			double alpha = rz / dot(p, q);
+			for (int i = 0; i < n; i++) {
+				x[i] += alpha * p[i];
+				r[i] -= alpha * q[i];
+			}
+			converged = (std::sqrt(dot(r, r)) <= RW_CG_TOLERANCE * norm_b);
+			if (converged)
+				break;
+
+			precondition(r, z);
+			double rz_new = dot(r, z);
+			double beta = rz_new / rz;
+			rz = rz_new;
+			for (int i = 0; i < n; i++)
+				p[i] = z[i] + beta * p[i];
+		}
+		std::copy(x.begin(), x.end(), b);
+		return converged;
+	}
+
+	int n;
+	bool good;
+	// direct solver
+	css *S;
+	csn *F;
+	// iterative solver: A and L in compressed row form
+	std::vector<int> rowptr, cols, lptr, lcol;
+	std::vector<double> vals, lval;
+
+	LaplacianSolver(const LaplacianSolver&);
+	LaplacianSolver& operator=(const LaplacianSolver&);
+};
+
 /*===============================*/
 bool fill_A(cs   * A,               /* matrix A to fill */
 			int  N,                 /* nb of nodes */
@@ -251,60 +464,51 @@ bool RandomWalker(int      ** index_edges,     /* list of edges */
 		B = cs_compress(B2);
 		cs_spfree(B2);
 
-		// building the right hand side of the system
-		cs     * X = cs_spalloc(numb_boundary, 1, numb_boundary, 1, 1);
-		cs     * X2;
-		int    rnz, cpt;
-		cs     * b_tmp;
-		double *b = (double *)malloc((N - numb_boundary) * sizeof(double));
-		for (l = 0; l < nb_labels - 1; l++) {
-			// building vector X
-			rnz = 0;
-			for (i = 0; i < numb_boundary; i++) {
-				X->x[rnz] = boundary_values[l][i];
-				X->p[rnz] = 0;
-				X->i[rnz] = i;
-				rnz++;
+		// factorize once for all labels
+		LaplacianSolver solver(A);
+		bool success = solver.ok();
+
+		// unseeded nodes in order of the system's unknowns
+		std::vector<int> unseeded;
+		for (k = 0; k < N; k++)
+			if (seeded_vertex[k] == false)
+				unseeded.push_back(k);
+
+		// solve for all labels in parallel
+		std::vector<char> solved(nb_labels - 1, 1);
+		tbb::parallel_for(tbb::blocked_range<int>(0, nb_labels - 1, 1),
+			[&](const tbb::blocked_range<int> &range) {
+			for (int l = range.begin(); l != range.end(); l++) {
+				// building the right hand side of the system: b = -B X
+				std::vector<double> b(N - numb_boundary, 0.);
+				for (int j = 0; j < numb_boundary; j++)
+					for (int p = B->p[j]; p < B->p[j + 1]; p++)
+						b[B->i[p]] -= B->x[p] * boundary_values[l][j];
+
+				if (!b.empty() && !solver.solve(&b[0]))
+					solved[l] = 0;
+
+				for (size_t u = 0; u < unseeded.size(); u++)
+					proba[l][index[unseeded[u]]] = b[u];
+
+				//Enforce boundaries exactly
+				for (int s = 0; s < numb_boundary; s++)
+					proba[l][index[index_seeds[s]]] =
+						(double)boundary_values[l][s];
 			}
-			X->nz = rnz;
-			X->m  = numb_boundary;
-			X->n  = 1;
-
-			X2    = cs_compress(X);
-			b_tmp = cs_multiply(B, X2);
-
-			for (i = 0; i < N - numb_boundary; i++)
-				b[i] = 0;
-
-			for (i = 0; i < b_tmp->nzmax; i++)
-				b[b_tmp->i[i]] = -b_tmp->x[i];
-
-			//solve Ax=b by LU decomposition, order = 1
-			cs_lusol(1, A, b, 1e-7);
-
-			cpt = 0;
-			for (k = 0; k < N; k++)
-				if (seeded_vertex[k] == false) {
-					proba[l][index[k]] = (double)b[cpt];
-					cpt++;
-				}
-
-			//Enforce boundaries exactly
-			for (k = 0; k < numb_boundary; k++)
-				proba[l][index[index_seeds[k]]] =
-					(double)boundary_values[l][k];
-			cs_spfree(X2);
-			cs_spfree(b_tmp);
-		}
+		});
+		for (l = 0; l < nb_labels - 1; l++)
+			success = success && solved[l];
 
 		free(seeded_vertex);
 		free(indic_sparse);
 		free(nb_same_edges);
-		cs_spfree(X);
 		cs_spfree(A);
 		cs_spfree(B);
-		free(b);
-		return true;
+		if (!success)
+			printf("RandomWalker: solving the system failed (%d nodes).\n",
+				   N - numb_boundary);
+		return success;
 	}
 
 	free(seeded_vertex);
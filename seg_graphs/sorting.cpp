@@ -75,6 +75,7 @@
 #endif
 
 #include "sorting.h"
+#include <radix_sort.h>
 
 #include <algorithm>
 #include <vector>
@@ -299,6 +300,8 @@ bool Score::operator<(const Score& score) const
 	return (value < score.value);
 }
 
+static inline float scoreValue(const Score &s) { return s.value; }
+
 
 /* =============================================================== */
 void sortRange(float * F, int * Es, int M, bool reverse)
@@ -312,7 +315,9 @@ void sortRange(float * F, int * Es, int M, bool reverse)
 		data[k] = entry;
 	}
 
-	sort(data.begin(), data.end());
+	// parallel and stable
+	if (M > 0)
+		radixSortFloat(&data[0], &data[0] + M, scoreValue);
 
 	if (reverse) {
 		for (int k=0; k<M; k++) {
@@ -59,8 +59,11 @@
 #include "graph_alg.h"
 #include "sorting.h"
 #include "graph.h"
+#include <radix_sort.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <limits>
-#include <set>
+#include <queue>
 #include <stack>
 #include <cstdio>
 
@@ -69,6 +72,18 @@ namespace seg_graphs {
 #define epsilon std::numeric_limits<float>::epsilon()
 #define SIZE_MAX_PLATEAU 1000000
 
+/* queue entry for Prim's algorithm. Ordered by value, equal values in order
+   of insertion (seq) */
+struct PrimEntry {
+	float value;
+	long seq;
+	int index;
+	bool operator>(const PrimEntry& o) const
+	{ return value > o.value || (value == o.value && seq > o.seq); }
+};
+typedef std::priority_queue<PrimEntry, std::vector<PrimEntry>,
+							std::greater<PrimEntry> > PrimQueue;
+
 /*=====================================================================================*/
 cv::Mat1b Graph::MSF_Prim() {
 /*=====================================================================================*/
@@ -83,7 +98,8 @@ cv::Mat1b Graph::MSF_Prim() {
 		G[seeds[i].first] = seeds[i].second;
 
 	std::vector<bool> indics(M, false);
-	std::multiset<Score> L;
+	PrimQueue L;
+	long seq = 0;
 	i = 0;
 
 	// initialize at seed points
@@ -92,8 +108,8 @@ cv::Mat1b Graph::MSF_Prim() {
 			for (x = 1; x <= degree; x++) {
 				y = neighbor_node_edge(seeds[i].first, x);
 				if ((y != -1) && (!indics[y])) {
-					Score entry = { max_weight - edges[y].weight, y };
-					L.insert(entry);
+					PrimEntry entry = { max_weight - edges[y].weight, seq++, y };
+					L.push(entry);
 					indics[y] = true;
 				}
 			}
@@ -102,8 +118,8 @@ cv::Mat1b Graph::MSF_Prim() {
 	}
 
 	while (!L.empty()) {
-		u = L.begin()->index;
-		L.erase(L.begin());
+		u = L.top().index;
+		L.pop();
 		x = edges[u].nodes[0];
 		y = edges[u].nodes[1];
 		if (G[x] > G[y]) {
@@ -119,8 +135,8 @@ cv::Mat1b Graph::MSF_Prim() {
 					y_1 = edges[v].nodes[1];
 					if   ((std::min<unsigned char>(G[x_1], G[y_1]) == 0)
 					    &&(std::max<unsigned char>(G[x_1], G[y_1]) >  0)) {
-						Score entry = { max_weight - edges[v].weight, v };
-						L.insert(entry);
+						PrimEntry entry = { max_weight - edges[v].weight, seq++, v };
+						L.push(entry);
 						indics[v] = true;
 					}
 				}
@@ -141,128 +157,226 @@ cv::Mat1b Graph::MSF_Prim() {
 
 
 
-/*=====================================================================*/
-cv::Mat1b Graph::MSF_Kruskal() {
-/*=====================================================================*/
-/*returns a segmentation performed by Kruskal's algorithm for Maximum Spanning Forest computation*/
-	int i, k, x, y, e1, e2;
-	int N, M;
-
-	N = width * height; /* number of vertices */
-	M = edges.size(); /*number of edges*/
-
-	int * Mrk = (int*)calloc(N, sizeof(int));
-	if (Mrk == NULL) {
-		fprintf(stderr, "lMSF() : malloc failed\n"); exit(0);
-	}
-	for (i = 0; i < seeds.size(); i++) {
-		Mrk[seeds[i].first] = seeds[i].second;
-	}
-	int * Rnk = (int*)calloc(N, sizeof(int));
-	if (Rnk == NULL) {
-		fprintf(stderr, "lMSF() : malloc failed\n"); exit(0);
-	}
-	int * Fth = (int*)malloc(N * sizeof(int));
-	if (Fth == NULL) {
-		fprintf(stderr, "lMSF() : malloc failed\n"); exit(0);
-	}
-	for (k = 0; k < N; k++) {
-		Fth[k] = k;
+/* Seeded maximum spanning forest by Filter-Kruskal.
+   Edges are processed by decreasing weight. Two trees are joined unless both
+   contain a seed. Instead of sorting all edges up front, they are split at a
+   pivot weight. After the heavy part is processed, light edges within a tree
+   or between two seeded trees can never be used and are filtered out (in
+   parallel) before the light part is processed. Most edges of a typical
+   image graph are dropped this way without ever being sorted. */
+class SeededKruskal {
+public:
+	/// tree, if given, receives the merged edges in order of processing
+	SeededKruskal(const std::vector<Edge> &edges, int N,
+				  const std::vector<std::pair<int, unsigned char> > &seeds,
+				  std::vector<int> *tree = 0)
+		: edges(edges), Fth(N), Rnk(N, 0), Mrk(N, 0), tree(tree), merged(0),
+		  target(N - std::max((int)seeds.size(), 1))
+	{
+		for (int k = 0; k < N; k++)
+			Fth[k] = k;
+		for (size_t i = 0; i < seeds.size(); i++)
+			Mrk[seeds[i].first] = seeds[i].second;
 	}
 
-	// create indices sorted by edge weight, descending
-	int *Es = new int[M];
+	/// process edge indices es (invalidated)
+	void run(std::vector<int> &es)
 	{
-		std::vector<Score> sorter(M);
-		for (k = 0; k < M; k++) {
-			Score entry = { edges[k].weight, k };
-			sorter[k] = entry;
+		if (done())
+			return;
+
+		if (es.size() < baseSize) {
+			sortAndMerge(es);
+			return;
+		}
+
+		// pivot: median of a sample
+		std::vector<float> sample;
+		size_t step = es.size() / 127;
+		for (size_t i = 0; i < es.size(); i += step)
+			sample.push_back(edges[es[i]].weight);
+		std::nth_element(sample.begin(), sample.begin() + sample.size() / 2,
+						 sample.end());
+		float pivot = sample[sample.size() / 2];
+
+		std::vector<int> heavy, light;
+		heavy.reserve(es.size() / 2);
+		light.reserve(es.size() / 2);
+		for (size_t i = 0; i < es.size(); i++) {
+			if (edges[es[i]].weight > pivot)
+				heavy.push_back(es[i]);
+			else
+				light.push_back(es[i]);
 		}
-		std::sort(sorter.begin(), sorter.end());
-		for (k = 0; k < M; k++) {
-			Es[k] = sorter[M - k - 1].index;
+		if (heavy.empty()) { // no progress (many equal weights)
+			sortAndMerge(light);
+			return;
 		}
+		std::vector<int>().swap(es);
+
+		run(heavy);
+		if (done())
+			return;
+		filter(light);
+		run(light);
 	}
 
-	int nb_arete = 0;
-	int e_max, root;
-
-	/* beginning of main loop */
-
-	int cpt_aretes = 0;
-
-	while (nb_arete < N - seeds.size()) {
-		e_max = Es[cpt_aretes];
-		// printf("%d \n", e_max);
-		cpt_aretes = cpt_aretes + 1;
-		e1         = edges[e_max].nodes[0];
-		e2         = edges[e_max].nodes[1];
-		x          = element_find(e1, Fth);
-		y          = element_find(e2, Fth);
-
-		if ((x != y) && (!(Mrk[x] >= 1 && Mrk[y] >= 1))) {
-			root     = element_link(x, y, Rnk, Fth);
-			nb_arete = nb_arete + 1;
-			if (Mrk[x] >= 1)
-				Mrk[root] = Mrk[x];
-			else if (Mrk[y] >= 1)
-				Mrk[root] = Mrk[y];
+	/// process edge indices es, which are sorted by decreasing weight
+	void merge(const std::vector<int> &es)
+	{
+		for (size_t i = 0; i < es.size() && !done(); i++) {
+			const Edge &edge = edges[es[i]];
+			int x = find(edge.nodes[0]);
+			int y = find(edge.nodes[1]);
+			if ((x != y) && (!(Mrk[x] >= 1 && Mrk[y] >= 1))) {
+				int root = element_link(x, y, &Rnk[0], &Fth[0]);
+				merged++;
+				if (tree)
+					tree->push_back(es[i]);
+				if (Mrk[x] >= 1)
+					Mrk[root] = Mrk[x];
+				else if (Mrk[y] >= 1)
+					Mrk[root] = Mrk[y];
+			}
 		}
 	}
 
-	//building the map (find the root vertex of each tree)
-	int * Map2 = (int *)malloc(N * sizeof(int));
-	int * Map  = (int *)malloc(N * sizeof(int));
-	for (i = 0; i < N; i++)
-		Map2[i] = element_find(i, Fth);
+	bool done() const { return merged >= target; }
 
-	bool* Fullseeds = (bool *)calloc(N, sizeof(bool));
-	for (i = 0; i < seeds.size(); i++) {
-		Fullseeds[seeds[i].first] = 1;
-		Map[seeds[i].first]       = (int)seeds[i].second;
+	/// label of the seed in each node's tree (0 for unseeded trees)
+	void labels(std::vector<int> &out) const
+	{
+		out.resize(Fth.size());
+		tbb::parallel_for(tbb::blocked_range<int>(0, (int)Fth.size()),
+			[&](const tbb::blocked_range<int> &r) {
+			for (int i = r.begin(); i != r.end(); ++i)
+				out[i] = Mrk[root(i)];
+		});
 	}
 
-	for (i = 0; i < N; i++)
-		Mrk[i] = false;
+protected:
+	static const size_t baseSize = 1 << 16;
 
-	for (i = 0; i < seeds.size(); i++) {
-		std::stack<int> lifo;
-		lifo.push(seeds[i].first);
-		while (!lifo.empty()) {
-			x = lifo.top();
-			lifo.pop();
-			Mrk[x] = true;
-			for (k = 1; k <= degree; k++) {
-				y = neighbor(x, k);
-				if (y != -1) {
-					if (Map2[y] == Map2[seeds[i].first] && Fullseeds[y] != 1 &&
-						Mrk[y] == false) {
-						lifo.push(y);
-						Map[y] = seeds[i].second;
-						Mrk[y] = true;
-					}
-				}
+	// find without modification (safe to call concurrently)
+	int root(int x) const
+	{
+		while (Fth[x] != x)
+			x = Fth[x];
+		return x;
+	}
+
+	// find with path halving
+	int find(int x)
+	{
+		while (Fth[x] != x) {
+			Fth[x] = Fth[Fth[x]];
+			x = Fth[x];
+		}
+		return x;
+	}
+
+	void sortAndMerge(std::vector<int> &es)
+	{
+		// descending weight, equal weights keep their order
+		const std::vector<Edge> &e = edges;
+		radixSortFloat(es.data(), es.data() + es.size(),
+					   [&e](int i) { return -e[i].weight; });
+		merge(es);
+	}
+
+	// remove edges that cannot join two trees anymore
+	void filter(std::vector<int> &es) const
+	{
+		std::vector<char> keep(es.size());
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, es.size()),
+			[&](const tbb::blocked_range<size_t> &r) {
+			for (size_t i = r.begin(); i != r.end(); ++i) {
+				const Edge &edge = edges[es[i]];
+				int x = root(edge.nodes[0]);
+				int y = root(edge.nodes[1]);
+				keep[i] = (x != y) && (!(Mrk[x] >= 1 && Mrk[y] >= 1));
 			}
+		});
+		size_t n = 0;
+		for (size_t i = 0; i < es.size(); i++) {
+			if (keep[i])
+				es[n++] = es[i];
 		}
+		es.resize(n);
 	}
 
+	const std::vector<Edge> &edges;
+	std::vector<int> Fth, Rnk, Mrk;
+	std::vector<int> *tree;
+	int merged, target;
+};
+
+static cv::Mat1b labelMap(const SeededKruskal &kruskal, int width, int height)
+{
+	// every tree contains one seed, its root holds the label
+	std::vector<int> Map;
+	kruskal.labels(Map);
+
 	cv::Mat1b ret(height, width);
 	cv::MatIterator_<uchar> it = ret.begin();
 
-	for (i = 0; i < N; i++, it++)
+	for (int i = 0; i < width * height; i++, it++)
 		*it = Map[i] - 1;
 
-
-	free(Mrk);
-	free(Rnk);
-	free(Fullseeds);
-	delete[] Es;
-	free(Map);
-	free(Map2);
-	free(Fth);
 	return ret;
 }
 
+/*=====================================================================*/
+cv::Mat1b Graph::MSF_Kruskal() {
+/*=====================================================================*/
+/*returns a segmentation performed by Kruskal's algorithm for Maximum Spanning Forest computation*/
+	int N = width * height; /* number of vertices */
+	int M = edges.size(); /*number of edges*/
+
+	std::vector<int> es(M);
+	for (int k = 0; k < M; k++)
+		es[k] = k;
+
+	SeededKruskal kruskal(edges, N, seeds);
+	kruskal.run(es);
+
+	return labelMap(kruskal, width, height);
+}
+
+/*=====================================================================*/
+std::vector<int> Graph::spanning_tree() {
+/*=====================================================================*/
+/* returns the edges of a maximum spanning tree, ignoring the seeds */
+	int N = width * height;
+	int M = edges.size();
+
+	std::vector<int> es(M);
+	for (int k = 0; k < M; k++)
+		es[k] = k;
+
+	std::vector<int> tree;
+	tree.reserve(N - 1);
+	std::vector<std::pair<int, unsigned char> > none;
+	SeededKruskal kruskal(edges, N, none, &tree);
+	kruskal.run(es);
+	return tree;
+}
+
+/*=====================================================================*/
+cv::Mat1b Graph::MSF_Tree(const std::vector<int> &tree) {
+/*=====================================================================*/
+/* returns the same segmentation as MSF_Kruskal, computed only on the edges of
+   a maximum spanning tree (see spanning_tree). A node gets the label of the
+   seed it is connected to by the path of highest minimum weight, and such a
+   path always exists within the maximum spanning tree. The tree edges are
+   already sorted, so this is a single linear pass. */
+	SeededKruskal kruskal(edges, width * height, seeds);
+	kruskal.merge(tree);
+
+	return labelMap(kruskal, width, height);
+}
+
+
 /*========================================================================================================*/
 void memory_allocation_PW(bool ** indic_E,     /* indicator for edges */
 						  bool ** indic_P,     /* indicator for edges */
@@ -0,0 +1,215 @@
+#include "fams_kernels.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FAMS_KERNELS_DISPATCH
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace seg_meanshift {
+namespace kernels {
+
+/// distance of one pair and early-exit distance, one set per instruction set
+struct Table {
+	const char *name;
+	unsigned int (*l1)(const unsigned short*, const unsigned short*, size_t);
+	unsigned int (*l1Below)(const unsigned short*, const unsigned short*,
+							size_t, unsigned int);
+	void (*l1BelowBatch)(const unsigned short*, const unsigned short*, size_t,
+						 size_t, const unsigned int*, const unsigned int*,
+						 size_t, unsigned int*);
+};
+
+/* |a - b| of unsigned 16 bit values is exact with saturated subtraction. Pairs
+   of differences are summed into 32 bit lanes, which cannot overflow for less
+   than 65536 dimensions. */
+
+static inline __m128i absDiffSSE2(const unsigned short *a,
+								  const unsigned short *b)
+{
+	__m128i va = _mm_loadu_si128((const __m128i*)a);
+	__m128i vb = _mm_loadu_si128((const __m128i*)b);
+	__m128i d = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+	return _mm_add_epi32(_mm_and_si128(d, _mm_set1_epi32(0xffff)),
+						 _mm_srli_epi32(d, 16));
+}
+
+static inline unsigned int hsum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(v);
+}
+
+static inline unsigned int l1BelowSSE2Inl(const unsigned short *a,
+										  const unsigned short *b, size_t n,
+										  unsigned int limit)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (size_t i = 0; i < n; i += 32) {
+		size_t end = std::min(i + 32, n);
+		for (size_t j = i; j < end; j += 8)
+			acc = _mm_add_epi32(acc, absDiffSSE2(a + j, b + j));
+		unsigned int sum = hsum(acc);
+		if (sum >= limit)
+			return sum;
+	}
+	return hsum(acc);
+}
+
+static unsigned int l1SSE2(const unsigned short *a, const unsigned short *b,
+						   size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	for (size_t i = 0; i < n; i += 8)
+		acc = _mm_add_epi32(acc, absDiffSSE2(a + i, b + i));
+	return hsum(acc);
+}
+
+static unsigned int l1BelowSSE2(const unsigned short *a,
+								const unsigned short *b, size_t n,
+								unsigned int limit)
+{
+	return l1BelowSSE2Inl(a, b, n, limit);
+}
+
+static void l1BelowBatchSSE2(const unsigned short *query,
+							 const unsigned short *data, size_t stride,
+							 size_t n, const unsigned int *index,
+							 const unsigned int *limit, size_t count,
+							 unsigned int *out)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const unsigned short *row = data + (index ? index[i] : i) * stride;
+		out[i] = l1BelowSSE2Inl(query, row, n, limit[i]);
+	}
+}
+
+static const Table sse2Table = {
+	"SSE2", l1SSE2, l1BelowSSE2, l1BelowBatchSSE2
+};
+
+#ifdef FAMS_KERNELS_DISPATCH
+
+/* AVX2 code is compiled for its target only, so the binary still runs on any
+   x86 CPU. It is only called after checking the CPU. One vector covers 16
+   dimensions, so the threshold is checked after every second vector. */
+
+#define FAMS_AVX2 __attribute__((target("avx2")))
+
+FAMS_AVX2 static inline __m256i absDiffAVX2(const unsigned short *a,
+											const unsigned short *b)
+{
+	__m256i va = _mm256_loadu_si256((const __m256i*)a);
+	__m256i vb = _mm256_loadu_si256((const __m256i*)b);
+	__m256i d = _mm256_or_si256(_mm256_subs_epu16(va, vb),
+								_mm256_subs_epu16(vb, va));
+	return _mm256_add_epi32(_mm256_and_si256(d, _mm256_set1_epi32(0xffff)),
+							_mm256_srli_epi32(d, 16));
+}
+
+FAMS_AVX2 static inline unsigned int hsum256(__m256i v)
+{
+	return hsum(_mm_add_epi32(_mm256_castsi256_si128(v),
+							  _mm256_extracti128_si256(v, 1)));
+}
+
+FAMS_AVX2 static inline unsigned int l1BelowAVX2Inl(const unsigned short *a,
+													const unsigned short *b,
+													size_t n,
+													unsigned int limit)
+{
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		acc = _mm256_add_epi32(acc, absDiffAVX2(a + i, b + i));
+		acc = _mm256_add_epi32(acc, absDiffAVX2(a + i + 16, b + i + 16));
+		unsigned int sum = hsum256(acc);
+		if (sum >= limit)
+			return sum;
+	}
+	if (i < n) // last 16
+		acc = _mm256_add_epi32(acc, absDiffAVX2(a + i, b + i));
+	return hsum256(acc);
+}
+
+FAMS_AVX2 static unsigned int l1AVX2(const unsigned short *a,
+									 const unsigned short *b, size_t n)
+{
+	__m256i acc = _mm256_setzero_si256();
+	for (size_t i = 0; i < n; i += 16)
+		acc = _mm256_add_epi32(acc, absDiffAVX2(a + i, b + i));
+	return hsum256(acc);
+}
+
+FAMS_AVX2 static unsigned int l1BelowAVX2(const unsigned short *a,
+										  const unsigned short *b, size_t n,
+										  unsigned int limit)
+{
+	return l1BelowAVX2Inl(a, b, n, limit);
+}
+
+FAMS_AVX2 static void l1BelowBatchAVX2(const unsigned short *query,
+									   const unsigned short *data,
+									   size_t stride, size_t n,
+									   const unsigned int *index,
+									   const unsigned int *limit, size_t count,
+									   unsigned int *out)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const unsigned short *row = data + (index ? index[i] : i) * stride;
+		out[i] = l1BelowAVX2Inl(query, row, n, limit[i]);
+	}
+}
+
+static const Table avx2Table = {
+	"AVX2", l1AVX2, l1BelowAVX2, l1BelowBatchAVX2
+};
+
+#endif // FAMS_KERNELS_DISPATCH
+
+static const Table &selectTable()
+{
+#ifdef FAMS_KERNELS_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return avx2Table;
+#endif
+	return sse2Table;
+}
+
+/// chosen once, thread-safe initialization of function-local static
+static const Table &table()
+{
+	static const Table &t = selectTable();
+	return t;
+}
+
+const char *isa()
+{
+	return table().name;
+}
+
+unsigned int l1(const unsigned short *a, const unsigned short *b, size_t n)
+{
+	return table().l1(a, b, n);
+}
+
+unsigned int l1Below(const unsigned short *a, const unsigned short *b,
+					 size_t n, unsigned int limit)
+{
+	return table().l1Below(a, b, n, limit);
+}
+
+void l1BelowBatch(const unsigned short *query, const unsigned short *data,
+				  size_t stride, size_t n, const unsigned int *index,
+				  const unsigned int *limit, size_t count, unsigned int *out)
+{
+	table().l1BelowBatch(query, data, stride, n, index, limit, count, out);
+}
+
+} // namespace kernels
+} // namespace seg_meanshift
@@ -0,0 +1,45 @@
+#ifndef FAMS_KERNELS_H
+#define FAMS_KERNELS_H
+
+#include <cstddef>
+
+namespace seg_meanshift {
+
+/**
+* @namespace kernels
+*
+* @brief vectorized L1 distances on quantized (unsigned short) FAMS data
+*
+* The instruction set (AVX2 or SSE2) is chosen at runtime, on first use.
+* All loads are unaligned. The vector length n has to be a multiple of 16
+* (see FAMS_DATA_ALIGN), padding elements should be zero. Results are exact.
+*/
+namespace kernels {
+
+/// name of the instruction set in use
+const char *isa();
+
+/// L1 distance
+unsigned int l1(const unsigned short *a, const unsigned short *b, size_t n);
+
+/** L1 distance, if it is below limit.
+	The sum is checked against limit after every 32 dimensions, computation
+	stops as soon as it is reached. The result then is limit or more, but
+	not the full distance.
+*/
+unsigned int l1Below(const unsigned short *a, const unsigned short *b,
+					 size_t n, unsigned int limit);
+
+/** l1Below() of one query to several rows of a matrix.
+	Row r starts at data + r*stride. For each i, the distance between query and
+	row index[i] (or row i if index is NULL) is tested against limit[i].
+	@arg out receives count results
+*/
+void l1BelowBatch(const unsigned short *query, const unsigned short *data,
+				  size_t stride, size_t n, const unsigned int *index,
+				  const unsigned int *limit, size_t count, unsigned int *out);
+
+} // namespace kernels
+} // namespace seg_meanshift
+
+#endif // FAMS_KERNELS_H
@@ -56,19 +56,20 @@ bool FAMS::loadPoints(char* filename) {
 		}
 	}
 
-	// dataholder holds all the data, points only reference it w/ pointers
-	dataholder.assign(temp.size(), std::vector<unsigned short>(temp[0].size()));
+	// dataholder holds all the data, points only reference it w/ indices
+	int cols = (d_ + FAMS_DATA_ALIGN - 1) / FAMS_DATA_ALIGN * FAMS_DATA_ALIGN;
+	dataholder = cv::Mat_<unsigned short>(n_, cols, (unsigned short)0);
 
 	for (size_t i = 0; i < temp.size(); ++i) {
 		for (size_t j = 0; j < temp[i].size(); ++j) {
-			dataholder[i][j] = value2ushort<unsigned short>(temp[i][j]);
+			dataholder(i, j) = value2ushort<unsigned short>(temp[i][j]);
 		}
 	}
 
 	// link points to their data
-	datapoints.resize(dataholder.size());
-	for (size_t i = 0; i < dataholder.size(); ++i) {
-		datapoints[i].data = &dataholder[i];
+	datapoints.resize(n_);
+	for (unsigned int i = 0; i < n_; ++i) {
+		datapoints[i].index = i;
 	}
 	bgLog("done\n");
 	return true;
@@ -86,12 +87,12 @@ bool FAMS::importPoints(const multi_img& img) {
 	maxVal_ = img.maxval;
 
 	// let multi_img do the hard work
-	dataholder = img.export_ushort(true);
+	dataholder = img.export_ushort_mat(true, FAMS_DATA_ALIGN);
 
 	// link points to their data
-	datapoints.resize(dataholder.size());
-	for (size_t i = 0; i < dataholder.size(); ++i) {
-		datapoints[i].data = &dataholder[i];
+	datapoints.resize(n_);
+	for (unsigned int i = 0; i < n_; ++i) {
+		datapoints[i].index = i;
 	}
 	bgLog("done\n");
 	return true;
@@ -181,8 +182,9 @@ void FAMS::dbgSavePoints(const std::string& filebase,
 	dest.maxval = maxVal_;
 	for (size_t x = 0; x < points.size(); ++x) {
 		multi_img::Pixel px(d_);
+		const unsigned short *src = pointData(points[x]);
 		for (unsigned int d = 0; d < d_; ++d)
-			px[d] = ushort2value((*points[x].data)[d]);
+			px[d] = ushort2value(src[d]);
 		dest.setPixel(x, 0, px);
 	}
 
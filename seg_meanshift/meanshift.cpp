@@ -90,10 +90,12 @@ MeanShift::Result MeanShift::execute(const multi_img& input,
 		cfams.selectStartPoints(config.percent, 1);
 		break;
 #ifdef WITH_SEG_FELZENSZWALB
-	case SUPERPIXEL:
-		sp_points = prepare_sp_points(cfams, sp_map);
-		cfams.importStartPoints(sp_points);
+	case SUPERPIXEL: {
+		cv::Mat_<unsigned short> sp_data;
+		sp_points = prepare_sp_points(cfams, sp_map, sp_data);
+		cfams.importStartPoints(sp_points, sp_data);
 		break;
+	}
 #endif
 	default:
 		cfams.selectStartPoints(0., 1);
@@ -106,7 +108,6 @@ MeanShift::Result MeanShift::execute(const multi_img& input,
 		cfams.DbgSavePoints(config.output_directory + "/sp-points-img",
 							sp_points, input.meta);
 	}*/
-	cleanup_sp_points(sp_points);
 #endif
 	if (!success)
 		return Result();
@@ -144,7 +145,8 @@ MeanShift::Result MeanShift::execute(const multi_img& input,
 
 #ifdef WITH_SEG_FELZENSZWALB
 std::vector<FAMS::Point> MeanShift::prepare_sp_points(const FAMS &fams,
-								  const seg_felzenszwalb::segmap &map)
+								  const seg_felzenszwalb::segmap &map,
+								  cv::Mat_<unsigned short> &data)
 {
 	int D = fams.d_;
 	const std::vector<FAMS::Point>& points = fams.getPoints();
@@ -154,12 +156,13 @@ std::vector<FAMS::Point> MeanShift::prepare_sp_points(const FAMS &fams,
 	   maximum bandwidth that any individual superpixel member would obtain.
 	*/
 
+	data.create((int)map.size(), D);
 	std::vector<int> accum(D);
 	seg_felzenszwalb::segmap::const_iterator mit;
 	for (mit = map.begin(); mit != map.end(); ++mit) {
 		// initialize new point with zero
 		FAMS::Point p;
-		p.data = new std::vector<unsigned short>(D);
+		unsigned short *pdata = data[(int)ret.size()];
 		p.window = 0;
 		p.weightdp2 = 0.;
 
@@ -169,15 +172,16 @@ std::vector<FAMS::Point> MeanShift::prepare_sp_points(const FAMS &fams,
 		std::fill_n(accum.begin(), D, 0);
 		for (int i = 0; i < N; ++i) {
 			int coord = (*mit)[i];
+			const unsigned short *src = fams.pointData(points[coord]);
 			for (int d = 0; d < D; ++d)
-				accum[d] += (*points[coord].data)[d];
+				accum[d] += src[d];
 			p.window = std::max(p.window, points[coord].window);
 			p.weightdp2 += points[coord].weightdp2;
 		}
 
 		// divide by N to obtain average
 		for (int d = 0; d < D; ++d)
-			(*p.data)[d] = accum[d] / N;
+			pdata[d] = accum[d] / N;
 		p.weightdp2 /= (double)N;
 
 		// add to point set
@@ -204,12 +208,6 @@ cv::Mat1s MeanShift::segmentImageSP(const FAMS &fams, const cv::Mat1i &lookup)
 	return ret;
 }
 
-void MeanShift::cleanup_sp_points(std::vector<FAMS::Point> &points)
-{
-	for (size_t i = 0; i < points.size(); ++i)
-		delete points[i].data;
-}
-
 #endif
 
 } // namespace
@@ -62,9 +62,10 @@ public:
 	               const multi_img& spinput = multi_img());
 
 #ifdef WITH_SEG_FELZENSZWALB
+	/// data receives the coordinates of the points, one per row
 	static std::vector<FAMS::Point> prepare_sp_points(const FAMS &fams,
-									  const seg_felzenszwalb::segmap &map);
-	static void cleanup_sp_points(std::vector<FAMS::Point> &points);
+									  const seg_felzenszwalb::segmap &map,
+									  cv::Mat_<unsigned short> &data);
 	static cv::Mat1s segmentImageSP(const FAMS &fams, const cv::Mat1i &lookup);
 #endif
 
@@ -10,6 +10,7 @@
 #include "meanshift.h"
 
 #include <multi_img.h>
+#include <pipeline.h>
 #include <stopwatch.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
@@ -37,9 +38,10 @@ int MeanShiftShell::execute() {
 #ifdef WITH_SEG_FELZENSZWALB
 	if (config.sp_withGrad) {
 		input = imginput::ImgInput(config.input).execute();
-		input_grad = multi_img::ptr(new multi_img(*input, true));
-		input_grad->apply_logarithm();
-		*input_grad = input_grad->spec_gradient();
+		imginput::Pipeline gradient;
+		gradient.logarithm();
+		gradient.gradient();
+		input_grad = gradient.execute(*input);
 	} else
 #endif
     {
@@ -88,8 +88,10 @@ MeanShiftSOM::Result MeanShiftSOM::execute(multi_img::ptr input)
 								 multi_img_base::Range(
 									 input->minval, input->maxval));
 /*	if (config.sp_withGrad) {	TODO cleanup
-		msinput.apply_logarithm();
-		msinput = msinput.spec_gradient();
+		imginput::Pipeline gradient;
+		gradient.logarithm();
+		gradient.gradient();
+		msinput = *gradient.execute(msinput);
 	}*/
 
 	/* these are flat arrays, but we still use 2d index conversion from the SOM,
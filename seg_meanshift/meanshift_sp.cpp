@@ -15,6 +15,7 @@
 #endif
 
 #include <multi_img.h>
+#include <pipeline.h>
 #include <stopwatch.h>
 #include <opencv2/highgui/highgui.hpp>
 #include <iostream>
@@ -41,9 +42,10 @@ int MeanShiftSP::execute()
 	multi_img::ptr input, input_grad;
 	if (config.sp_withGrad) {
 		input = imginput::ImgInput(config.input).execute();
-		input_grad = multi_img::ptr(new multi_img(*input, true));
-		input_grad->apply_logarithm();
-		*input_grad = input_grad->spec_gradient();
+		imginput::Pipeline gradient;
+		gradient.logarithm();
+		gradient.gradient();
+		input_grad = gradient.execute(*input);
 	} else {
 		input = imginput::ImgInput(config.input).execute();
 	}
@@ -164,7 +166,7 @@ MeanShift::Result MeanShiftSP::execute(multi_img::ptr input, multi_img::ptr inpu
 
 		// sum up all superpixel members
 		for (int i = 0; i < N; ++i) {
-			const multi_img::Pixel &s = in->atIndex((*mit)[i]);
+			multi_img::PixelView s = in->atIndex((*mit)[i]);
 			for (int d = 0; d < D; ++d)
 				p[d] += s[d];
 		}
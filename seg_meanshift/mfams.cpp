@@ -69,8 +69,19 @@ void FAMS::selectStartPoints(double percent, int jump) {
 	}
 }
 
-void FAMS::importStartPoints(std::vector<Point> &points)
+void FAMS::importStartPoints(std::vector<Point> &points,
+							 const cv::Mat_<unsigned short> &data)
 {
+	assert(data.rows == (int)points.size() && data.cols == (int)d_);
+
+	/* store data like our own points, indices follow the data points */
+	importholder = cv::Mat_<unsigned short>(data.rows, dataholder.cols,
+											(unsigned short)0);
+	cv::Mat_<unsigned short> dst = importholder.colRange(0, d_);
+	data.copyTo(dst);
+	for (size_t i = 0; i < points.size(); ++i)
+		points[i].index = n_ + i;
+
 	/* add all points as starting points */
 	startPoints.resize(points.size());
 	for (size_t i = 0; i < points.size(); ++i)
@@ -200,51 +211,72 @@ void FAMS::ComputeRealBandwidths(unsigned int h) {
 }
 
 // compute the pilot h_i's for the data points
-void FAMS::ComputeScores(float* scores, LSHReader &lsh, int L) {
+void FAMS::ComputeScores(float* scores, float* candidates, const LSH &lsh,
+						 int L) {
 	const int thresh = (int)(config.k * std::sqrt((float)n_));
 	const int    win_j = 10, max_win = 7000;
-	unsigned int nn;
-	unsigned int wjd = (unsigned int)(win_j * d_);
-	memset(scores, 0, L * sizeof(float));
-	for (size_t j = 0; j < startPoints.size(); j++) {
-		int nl = 0;
-		int numns[max_win / win_j];
-		memset(numns, 0, sizeof(numns));
+	const unsigned int wjd = (unsigned int)(win_j * d_);
+	const int npoints = startPoints.size();
+
+	/* results are stored per point and summed up afterwards in fixed order,
+	   so they do not depend on the scheduling */
+	std::vector<float> pointScores(npoints * L, 0.f);
+	std::vector<int> pointResults(npoints * L, 0);
+	tbb::enumerable_thread_specific<LSHReader> readers((LSHReader(lsh)));
+	tbb::parallel_for(tbb::blocked_range<int>(0, npoints),
+					  [&](const tbb::blocked_range<int> &r) {
+		LSHReader &reader = readers.local();
+		for (int j = r.begin(); j != r.end(); ++j) {
+			float *pscores = &pointScores[j * L];
+			unsigned int nn;
+			int nl = 0;
+			int numns[max_win / win_j];
+			memset(numns, 0, sizeof(numns));
 
-		lsh.query(*startPoints[j]->data);
-		const std::vector<unsigned int>& lshResult = lsh.getResult();
-		const std::vector<int>& num_l = lsh.getNumByPartition();
-
-		for (int i = 0; i < (int) lshResult.size(); i++) {
-			nn = DistL1(*startPoints[j], datapoints[lshResult[i]]) / wjd;
-			if (nn < max_win / win_j)
-				numns[nn]++;
-
-			if (i == (num_l[nl] - 1)) {
-				// partition boundary
-				/* current [0;i] represents the result after evaluating
-				   nl partitions */
-
-				// calculate distance to k-nearest neighbour in this result
-				int numn = 0;
-				for (nn = 0; nn < max_win / win_j; nn++) {
-					numn += numns[nn];
-					if (numn > thresh)
-						break;
-				}
+			reader.query(pointData(*startPoints[j]));
+			const std::vector<unsigned int>& lshResult = reader.getResult();
+			const std::vector<int>& num_l = reader.getNumByPartition();
+			std::copy(num_l.begin(), num_l.begin() + L, &pointResults[j * L]);
 
-				// assign score for this value of L and
-				// any next partitions if they didn't add anything to the result
-				for (; nl < L && (num_l[nl] - 1) == i; nl++) {
-					assert(nl < L);
-					scores[nl] += (float)(((nn + 1.0) * win_j) /
-										   startPoints[j]->window);
+			for (int i = 0; i < (int) lshResult.size(); i++) {
+				nn = DistL1(*startPoints[j], datapoints[lshResult[i]]) / wjd;
+				if (nn < max_win / win_j)
+					numns[nn]++;
+
+				if (i == (num_l[nl] - 1)) {
+					// partition boundary
+					/* current [0;i] represents the result after evaluating
+					   nl partitions */
+
+					// calculate distance to k-nearest neighbour in this result
+					int numn = 0;
+					for (nn = 0; nn < max_win / win_j; nn++) {
+						numn += numns[nn];
+						if (numn > thresh)
+							break;
+					}
+
+					// assign score for this value of L and
+					// any next partitions if they didn't add anything to the result
+					for (; nl < L && (num_l[nl] - 1) == i; nl++) {
+						assert(nl < L);
+						pscores[nl] = (float)(((nn + 1.0) * win_j) /
+											  startPoints[j]->window);
+					}
 				}
 			}
 		}
+	});
+
+	for (int l = 0; l < L; l++) {
+		double score = 0., results = 0.;
+		for (int j = 0; j < npoints; j++) {
+			score += pointScores[j * L + l];
+			results += pointResults[j * L + l];
+		}
+		scores[l] = (float)(score / npoints);
+		candidates[l] = (float)(results / npoints);
 	}
-	for (int j = 0; j < L; j++)
-		scores[j] /= startPoints.size();
 }
 
 
@@ -254,21 +286,37 @@ unsigned int FAMS::DoMSAdaptiveIteration(const std::vector<unsigned int> *res,
 										 std::vector<unsigned short> &ret) const
 {
 	double total_weight = 0;
-	double dist;
 	std::vector<double> rr(d_, 0.);
 	size_t nel = (res ? res->size() : n_);
 	unsigned int crtH = 0;
 	double       hmdist = 1e100;
-	for (size_t i = 0; i < nel; i++) {
-		const Point &ptp = (res ? datapoints[(*res)[i]] : datapoints[i]);
-		if (DistL1Data(old, ptp, ptp.window, dist)) {
-			double x = 1.0 - (dist / ptp.window);
+
+	/* distances are computed in batches, each point with its own window
+	   as early-exit threshold */
+	const size_t batch = 256;
+	unsigned int index[batch], limit[batch], dist[batch];
+	assert(old.size() == (size_t)dataholder.cols);
+	for (size_t b = 0; b < nel; b += batch) {
+		size_t count = std::min(batch, nel - b);
+		for (size_t i = 0; i < count; i++) {
+			index[i] = (res ? (*res)[b + i] : b + i);
+			limit[i] = datapoints[index[i]].window;
+		}
+		kernels::l1BelowBatch(&old[0], dataholder[0], dataholder.cols,
+							  dataholder.cols, index, limit, count, dist);
+
+		for (size_t i = 0; i < count; i++) {
+			if (dist[i] >= limit[i])
+				continue;
+			const Point &ptp = datapoints[index[i]];
+			double x = 1.0 - ((double)dist[i] / ptp.window);
 			double w = ptp.weightdp2 * x * x;
 			total_weight += w;
-			for (size_t j = 0; j < ptp.data->size(); j++)
-				rr[j] += (*ptp.data)[j] * w;
-			if (dist < hmdist) {
-				hmdist = dist;
+			const unsigned short *data = pointData(ptp);
+			for (size_t j = 0; j < d_; j++)
+				rr[j] += data[j] * w;
+			if (dist[i] < hmdist) {
+				hmdist = dist[i];
 				crtH   = ptp.window;
 			}
 		}
@@ -285,14 +333,12 @@ unsigned int FAMS::DoMSAdaptiveIteration(const std::vector<unsigned int> *res,
 void FAMS::MeanShiftPoint::operator()(const tbb::blocked_range<int> &r)
 const
 {
-	LSHReader *lsh = NULL;
-	if (fams.lsh_)
-		lsh = new LSHReader(*fams.lsh_);
+	LSHReader *lsh = (readers ? &readers->local() : NULL);
 
-	// initialize mean vectors to zero
+	// initialize mean vectors to zero (padded like the point data)
 	std::vector<unsigned short>
-			oldMean(fams.d_, 0),
-			crtMean(fams.d_, 0);
+			oldMean(fams.dataholder.cols, 0),
+			crtMean(fams.dataholder.cols, 0);
 	unsigned int *crtWindow;
 
 	int done = 0;
@@ -302,7 +348,8 @@ const
 		crtWindow  = &fams.modes[jj].window;
 		// set initial values
 		Point *p = fams.startPoints[jj];
-		crtMean    = *p->data;
+		const unsigned short *pdata = fams.pointData(*p);
+		crtMean.assign(pdata, pdata + fams.dataholder.cols);
 		*crtWindow = p->window;
 
 		for (int iter = 0; oldMean != crtMean && (iter < FAMS_MAXITER);
@@ -310,8 +357,9 @@ const
 			const std::vector<unsigned int> *lshResult = NULL;
 			if (lsh) {
 				Mode* solp = (Mode*)lsh->query(crtMean, &fams.modes[jj]);
-				// test for solution cache hit, then if solution was yet found
-				if (solp && !(solp->data.empty())) {
+				/* test for solution cache hit, then if solution was yet found
+				   (the mode may belong to a trajectory of another thread) */
+				if (solp && (*converged)[solp - &fams.modes[0]]) {
 					/* early trajectory termination */
 					fams.modes[jj] = *solp;
 					break;
@@ -331,8 +379,12 @@ const
 
 		// algorithm converged, store result if we do not already know it
 		if (fams.modes[jj].data.empty()) {
-			fams.modes[jj].data = crtMean;
+			fams.modes[jj].data.assign(crtMean.begin(),
+									   crtMean.begin() + fams.d_);
 		}
+		// publish the mode to other threads (atomic write, release)
+		if (converged)
+			(*converged)[jj] = 1;
 
 		// progress reporting
 		if (fams.startPoints.size() < 80 ||
@@ -341,7 +393,6 @@ const
 											(float)fams.startPoints.size()*80.f,
 											false);
 			if (!cont) {
-				delete lsh;
 				bgLog("FinishFAMS aborted.\n");
 				return;
 			}
@@ -349,8 +400,6 @@ const
 		}
 	}
 	fams.progressUpdate((float)done/(float)fams.startPoints.size()*80.f, false);
-
-	delete lsh;
 }
 
 // perform FAMS starting from a subset of the data points.
@@ -358,14 +407,19 @@ const
 bool FAMS::finishFAMS() {
 	bgLog(" Start MS iterations\n");
 
-	if (config.use_LSH)
+	if (config.use_LSH) {
 		assert(lsh_);
 
-	// hack: no parallel LSH
-	if (config.use_LSH) {
-		bgLog("*** HACK: no tbb for LSH-enabled mean shift\n");
-		MeanShiftPoint worker(*this);
-		worker(tbb::blocked_range<int>(0, startPoints.size()));
+		/* the LSH is shared read-only, each thread queries it through its
+		   own reader. All readers share one shortcut table */
+		LSHReader::ShortcutTable shortcuts;
+		MeanShiftPoint::Readers readers(LSHReader(*lsh_, &shortcuts));
+		std::vector<tbb::atomic<int> > converged(startPoints.size());
+		for (size_t i = 0; i < converged.size(); ++i)
+			converged[i] = 0;
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, startPoints.size()),
+						  MeanShiftPoint(*this, &readers, &converged));
 	} else {
 		tbb::parallel_for(tbb::blocked_range<int>(0, startPoints.size()),
 						  MeanShiftPoint(*this));
@@ -408,22 +462,32 @@ KLResult FAMS::FindKL() {
 	ComputeRealBandwidths(hWidth);
 
 	// start finding the correct l for each k
-	// scores for 10 trials runs per L
+	// scores and mean result sizes for 10 trials runs per L
 	std::vector<float> scores(FAMS_FKL_TIMES * Lmax);
+	std::vector<float> candidates(FAMS_FKL_TIMES * Lmax);
+	std::vector<unsigned int> seeds(FAMS_FKL_TIMES);
 	int   Lcrt, Kcrt;
 
 	int nBest;
 	std::vector<int> LBest(Kmax); /// contains the best L for each tested K
 	std::vector<int> KBest(Kmax); /// contains the actual value of K for each tested K
+	std::vector<double> costBest(Kmax); /// expected query cost of each pair
 
 	int ntimes, is;
 	Lcrt = Lmax;
 	bgLog(" find valid pairs.. ");
 	/// for each K...
 	for (Kcrt = Kmax, nBest = 0; Kcrt >= Kmin; Kcrt -= Kjump, nBest++) {
-		// do iterations for current K and L = 1...Lcrt
+		/* do iterations for current K and L = 1...Lcrt in parallel.
+		   Seeds are drawn beforehand, so the outcome is reproducible */
 		for (ntimes = 0; ntimes < FAMS_FKL_TIMES; ntimes++)
-			DoFindKLIteration(Kcrt, Lcrt, &scores[ntimes * Lcrt]);
+			seeds[ntimes] = (unsigned int)rand() + 1;
+		tbb::parallel_for(tbb::blocked_range<int>(0, FAMS_FKL_TIMES, 1),
+						  [&](const tbb::blocked_range<int> &r) {
+			for (int t = r.begin(); t != r.end(); ++t)
+				DoFindKLIteration(Kcrt, Lcrt, seeds[t],
+								  &scores[t * Lcrt], &candidates[t * Lcrt]);
+		});
 
 		// get best L for current k
 		KBest[nBest] = Kcrt;
@@ -436,10 +500,18 @@ KLResult FAMS::FindKL() {
 			}
 			if (scores[is] < epsilon) {
 				LBest[nBest] = is + 1;
+
+				/* expected cost of a query: K*L cut tests for hashing,
+				   and one distance computation per result point */
+				double results = 0.;
+				for (ntimes = 0; ntimes < FAMS_FKL_TIMES; ntimes++)
+					results += candidates[ntimes * Lcrt + is];
+				results /= FAMS_FKL_TIMES;
+				costBest[nBest] = (double)Kcrt * (is + 1) + results * d_;
 				break; /// stop at first match
 			}
 		}
-		bool cont = progressUpdate(50.f * (Kmax-Kcrt)/(Kmax-Kmin));
+		bool cont = progressUpdate(100.f * (Kmax-Kcrt)/(Kmax-Kmin));
 		if (!cont) {
 			bgLog("FindKL aborted\n");
 			return KLResult(0, 0, KLState::Aborted);
@@ -452,32 +524,15 @@ KLResult FAMS::FindKL() {
 	}
 	bgLog("done\n");
 
-	//start finding the pair with best running time
-	int64 run_times[FAMS_FKL_TIMES];
+	// find the pair with lowest expected query cost
 	int iBest = -1;
-	int i;
-	int64 timeBest = -1;
 	bgLog(" select best pair\n");
-	for (i = 0; i < nBest; i++) {
-		bool cont = progressUpdate(50.f + 50.f * i/nBest);
-		if (!cont) {
-			bgLog("FindKL aborted\n");
-			return KLResult(0, 0, KLState::Aborted);
-		}
-
+	for (int i = 0; i < nBest; i++) {
 		if (LBest[i] <= 0)
 			continue;
-		for (ntimes = 0; ntimes < FAMS_FKL_TIMES; ntimes++)
-			run_times[ntimes] =
-				DoFindKLIteration(KBest[i], LBest[i], &scores[ntimes * Lcrt]);
-		sort(&run_times[0], &run_times[FAMS_FKL_TIMES]);
-		// compare with median
-		if ((timeBest == -1) || (timeBest > run_times[FAMS_FKL_TIMES / 2])) {
-			iBest    = i;
-			timeBest = run_times[FAMS_FKL_TIMES / 2];
-		}
-		bgLog("  K=%d L=%d time: %g\n", KBest[i], LBest[i],
-			  run_times[FAMS_FKL_TIMES / 2]);
+		if ((iBest == -1) || (costBest[iBest] > costBest[i]))
+			iBest = i;
+		bgLog("  K=%d L=%d cost: %g\n", KBest[i], LBest[i], costBest[i]);
 	}
 	bgLog("done\n");
 
@@ -490,14 +545,11 @@ KLResult FAMS::FindKL() {
 }
 
 
-int64 FAMS::DoFindKLIteration(int K, int L, float* scores) {
-	LSH lsh(dataholder, d_, K, L);
-	LSHReader lshreader(lsh);
-
-	// Compute Scores
-	int64 ticks = cv::getTickCount();
-	ComputeScores(scores, lshreader, L);
-	return cv::getTickCount() - ticks;
+void FAMS::DoFindKLIteration(int K, int L, unsigned int seed,
+							 float* scores, float* candidates) {
+	LSH lsh(dataholder[0], n_, d_, dataholder.cols, K, L, true,
+			vector<unsigned int>(), seed);
+	ComputeScores(scores, candidates, lsh, L);
 }
 
 // initialize lsh, bandwidths
@@ -506,7 +558,8 @@ bool FAMS::prepareFAMS(vector<double> *bandwidths) {
 
 	if (config.use_LSH) {
 		bgLog("Running FAMS with K=%d L=%d\n", config.K, config.L);
-		lsh_ = new LSH(dataholder, d_, config.K, config.L);
+		lsh_ = new LSH(dataholder[0], n_, d_, dataholder.cols,
+					   config.K, config.L);
 	} else {
 		bgLog("Running FAMS without LSH (try --useLSH)\n");
 	}
@@ -561,7 +614,7 @@ bool FAMS::progressUpdate(float percent, bool absolute)
 	if (!po && config.verbosity < 1)
 		return true;
 
-	tbb::mutex::scoped_lock(progressMutex);
+	tbb::mutex::scoped_lock lock(progressMutex);
 	if (absolute)
 		progress = percent;
 	else
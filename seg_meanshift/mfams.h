@@ -12,6 +12,7 @@
 
 #include "meanshift_config.h"
 #include "meanshift_klresult.h"
+#include "fams_kernels.h"
 
 #include <multi_img.h>
 #include <progress_observer.h>
@@ -21,6 +22,8 @@
 
 #include <opencv2/core/core.hpp> // for segment image & timer functionality
 #include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/atomic.h>
 #include <tbb/task_scheduler_init.h>
 #include <tbb/mutex.h>
 
@@ -28,7 +31,6 @@
 #include <cstdarg>
 #include <cstdio>
 #include <limits>
-#include <emmintrin.h>
 
 namespace seg_meanshift {
 
@@ -64,12 +66,17 @@ namespace seg_meanshift {
 // divison of mode h
 #define FAMS_PRUNE_HDIV      1
 
+/* Data */
+// rows of the point matrix are padded to a multiple of this many dimensions
+#define FAMS_DATA_ALIGN      16
+
 class FAMS
 {
 public:
 
 	struct Point {
-		std::vector<unsigned short> *data;
+		// row of the point matrix holding the data (see pointData())
+		unsigned int   index;
 		// size of ms window around this point (L1)
 		unsigned int   window;
 		double         weightdp2;
@@ -120,11 +127,20 @@ public:
 	};
 
 	struct MeanShiftPoint {
-		MeanShiftPoint(FAMS& master)
-			: fams(master) {}
+		typedef tbb::enumerable_thread_specific<LSHReader> Readers;
+
+		/** with LSH, readers provides one reader per thread, all sharing
+		 *  the same shortcut table. converged flags for each start point
+		 *  tell when a mode found via shortcut is final.
+		 */
+		MeanShiftPoint(FAMS& master, Readers *readers = NULL,
+					   std::vector<tbb::atomic<int> > *converged = NULL)
+			: fams(master), readers(readers), converged(converged) {}
 		void operator()(const tbb::blocked_range<int> &r) const;
 
 		FAMS& fams;
+		Readers *readers;
+		std::vector<tbb::atomic<int> > *converged;
 	};
 
 	friend struct ComputePilotPoint;
@@ -139,7 +155,11 @@ public:
 	bool loadPoints(char* filename);
 	bool importPoints(const multi_img& img);
 	void selectStartPoints(double percent, int jump);
-	void importStartPoints(std::vector<Point> &points);
+	/** add points as starting points. Row i of data holds the coordinates of
+	 *  points[i], whose index is set accordingly.
+	 */
+	void importStartPoints(std::vector<Point> &points,
+						   const cv::Mat_<unsigned short> &data);
 
 	/** optional argument bandwidths provides pre-calculated
 	 *  per-point bandwidth
@@ -159,8 +179,12 @@ public:
 
 	KLResult FindKL();
 	void ComputeRealBandwidths(unsigned int h);
-	int64 DoFindKLIteration(int K, int L, float* scores);
-	void ComputeScores(float* scores, LSHReader &lsh, int L);
+	/** builds an LSH with given seed and computes scores and mean result
+	 *  sizes for all L' <= L (sharing the cuts of the first L' partitions)
+	 */
+	void DoFindKLIteration(int K, int L, unsigned int seed,
+						   float* scores, float* candidates);
+	void ComputeScores(float* scores, float* candidates, const LSH &lsh, int L);
 
 	// returns 2D intensity image containing segment indices
 	cv::Mat1s segmentImage() const;
@@ -179,62 +203,19 @@ public:
 		return (in - minVal_) / scale;
 	}
 
-	union m128i_uint {
-		__m128i v;
-		unsigned int i[4];
-	};
-
-	// distance in L1 between two data elements
-	inline unsigned int DistL1(Point& in_pt1, Point& in_pt2) const
+	// coordinates of a point (padded with zeros to FAMS_DATA_ALIGN)
+	inline const unsigned short *pointData(const Point &p) const
 	{
-		size_t i = 0;
-		unsigned int ret = 0;
-		if (in_pt1.data->size() > 7) {
-			__m128i vret = _mm_setzero_si128(), vzero = _mm_setzero_si128();
-			for (; i < in_pt1.data->size() - 8; i += 8) {
-				unsigned short *p1 = &(*in_pt1.data)[i];
-				unsigned short *p2 = &(*in_pt2.data)[i];
-				__m128i vec1 = _mm_loadu_si128((__m128i*)p1);
-				__m128i vec2 = _mm_loadu_si128((__m128i*)p2);
-				__m128i v1i1 = _mm_unpacklo_epi16(vec1, vzero);
-				__m128i v1i2 = _mm_unpackhi_epi16(vec1, vzero);
-				__m128i v2i1 = _mm_unpacklo_epi16(vec2, vzero);
-				__m128i v2i2 = _mm_unpackhi_epi16(vec2, vzero);
-				__m128i diff1 = _mm_sub_epi32(v1i1, v2i1);
-				__m128i diff2 = _mm_sub_epi32(v1i2, v2i2);
-				__m128i mask1 = _mm_srai_epi32(diff1, 31); // shift 32-1 bits
-				__m128i mask2 = _mm_srai_epi32(diff2, 31);
-				__m128i abs1 = _mm_xor_si128(_mm_add_epi32(diff1, mask1), mask1);
-				__m128i abs2 = _mm_xor_si128(_mm_add_epi32(diff2, mask2), mask2);
-				vret = _mm_add_epi32(abs1, _mm_add_epi32(abs2, vret));
-			}
-			m128i_uint *unpack = (m128i_uint*)&vret;
-			ret += unpack->i[0];
-			ret += unpack->i[1];
-			ret += unpack->i[2];
-			ret += unpack->i[3];
-		}
-		for (; i < in_pt1.data->size(); i++) {
-			ret += abs((*in_pt1.data)[i] - (*in_pt2.data)[i]);
-		}
-
-		return ret;
+		return (p.index < n_ ? dataholder[p.index]
+							 : importholder[p.index - n_]);
 	}
 
-	/*
-	   a boolean function which computes the distance if it is less than dist
-	   into dist_res.
-	   Not using SSE due to early abortion.
-	 */
-	inline bool DistL1Data(const std::vector<unsigned short> &in_d1,
-						   const Point& in_pt2, double in_dist,
-						   double& in_res) const
+	// distance in L1 between two data elements
+	inline unsigned int DistL1(const Point& in_pt1, const Point& in_pt2) const
 	{
-		in_res = 0;
-		for (size_t in_i = 0;
-			 in_i < in_d1.size() && (in_res < in_dist); in_i++)
-			in_res += abs(in_d1[in_i] - (*in_pt2.data)[in_i]);
-		return (in_res < in_dist);
+		// rows are padded with zeros, which do not add to the distance
+		return kernels::l1(pointData(in_pt1), pointData(in_pt2),
+						   dataholder.cols);
 	}
 
 	inline static void bgLog(const char *varStr, ...)
@@ -273,8 +254,11 @@ protected:
 	// input points
 	std::vector<Point> datapoints;
 
-	// input data, in case we need to store it ourselves
-	std::vector<std::vector<unsigned short> > dataholder;
+	// input data, one point per row (n_ rows, 16-byte aligned)
+	cv::Mat_<unsigned short> dataholder;
+
+	// data of imported start points (indices n_ and above)
+	cv::Mat_<unsigned short> importholder;
 
 	// selected points on which MS is run
 	std::vector<Point*> startPoints;
@@ -1,11 +1,106 @@
 #include "mfams.h"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <vector>
 #include <algorithm>
 #include <limits>
 
 namespace seg_meanshift {
 
+/* Exact closest merged mode search, same result as FAMS::findClosest().
+   Distances between all merged modes are computed once. A merged mode k is
+   skipped if, by the triangle inequality, it is further away than the best
+   one found so far b: d(m, k) >= d(b, k) - d(m, b) > d(m, b). Neighboring
+   pixels mostly share their mode, so the previous result is a good hint to
+   start with. */
+class ModeIndex
+{
+public:
+	ModeIndex(const std::vector<FAMS::MergedMode> &merged)
+		: K(merged.size()), D(K ? merged[0].data.size() : 0),
+		  centers(K * D), valid(K), between(K * K, 0.),
+		  slack(0.01 * D) // accounts for rounding in distance computation
+	{
+		for (int k = 0; k < K; ++k) {
+			valid[k] = merged[k].valid;
+			// same arithmetic as in MergedMode::distTo()
+			for (int i = 0; i < D; ++i)
+				centers[k*D + i] = merged[k].data[i] / merged[k].members;
+		}
+		tbb::parallel_for(tbb::blocked_range<int>(0, K),
+			[&](const tbb::blocked_range<int> &r) {
+			for (int k = r.begin(); k != r.end(); ++k) {
+				for (int j = 0; j < K; ++j) {
+					double d = 0.;
+					for (int i = 0; i < D; ++i)
+						d += std::abs((double)centers[k*D + i]
+									  - centers[j*D + i]);
+					between[k*K + j] = d;
+				}
+			}
+		});
+	}
+
+	/// distance and index of the closest valid merged mode
+	std::pair<double, int> closest(const FAMS::Mode &mode, int hint) const
+	{
+		std::pair<double, int> best
+				= std::make_pair(std::numeric_limits<double>::infinity(), -1);
+		if (hint >= 0 && valid[hint])
+			best = std::make_pair(distance(hint, mode), hint);
+
+		for (int k = 0; k < K; ++k) {
+			if (!valid[k] || k == hint)
+				continue;
+			if (best.second >= 0
+				&& between[best.second*K + k] > 2. * best.first + slack)
+				continue;
+			double dist = distance(k, mode);
+			// ties go to the lower index, like in a plain scan
+			if (dist < best.first
+				|| (dist == best.first && k < best.second)) {
+				best.first = dist;
+				best.second = k;
+			}
+		}
+		return best;
+	}
+
+	/** find closest merged mode for each mode, in parallel
+	 *  @arg out receives modes.size() indices
+	 */
+	void closest(const std::vector<FAMS::Mode> &modes,
+				 std::vector<int> &out) const
+	{
+		out.resize(modes.size());
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, modes.size()),
+			[&](const tbb::blocked_range<size_t> &r) {
+			int hint = -1;
+			for (size_t cm = r.begin(); cm != r.end(); ++cm) {
+				hint = closest(modes[cm], hint).second;
+				out[cm] = hint;
+			}
+		});
+	}
+
+protected:
+	double distance(int k, const FAMS::Mode &mode) const
+	{
+		const float *c = &centers[k*D];
+		double ret = 0.;
+		for (int i = 0; i < D; ++i)
+			ret += std::abs(c[i] - mode.data[i]);
+		return ret;
+	}
+
+	int K, D;
+	std::vector<float> centers;
+	std::vector<char> valid;
+	std::vector<double> between;
+	double slack;
+};
+
 FAMS::MergedMode::MergedMode(const FAMS::Mode &d, int m, int spm)
 	: members(m), spmembers(spm), data(d.data.size()), valid(true)
 	{
@@ -158,14 +253,16 @@ void FAMS::pruneModes()
 	if (!spsizes.empty())
 		npmin = 1;
 
-	for (size_t cm = 0; cm < modes.size(); ++cm) {
+	/* compute closest modes (in parallel), all against the modes found in
+	   pass one, so the result does not depend on the order of points */
+	std::vector<int> closest;
+	ModeIndex(foomodes).closest(modes, closest);
 
-		/* compute closest mode */
-		std::pair<double, int> closest = findClosest(modes[cm], foomodes);
+	for (size_t cm = 0; cm < modes.size(); ++cm) {
 
 		/* join -- this time don't care for window size */
-		assert(closest.second >= 0);
-		int index = closest.second;
+		assert(closest[cm] >= 0);
+		int index = closest[cm];
 
 		// merge into mode
 		foomodes[index].add(modes[cm], (spsizes.empty() ? 1 : spsizes[cm]));
@@ -182,11 +279,7 @@ void FAMS::pruneModes()
 
 	/* Now that we finally have a proper set of modes, last round to assign a
 	 * mode index to each pixel. */
-	prunedIndex.resize(modes.size());
-	for (size_t cm = 0; cm < modes.size(); ++cm) {
-		std::pair<double, int> closest = findClosest(modes[cm], foomodes);
-		prunedIndex[cm] = closest.second;
-	}
+	ModeIndex(foomodes).closest(modes, prunedIndex);
 
 	bgLog("done pruning\n");
 }
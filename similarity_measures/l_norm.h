@@ -11,6 +11,7 @@
 #define VOLE_L_NORM_H
 
 #include "similarity_measure.h"
+#include "sm_kernels.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
@@ -34,8 +35,25 @@ public:
 
 	double getSimilarity(const cv::Mat_<T> &img1, const cv::Mat_<T> &img2);
 	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2);
+	double getSimilarity(const T *v1, const T *v2, size_t n);
+	void getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+						 std::vector<double> &out);
+	void getSimilarities(const cv::Mat_<T> &data, int width,
+						 const std::vector<std::pair<int, int> > &pairs,
+						 std::vector<double> &out);
 
 	int normType;
+
+private:
+	/// kernel matching normType
+	kernels::Distance kernel() const
+	{
+		switch (normType) {
+		case cv::NORM_L1:  return kernels::L1;
+		case cv::NORM_INF: return kernels::LINF;
+		default: assert(normType == cv::NORM_L2); return kernels::L2;
+		}
+	}
 };
 
 template<typename T>
@@ -51,22 +69,30 @@ inline double LNorm<T>::getSimilarity(const std::vector<T> &v1, const std::vecto
 {
 	this->check(v1, v2);
 
+	return getSimilarity(&v1[0], &v2[0], v1.size());
+}
+
+template<typename T>
+inline double LNorm<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	assert(n > 0);
+
 	double ret = 0.;
-	typename std::vector<T>::const_iterator it1 = v1.begin(), it2 = v2.begin();
+	const T *it1 = v1, *it2 = v2, *end1 = v1 + n;
 	switch (normType) {
 	case cv::NORM_L1:
-		for (; it1 < v1.end(); ++it1, ++it2)
+		for (; it1 < end1; ++it1, ++it2)
 			ret += std::abs(*it1 - *it2);
 		break;
 	case cv::NORM_L2:
-		for (; it1 < v1.end(); ++it1, ++it2) {
+		for (; it1 < end1; ++it1, ++it2) {
 			double diff = *it1 - *it2;
 			ret += diff * diff;
 		}
 		ret = std::sqrt(ret);
 		break;
 	case cv::NORM_INF:
-		for (; it1 < v1.end(); ++it1, ++it2) {
+		for (; it1 < end1; ++it1, ++it2) {
 			double diff = std::abs<T>(*it1 - *it2);
 			ret = std::max<double>(diff, ret);
 		}
@@ -78,83 +104,45 @@ inline double LNorm<T>::getSimilarity(const std::vector<T> &v1, const std::vecto
 }
 
 template<>
-inline double LNorm<float>::getSimilarity(const std::vector<float> &v1, const std::vector<float> &v2)
+inline double LNorm<float>::getSimilarity(const float *v1, const float *v2, size_t n)
 {
-	this->check(v1, v2);
+	assert(n > 0);
 
-	double ret = 0.;
-	std::vector<float>::const_iterator it1 = v1.begin(), it2 = v2.begin();
 	switch (normType) {
 	case cv::NORM_L1:
-		for (; it1 < v1.end(); ++it1, ++it2)
-			ret += std::abs(*it1 - *it2);
-		break;
+		return kernels::l1(v1, v2, n);
 	case cv::NORM_L2:
-	{
-		int i = 0;
-		__m128 vret = _mm_setzero_ps();
-		for (; i < (int)v1.size() - 4; i += 4) {
-// GNU malloc guarantees 16 bit alignment on 64 bit platforms
-#if defined(__GNUC__) && defined(__LP64__)
-			__m128 vec1 = _mm_load_ps(&v1[i]);
-			__m128 vec2 = _mm_load_ps(&v2[i]);
-#else
-			__m128 vec1 = _mm_loadu_ps(&v1[i]);
-			__m128 vec2 = _mm_loadu_ps(&v2[i]);
-#endif
-			__m128 vdiff = _mm_sub_ps(vec1, vec2);
-			__m128 vdiff2 = _mm_mul_ps(vdiff, vdiff);
-			vret = _mm_add_ps(vret, vdiff2);
-		}
-		ret += *((float*)&vret + 0);
-		ret += *((float*)&vret + 1);
-		ret += *((float*)&vret + 2);
-		ret += *((float*)&vret + 3);
-		for (; i < int(v1.size()); i++) {
-			float diff = v1[i] - v2[i];
-			ret += diff * diff;
-		}
-		ret = std::sqrt(ret);
-		break;
-	}
+		return kernels::l2(v1, v2, n);
 	case cv::NORM_INF:
-		for (; it1 < v1.end(); ++it1, ++it2) {
-			double diff = std::abs<float>(*it1 - *it2);
-			ret = std::max<double>(diff, ret);
-		}
-		break;
+		return kernels::linf(v1, v2, n);
 	default:
 		assert(normType != normType);
 	}
-	return ret;
+	return 0.;
 }
 
 template<>
-inline double LNorm<double>::getSimilarity(const std::vector<double> &v1, const std::vector<double> &v2)
+inline double LNorm<double>::getSimilarity(const double *v1, const double *v2, size_t n)
 {
-	this->check(v1, v2);
+	assert(n > 0);
 
 	double ret = 0.;
-	std::vector<double>::const_iterator it1 = v1.begin(), it2 = v2.begin();
+	const double *it1 = v1, *it2 = v2, *end1 = v1 + n;
 	switch (normType) {
 	case cv::NORM_L1:
-		for (; it1 < v1.end(); ++it1, ++it2)
+		for (; it1 < end1; ++it1, ++it2)
 			ret += std::abs(*it1 - *it2);
 		break;
 	case cv::NORM_L2:
 	{
-		const double* x1 = &v1[0];
-		const double* x2 = &v2[0];
+		const double* x1 = v1;
+		const double* x2 = v2;
 		int i = 0;
 		__m128d vret = _mm_setzero_pd();
-		for (; i < (int)v1.size() - 2; i += 2) {
-#if defined(__GNUC__) && defined(__LP64__)
-			__m128d vec1 = _mm_load_pd(x1);
-			__m128d vec2 = _mm_load_pd(x2);
-#else
+		for (; i < (int)n - 2; i += 2) {
+			// no alignment assumption, pixels may start anywhere
 			__m128d vec1 = _mm_loadu_pd(x1);
 			__m128d vec2 = _mm_loadu_pd(x2);
-#endif
 			__m128d vdiff = _mm_sub_pd(vec1, vec2);
 			__m128d vdiff2 = _mm_mul_pd(vdiff, vdiff);
 			vret = _mm_add_pd(vret, vdiff2);
@@ -163,7 +151,7 @@ inline double LNorm<double>::getSimilarity(const std::vector<double> &v1, const
 		}
 		ret += *((double*)&vret + 0);
 		ret += *((double*)&vret + 1);
-		for (; i < int(v1.size()); i++) {
+		for (; i < int(n); i++) {
 			double diff = *x1 - *x2;
 			ret += diff * diff;
 			x1++;
@@ -173,7 +161,7 @@ inline double LNorm<double>::getSimilarity(const std::vector<double> &v1, const
 		break;
 	}
 	case cv::NORM_INF:
-		for (; it1 < v1.end(); ++it1, ++it2) {
+		for (; it1 < end1; ++it1, ++it2) {
 			double diff = std::abs<double>(*it1 - *it2);
 			ret = std::max<double>(diff, ret);
 		}
@@ -184,6 +172,42 @@ inline double LNorm<double>::getSimilarity(const std::vector<double> &v1, const
 	return ret;
 }
 
+template<typename T>
+inline void LNorm<T>::getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(query, candidates, out);
+}
+
+template<typename T>
+inline void LNorm<T>::getSimilarities(const cv::Mat_<T> &data, int width,
+									 const std::vector<std::pair<int, int> > &pairs,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(data, width, pairs, out);
+}
+
+template<>
+inline void LNorm<float>::getSimilarities(const float *query, const cv::Mat_<float> &candidates,
+										 std::vector<double> &out)
+{
+	out.resize(candidates.rows);
+	if (candidates.rows > 0)
+		kernels::oneToMany(kernel(), query, candidates[0], candidates.rows,
+						   candidates.step1(), candidates.cols, &out[0]);
+}
+
+template<>
+inline void LNorm<float>::getSimilarities(const cv::Mat_<float> &data, int width,
+										 const std::vector<std::pair<int, int> > &pairs,
+										 std::vector<double> &out)
+{
+	out.resize(pairs.size());
+	if (!pairs.empty())
+		kernels::pairwise(kernel(), data[0], data.step1(), data.cols,
+						  &pairs[0], pairs.size(), &out[0]);
+}
+
 } // namespace
 
 #endif
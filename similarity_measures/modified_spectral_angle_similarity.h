@@ -11,6 +11,7 @@
 #define VOLE_MOD_SPEC_ANG_SIM_H
 
 #include "similarity_measure.h"
+#include "sm_kernels.h"
 #include <math.h>
 #include <iostream>
 
@@ -29,6 +30,12 @@ public:
 
 	double getSimilarity(const cv::Mat_<T> &img1, const cv::Mat_<T> &img2);
 	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2);
+	double getSimilarity(const T *v1, const T *v2, size_t n);
+	void getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+						 std::vector<double> &out);
+	void getSimilarities(const cv::Mat_<T> &data, int width,
+						 const std::vector<std::pair<int, int> > &pairs,
+						 std::vector<double> &out);
 };
 
 template<typename T>
@@ -67,7 +74,15 @@ inline double ModifiedSpectralAngleSimilarity<T>::getSimilarity(const std::vecto
 {
 	this->check(v1, v2);
 
-	typename std::vector<T>::const_iterator it1 = v1.begin(), it2 = v2.begin();
+	return getSimilarity(&v1[0], &v2[0], v1.size());
+}
+
+template<typename T>
+inline double ModifiedSpectralAngleSimilarity<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	assert(n > 0);
+
+	const T *it1 = v1, *it2 = v2, *end1 = v1 + n;
 
 	double ret = 0.0f;
 	
@@ -76,7 +91,7 @@ inline double ModifiedSpectralAngleSimilarity<T>::getSimilarity(const std::vecto
 	double pt = 0.0f;
 
 
-	for(; it1 < v1.end(); it1++, it2++) {
+	for(; it1 < end1; it1++, it2++) {
 		tt += (*it1) * (*it1);
 		pp += (*it2) * (*it2);
 		pt += (*it1) * (*it2);
@@ -95,6 +110,50 @@ inline double ModifiedSpectralAngleSimilarity<T>::getSimilarity(const std::vecto
 	return ret;
 }
 
+template<>
+inline double ModifiedSpectralAngleSimilarity<float>::getSimilarity(const float *v1, const float *v2, size_t n)
+{
+	assert(n > 0);
+
+	return kernels::sam(v1, v2, n);
+}
+
+template<typename T>
+inline void ModifiedSpectralAngleSimilarity<T>::getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(query, candidates, out);
+}
+
+template<typename T>
+inline void ModifiedSpectralAngleSimilarity<T>::getSimilarities(const cv::Mat_<T> &data, int width,
+									 const std::vector<std::pair<int, int> > &pairs,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(data, width, pairs, out);
+}
+
+template<>
+inline void ModifiedSpectralAngleSimilarity<float>::getSimilarities(const float *query, const cv::Mat_<float> &candidates,
+										 std::vector<double> &out)
+{
+	out.resize(candidates.rows);
+	if (candidates.rows > 0)
+		kernels::oneToMany(kernels::SAM, query, candidates[0], candidates.rows,
+						   candidates.step1(), candidates.cols, &out[0]);
+}
+
+template<>
+inline void ModifiedSpectralAngleSimilarity<float>::getSimilarities(const cv::Mat_<float> &data, int width,
+										 const std::vector<std::pair<int, int> > &pairs,
+										 std::vector<double> &out)
+{
+	out.resize(pairs.size());
+	if (!pairs.empty())
+		kernels::pairwise(kernels::SAM, data[0], data.step1(), data.cols,
+						  &pairs[0], pairs.size(), &out[0]);
+}
+
 } // namespace
 
 #endif
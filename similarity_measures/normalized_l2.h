@@ -41,10 +41,11 @@ inline double NormalizedL2<T>::getSimilarity(const cv::Mat_<T> &v1, const cv::Ma
 		return 0.;
 		// can be harmful to graphseg: return (s1[0] == s2[0] ? 0. : std::numeric_limits<double>::max());
 
-	v1 /= s1[0];
-	v2 /= s2[0];
+	// normalize into new matrices, the input may be image data
+	cv::Mat_<T> n1 = v1 / s1[0];
+	cv::Mat_<T> n2 = v2 / s2[0];
 
-	return cv::norm(v1, v2, cv::NORM_L2);
+	return cv::norm(n1, n2, cv::NORM_L2);
 }
 
 } // namespace
@@ -31,10 +31,29 @@ public:
 	{ assert(v == 0 || v == 1); }
 
 	double getSimilarity(const cv::Mat_<T> &img1, const cv::Mat_<T> &img2);
+	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2);
+	double getSimilarity(const T *v1, const T *v2, size_t n);
+	void getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+						 std::vector<double> &out);
+	void getSimilarities(const cv::Mat_<T> &data, int width,
+						 const std::vector<std::pair<int, int> > &pairs,
+						 std::vector<double> &out);
 
 	int v;
 	ModifiedSpectralAngleSimilarity<T> sam;
 	SpectralInformationDivergence<T> sid;
+
+private:
+	/// combine batch results, result is written to sids
+	void combine(std::vector<double> &sids, const std::vector<double> &angles) const
+	{
+		for (size_t i = 0; i < sids.size(); ++i) {
+			if (v == 0)
+				sids[i] = std::sqrt(sids[i] * std::sin(angles[i]));
+			else
+				sids[i] = std::sqrt(sids[i] * std::tan(angles[i]));
+		}
+	}
 };
 
 template<typename T>
@@ -47,6 +66,45 @@ inline double SIDSAM<T>::getSimilarity(const cv::Mat_<T> &v1, const cv::Mat_<T>
 	}
 }
 
+template<typename T>
+inline double SIDSAM<T>::getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2)
+{
+	this->check(v1, v2);
+
+	return getSimilarity(&v1[0], &v2[0], v1.size());
+}
+
+template<typename T>
+inline double SIDSAM<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	if (v == 0) {
+		return std::sqrt(sid.getSimilarity(v1, v2, n) * std::sin(sam.getSimilarity(v1, v2, n)));
+	} else {
+		return std::sqrt(sid.getSimilarity(v1, v2, n) * std::tan(sam.getSimilarity(v1, v2, n)));
+	}
+}
+
+template<typename T>
+inline void SIDSAM<T>::getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+									  std::vector<double> &out)
+{
+	std::vector<double> angles;
+	sid.getSimilarities(query, candidates, out);
+	sam.getSimilarities(query, candidates, angles);
+	combine(out, angles);
+}
+
+template<typename T>
+inline void SIDSAM<T>::getSimilarities(const cv::Mat_<T> &data, int width,
+									  const std::vector<std::pair<int, int> > &pairs,
+									  std::vector<double> &out)
+{
+	std::vector<double> angles;
+	sid.getSimilarities(data, width, pairs, out);
+	sam.getSimilarities(data, width, pairs, angles);
+	combine(out, angles);
+}
+
 } // namespace
 
 #endif
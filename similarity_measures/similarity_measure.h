@@ -12,6 +12,7 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <vector>
+#include <utility>
 #include <cassert>
 
 /** 
@@ -72,6 +73,33 @@ public:
 	virtual double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2,
 	                             const cv::Point& c1, const cv::Point& c2);
 
+	// function for distance calculation on raw, contiguous data of length n
+	/* used on data that is not held in a std::vector, e.g. pixels in the
+	   interleaved cache of multi_img. Default version builds CV matrix headers
+	   around the data in O(1), like the std::vector version does. */
+	virtual double getSimilarity(const T *v1, const T *v2, size_t n);
+
+	/* version of the method for implementing a position-based caching */
+	virtual double getSimilarity(const T *v1, const T *v2, size_t n,
+	                             const cv::Point& c1, const cv::Point& c2);
+
+	// function for distance calculation of one query against many candidates
+	/* candidates holds one candidate per row, out receives one distance per
+	   row. Default version calls getSimilarity() for each row. Measures
+	   with a vectorized implementation override it, so the virtual call is
+	   only paid once per batch. */
+	virtual void getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+	                             std::vector<double> &out);
+
+	// function for distance calculation of many pairs, e.g. neighbor pixels
+	/* data holds one vector per row, for each pair the distance between rows
+	   pair.first and pair.second is written to out. Row r is understood to be
+	   the vector at position (r % width, r / width), which is passed on to
+	   the position-based getSimilarity(). */
+	virtual void getSimilarities(const cv::Mat_<T> &data, int width,
+	                             const std::vector<std::pair<int, int> > &pairs,
+	                             std::vector<double> &out);
+
 	// helper function to check image input
 	static void check(const cv::Mat_<T> &img1, const cv::Mat_<T> &img2)
 	{
@@ -107,6 +135,43 @@ inline double SimilarityMeasure<T>::getSimilarity(const std::vector<T> &v1, cons
 	return getSimilarity(v1, v2);
 }
 
+template<typename T>
+inline double SimilarityMeasure<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	cv::Mat_<T> m1((int)n, 1, const_cast<T*>(v1)), m2((int)n, 1, const_cast<T*>(v2));
+	return getSimilarity(m1, m2);
+}
+
+template<typename T>
+inline double SimilarityMeasure<T>::getSimilarity(const T *v1, const T *v2, size_t n,
+                                                  const cv::Point &p1, const cv::Point &p2)
+{
+	return getSimilarity(v1, v2, n);
+}
+
+template<typename T>
+inline void SimilarityMeasure<T>::getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+                                                  std::vector<double> &out)
+{
+	out.resize(candidates.rows);
+	for (int i = 0; i < candidates.rows; ++i)
+		out[i] = getSimilarity(query, candidates[i], candidates.cols);
+}
+
+template<typename T>
+inline void SimilarityMeasure<T>::getSimilarities(const cv::Mat_<T> &data, int width,
+                                                  const std::vector<std::pair<int, int> > &pairs,
+                                                  std::vector<double> &out)
+{
+	out.resize(pairs.size());
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		int a = pairs[i].first, b = pairs[i].second;
+		out[i] = getSimilarity(data[a], data[b], data.cols,
+		                       cv::Point(a % width, a / width),
+		                       cv::Point(b % width, b / width));
+	}
+}
+
 template<typename T>
 std::pair<cv::Mat_<float>, cv::Mat_<float> >
 SimilarityMeasure<T>::hist(const cv::Mat_<T> &in1, const cv::Mat_<T> &in2, int bins, float *range)
@@ -0,0 +1,873 @@
+#include "sm_kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SM_KERNELS_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SM_KERNELS_SSE2
+#endif
+
+namespace similarity_measures {
+namespace kernels {
+
+/// the per-pair building blocks, one set per instruction set
+struct Table {
+	const char *name;
+	double (*l1)(const float*, const float*, size_t);
+	double (*l2sq)(const float*, const float*, size_t);
+	double (*linf)(const float*, const float*, size_t);
+	/// computes sum(a*a), sum(b*b), sum(a*b)
+	void (*dots)(const float*, const float*, size_t, double*);
+	double (*sum)(const float*, size_t);
+	/// computes y = log(x) element-wise
+	void (*log)(const float*, float*, size_t);
+	/// computes sum((a*ia - b*ib) * (loga - log(b))), see divergence()
+	double (*divergence)(const float*, const float*, float,
+						 const float*, float, size_t);
+};
+
+/* Vector kernels sum up blocks of SM_BLOCK values in single precision lanes,
+   each block's sum is then added in double precision, like the scalar
+   versions do for every value. The rounding of the float partial sums is
+   therefore bounded by the block length, not by the spectrum length.
+   No kernel uses FMA, so the individual terms are identical on all
+   instruction sets; results only differ by the order of summation. */
+#define SM_BLOCK 64
+
+/// end of the block starting at i, with the vector loop ending at full
+static inline size_t blockEnd(size_t i, size_t full)
+{
+	return std::min(i + SM_BLOCK, full);
+}
+
+/* scalar versions, also used for the tails of the vector loops */
+
+static double l1Scalar(const float *a, const float *b, size_t n)
+{
+	double ret = 0.;
+	for (size_t i = 0; i < n; ++i)
+		ret += std::abs(a[i] - b[i]);
+	return ret;
+}
+
+static double l2sqScalar(const float *a, const float *b, size_t n)
+{
+	double ret = 0.;
+	for (size_t i = 0; i < n; ++i) {
+		float diff = a[i] - b[i];
+		ret += diff * diff;
+	}
+	return ret;
+}
+
+static double linfScalar(const float *a, const float *b, size_t n)
+{
+	float ret = 0.f;
+	for (size_t i = 0; i < n; ++i)
+		ret = std::max(ret, std::abs(a[i] - b[i]));
+	return ret;
+}
+
+static void dotsScalar(const float *a, const float *b, size_t n, double *out)
+{
+	double aa = 0., bb = 0., ab = 0.;
+	for (size_t i = 0; i < n; ++i) {
+		aa += a[i] * a[i];
+		bb += b[i] * b[i];
+		ab += a[i] * b[i];
+	}
+	out[0] = aa; out[1] = bb; out[2] = ab;
+}
+
+static double sumScalar(const float *a, size_t n)
+{
+	double ret = 0.;
+	for (size_t i = 0; i < n; ++i)
+		ret += a[i];
+	return ret;
+}
+
+static void logScalar(const float *x, float *y, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		y[i] = std::log(x[i]);
+}
+
+static double divergenceScalar(const float *a, const float *loga, float ia,
+							   const float *b, float ib, size_t n)
+{
+	double ret = 0.;
+	for (size_t i = 0; i < n; ++i)
+		ret += (a[i] * ia - b[i] * ib) * (loga[i] - std::log(b[i]));
+	return ret;
+}
+
+static const Table scalarTable = {
+	"scalar", l1Scalar, l2sqScalar, linfScalar, dotsScalar, sumScalar,
+	logScalar, divergenceScalar
+};
+
+/* Vectorized natural logarithm (polynomial of Cephes' logf, about 1 ulp).
+   The argument is split into mantissa m in [sqrt(1/2), sqrt(2)) and exponent
+   e, then log(x) = log(m) + e*log(2). Only normal positive numbers take the
+   vector path. Blocks containing zero, negative, denormal, infinite or NaN
+   values use std::log, so these give the same results as the scalar code. */
+
+static const float logSqrtHalf = 0.707106781186547524f;
+static const float logPoly[9] = {
+	7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+	-1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+	2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f
+};
+// log(2) split into a part exactly representable and the rest
+static const float logLn2Hi = 0.693359375f, logLn2Lo = -2.12194440e-4f;
+
+#ifdef SM_KERNELS_SSE2
+
+static inline float hsum(__m128 v)
+{
+	__m128 t = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+	return _mm_cvtss_f32(t);
+}
+
+static inline float hmax(__m128 v)
+{
+	__m128 t = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	t = _mm_max_ss(t, _mm_shuffle_ps(t, t, 1));
+	return _mm_cvtss_f32(t);
+}
+
+static double l1SSE2(const float *a, const float *b, size_t n)
+{
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const size_t full = n & ~(size_t)3;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m128 acc = _mm_setzero_ps();
+		for (; i < end; i += 4) {
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+			acc = _mm_add_ps(acc, _mm_and_ps(d, absmask));
+		}
+		ret += hsum(acc);
+	}
+	return ret + l1Scalar(a + i, b + i, n - i);
+}
+
+static double l2sqSSE2(const float *a, const float *b, size_t n)
+{
+	const size_t full = n & ~(size_t)3;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m128 acc = _mm_setzero_ps();
+		for (; i < end; i += 4) {
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+			acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+		}
+		ret += hsum(acc);
+	}
+	return ret + l2sqScalar(a + i, b + i, n - i);
+}
+
+static double linfSSE2(const float *a, const float *b, size_t n)
+{
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 acc = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+		acc = _mm_max_ps(acc, _mm_and_ps(d, absmask));
+	}
+	return std::max<double>(hmax(acc), linfScalar(a + i, b + i, n - i));
+}
+
+static void dotsSSE2(const float *a, const float *b, size_t n, double *out)
+{
+	const size_t full = n & ~(size_t)3;
+	double saa = 0., sbb = 0., sab = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m128 aa = _mm_setzero_ps(), bb = _mm_setzero_ps(),
+			   ab = _mm_setzero_ps();
+		for (; i < end; i += 4) {
+			__m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i);
+			aa = _mm_add_ps(aa, _mm_mul_ps(va, va));
+			bb = _mm_add_ps(bb, _mm_mul_ps(vb, vb));
+			ab = _mm_add_ps(ab, _mm_mul_ps(va, vb));
+		}
+		saa += hsum(aa); sbb += hsum(bb); sab += hsum(ab);
+	}
+	dotsScalar(a + i, b + i, n - i, out);
+	out[0] += saa; out[1] += sbb; out[2] += sab;
+}
+
+static double sumSSE2(const float *a, size_t n)
+{
+	const size_t full = n & ~(size_t)3;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m128 acc = _mm_setzero_ps();
+		for (; i < end; i += 4)
+			acc = _mm_add_ps(acc, _mm_loadu_ps(a + i));
+		ret += hsum(acc);
+	}
+	return ret + sumScalar(a + i, n - i);
+}
+
+/// true if all lanes hold normal positive numbers
+static inline bool logValid(__m128 x)
+{
+	__m128 ok = _mm_and_ps(_mm_cmpge_ps(x, _mm_set1_ps(FLT_MIN)),
+						   _mm_cmple_ps(x, _mm_set1_ps(FLT_MAX)));
+	return _mm_movemask_ps(ok) == 0xf;
+}
+
+static inline __m128 logSSE2Inl(__m128 x)
+{
+	const __m128 one = _mm_set1_ps(1.f);
+	__m128i bits = _mm_castps_si128(x);
+	// x = m * 2^e with m in [0.5, 1)
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23),
+											 _mm_set1_epi32(126)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(
+			_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+			_mm_set1_epi32(0x3f000000)));
+	// move m into [sqrt(1/2), sqrt(2)), then subtract 1
+	__m128 small = _mm_cmplt_ps(m, _mm_set1_ps(logSqrtHalf));
+	e = _mm_sub_ps(e, _mm_and_ps(small, one));
+	m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(small, m)), one);
+
+	__m128 z = _mm_mul_ps(m, m);
+	__m128 y = _mm_set1_ps(logPoly[0]);
+	for (int i = 1; i < 9; ++i)
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(logPoly[i]));
+	y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+	y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(logLn2Lo)));
+	y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(logLn2Hi)));
+}
+
+static void logSSE2(const float *x, float *y, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 v = _mm_loadu_ps(x + i);
+		if (logValid(v))
+			_mm_storeu_ps(y + i, logSSE2Inl(v));
+		else
+			logScalar(x + i, y + i, 4);
+	}
+	logScalar(x + i, y + i, n - i);
+}
+
+static double divergenceSSE2(const float *a, const float *loga, float ia,
+							 const float *b, float ib, size_t n)
+{
+	const __m128 via = _mm_set1_ps(ia), vib = _mm_set1_ps(ib);
+	const size_t full = n & ~(size_t)3;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m128 acc = _mm_setzero_ps();
+		for (; i < end; i += 4) {
+			__m128 vb = _mm_loadu_ps(b + i), logb;
+			if (logValid(vb)) {
+				logb = logSSE2Inl(vb);
+			} else {
+				float tmp[4];
+				logScalar(b + i, tmp, 4);
+				logb = _mm_loadu_ps(tmp);
+			}
+			__m128 p = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(a + i), via),
+								  _mm_mul_ps(vb, vib));
+			acc = _mm_add_ps(acc, _mm_mul_ps(p,
+					_mm_sub_ps(_mm_loadu_ps(loga + i), logb)));
+		}
+		ret += hsum(acc);
+	}
+	return ret + divergenceScalar(a + i, loga + i, ia, b + i, ib, n - i);
+}
+
+static const Table sse2Table = {
+	"SSE2", l1SSE2, l2sqSSE2, linfSSE2, dotsSSE2, sumSSE2,
+	logSSE2, divergenceSSE2
+};
+
+#endif // SM_KERNELS_SSE2
+
+#ifdef SM_KERNELS_DISPATCH
+
+/* AVX2 and AVX-512 code is compiled for its target only, so the binary still
+   runs on any x86 CPU. It is only called after checking the CPU. */
+
+#define SM_AVX2 __attribute__((target("avx2")))
+
+SM_AVX2 static inline float hsum256(__m256 v)
+{
+	__m128 t = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+	t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+	return _mm_cvtss_f32(t);
+}
+
+SM_AVX2 static inline float hmax256(__m256 v)
+{
+	__m128 t = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	t = _mm_max_ps(t, _mm_movehl_ps(t, t));
+	t = _mm_max_ss(t, _mm_shuffle_ps(t, t, 1));
+	return _mm_cvtss_f32(t);
+}
+
+SM_AVX2 static double l1AVX2(const float *a, const float *b, size_t n)
+{
+	const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const size_t full = n & ~(size_t)7;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m256 acc = _mm256_setzero_ps();
+		for (; i < end; i += 8) {
+			__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i),
+									 _mm256_loadu_ps(b + i));
+			acc = _mm256_add_ps(acc, _mm256_and_ps(d, absmask));
+		}
+		ret += hsum256(acc);
+	}
+	return ret + l1Scalar(a + i, b + i, n - i);
+}
+
+SM_AVX2 static double l2sqAVX2(const float *a, const float *b, size_t n)
+{
+	const size_t full = n & ~(size_t)7;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m256 acc = _mm256_setzero_ps();
+		for (; i < end; i += 8) {
+			__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i),
+									 _mm256_loadu_ps(b + i));
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+		}
+		ret += hsum256(acc);
+	}
+	return ret + l2sqScalar(a + i, b + i, n - i);
+}
+
+SM_AVX2 static double linfAVX2(const float *a, const float *b, size_t n)
+{
+	const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 acc = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		acc = _mm256_max_ps(acc, _mm256_and_ps(d, absmask));
+	}
+	return std::max<double>(hmax256(acc), linfScalar(a + i, b + i, n - i));
+}
+
+SM_AVX2 static void dotsAVX2(const float *a, const float *b, size_t n,
+							 double *out)
+{
+	const size_t full = n & ~(size_t)7;
+	double saa = 0., sbb = 0., sab = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m256 aa = _mm256_setzero_ps(), bb = _mm256_setzero_ps(),
+			   ab = _mm256_setzero_ps();
+		for (; i < end; i += 8) {
+			__m256 va = _mm256_loadu_ps(a + i), vb = _mm256_loadu_ps(b + i);
+			aa = _mm256_add_ps(aa, _mm256_mul_ps(va, va));
+			bb = _mm256_add_ps(bb, _mm256_mul_ps(vb, vb));
+			ab = _mm256_add_ps(ab, _mm256_mul_ps(va, vb));
+		}
+		saa += hsum256(aa); sbb += hsum256(bb); sab += hsum256(ab);
+	}
+	dotsScalar(a + i, b + i, n - i, out);
+	out[0] += saa; out[1] += sbb; out[2] += sab;
+}
+
+SM_AVX2 static double sumAVX2(const float *a, size_t n)
+{
+	const size_t full = n & ~(size_t)7;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m256 acc = _mm256_setzero_ps();
+		for (; i < end; i += 8)
+			acc = _mm256_add_ps(acc, _mm256_loadu_ps(a + i));
+		ret += hsum256(acc);
+	}
+	return ret + sumScalar(a + i, n - i);
+}
+
+SM_AVX2 static inline bool logValid256(__m256 x)
+{
+	__m256 ok = _mm256_and_ps(
+			_mm256_cmp_ps(x, _mm256_set1_ps(FLT_MIN), _CMP_GE_OQ),
+			_mm256_cmp_ps(x, _mm256_set1_ps(FLT_MAX), _CMP_LE_OQ));
+	return _mm256_movemask_ps(ok) == 0xff;
+}
+
+/// see logSSE2Inl()
+SM_AVX2 static inline __m256 logAVX2Inl(__m256 x)
+{
+	const __m256 one = _mm256_set1_ps(1.f);
+	__m256i bits = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+			_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+			_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+			_mm256_set1_epi32(0x3f000000)));
+	__m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(logSqrtHalf), _CMP_LT_OQ);
+	e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+	m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), one);
+
+	__m256 z = _mm256_mul_ps(m, m);
+	__m256 y = _mm256_set1_ps(logPoly[0]);
+	for (int i = 1; i < 9; ++i)
+		y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(logPoly[i]));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+	y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(logLn2Lo)));
+	y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+	return _mm256_add_ps(_mm256_add_ps(m, y),
+						 _mm256_mul_ps(e, _mm256_set1_ps(logLn2Hi)));
+}
+
+SM_AVX2 static void logAVX2(const float *x, float *y, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 v = _mm256_loadu_ps(x + i);
+		if (logValid256(v))
+			_mm256_storeu_ps(y + i, logAVX2Inl(v));
+		else
+			logScalar(x + i, y + i, 8);
+	}
+	logScalar(x + i, y + i, n - i);
+}
+
+SM_AVX2 static double divergenceAVX2(const float *a, const float *loga,
+									 float ia, const float *b, float ib,
+									 size_t n)
+{
+	const __m256 via = _mm256_set1_ps(ia), vib = _mm256_set1_ps(ib);
+	const size_t full = n & ~(size_t)7;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m256 acc = _mm256_setzero_ps();
+		for (; i < end; i += 8) {
+			__m256 vb = _mm256_loadu_ps(b + i), logb;
+			if (logValid256(vb)) {
+				logb = logAVX2Inl(vb);
+			} else {
+				float tmp[8];
+				logScalar(b + i, tmp, 8);
+				logb = _mm256_loadu_ps(tmp);
+			}
+			__m256 p = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), via),
+									 _mm256_mul_ps(vb, vib));
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(p,
+					_mm256_sub_ps(_mm256_loadu_ps(loga + i), logb)));
+		}
+		ret += hsum256(acc);
+	}
+	return ret + divergenceScalar(a + i, loga + i, ia, b + i, ib, n - i);
+}
+
+static const Table avx2Table = {
+	"AVX2", l1AVX2, l2sqAVX2, linfAVX2, dotsAVX2, sumAVX2,
+	logAVX2, divergenceAVX2
+};
+
+/* AVX-512 handles the tail with a masked load, inactive lanes read as 0 */
+
+#define SM_AVX512 __attribute__((target("avx512f")))
+
+SM_AVX512 static inline __mmask16 tailMask(size_t rest)
+{
+	return (__mmask16)((1u << rest) - 1u);
+}
+
+/// same as _mm512_max_ps, which trips -Wuninitialized with some gcc versions
+SM_AVX512 static inline __m512 max512(__m512 a, __m512 b)
+{
+	return _mm512_mask_max_ps(a, (__mmask16)0xffff, a, b);
+}
+
+SM_AVX512 static inline float hsum512(__m512 v)
+{
+	float lanes[16];
+	_mm512_storeu_ps(lanes, v);
+	float ret = 0.f;
+	for (int i = 0; i < 16; ++i)
+		ret += lanes[i];
+	return ret;
+}
+
+SM_AVX512 static inline float hmax512(__m512 v)
+{
+	float lanes[16];
+	_mm512_storeu_ps(lanes, v);
+	return *std::max_element(lanes, lanes + 16);
+}
+
+SM_AVX512 static double l1AVX512(const float *a, const float *b, size_t n)
+{
+	double ret = 0.;
+	size_t i = 0;
+	while (i < n) {
+		const size_t end = blockEnd(i, n);
+		__m512 acc = _mm512_setzero_ps();
+		for (; i < end; i += 16) {
+			__mmask16 m = (i + 16 <= n ? (__mmask16)0xffff : tailMask(n - i));
+			__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+									 _mm512_maskz_loadu_ps(m, b + i));
+			acc = _mm512_add_ps(acc, _mm512_abs_ps(d));
+		}
+		ret += hsum512(acc);
+	}
+	return ret;
+}
+
+SM_AVX512 static double l2sqAVX512(const float *a, const float *b, size_t n)
+{
+	double ret = 0.;
+	size_t i = 0;
+	while (i < n) {
+		const size_t end = blockEnd(i, n);
+		__m512 acc = _mm512_setzero_ps();
+		for (; i < end; i += 16) {
+			__mmask16 m = (i + 16 <= n ? (__mmask16)0xffff : tailMask(n - i));
+			__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+									 _mm512_maskz_loadu_ps(m, b + i));
+			acc = _mm512_add_ps(acc, _mm512_mul_ps(d, d));
+		}
+		ret += hsum512(acc);
+	}
+	return ret;
+}
+
+SM_AVX512 static double linfAVX512(const float *a, const float *b, size_t n)
+{
+	__m512 acc = _mm512_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m512 d = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+		acc = max512(acc, _mm512_abs_ps(d));
+	}
+	if (i < n) {
+		__mmask16 m = tailMask(n - i);
+		__m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(m, a + i),
+								 _mm512_maskz_loadu_ps(m, b + i));
+		acc = max512(acc, _mm512_abs_ps(d));
+	}
+	return hmax512(acc);
+}
+
+SM_AVX512 static void dotsAVX512(const float *a, const float *b, size_t n,
+								 double *out)
+{
+	out[0] = out[1] = out[2] = 0.;
+	size_t i = 0;
+	while (i < n) {
+		const size_t end = blockEnd(i, n);
+		__m512 aa = _mm512_setzero_ps(), bb = _mm512_setzero_ps(),
+			   ab = _mm512_setzero_ps();
+		for (; i < end; i += 16) {
+			__mmask16 m = (i + 16 <= n ? (__mmask16)0xffff : tailMask(n - i));
+			__m512 va = _mm512_maskz_loadu_ps(m, a + i);
+			__m512 vb = _mm512_maskz_loadu_ps(m, b + i);
+			aa = _mm512_add_ps(aa, _mm512_mul_ps(va, va));
+			bb = _mm512_add_ps(bb, _mm512_mul_ps(vb, vb));
+			ab = _mm512_add_ps(ab, _mm512_mul_ps(va, vb));
+		}
+		out[0] += hsum512(aa);
+		out[1] += hsum512(bb);
+		out[2] += hsum512(ab);
+	}
+}
+
+SM_AVX512 static double sumAVX512(const float *a, size_t n)
+{
+	double ret = 0.;
+	size_t i = 0;
+	while (i < n) {
+		const size_t end = blockEnd(i, n);
+		__m512 acc = _mm512_setzero_ps();
+		for (; i < end; i += 16) {
+			__mmask16 m = (i + 16 <= n ? (__mmask16)0xffff : tailMask(n - i));
+			acc = _mm512_add_ps(acc, _mm512_maskz_loadu_ps(m, a + i));
+		}
+		ret += hsum512(acc);
+	}
+	return ret;
+}
+
+SM_AVX512 static inline bool logValid512(__m512 x)
+{
+	__mmask16 ok = _mm512_cmp_ps_mask(x, _mm512_set1_ps(FLT_MIN), _CMP_GE_OQ)
+				 & _mm512_cmp_ps_mask(x, _mm512_set1_ps(FLT_MAX), _CMP_LE_OQ);
+	return ok == (__mmask16)0xffff;
+}
+
+/// see logSSE2Inl()
+SM_AVX512 static inline __m512 logAVX512Inl(__m512 x)
+{
+	const __m512 one = _mm512_set1_ps(1.f);
+	__m512i bits = _mm512_castps_si512(x);
+	// masked forms, see max512()
+	const __mmask16 all = (__mmask16)0xffff;
+	__m512 e = _mm512_maskz_cvtepi32_ps(all, _mm512_sub_epi32(
+			_mm512_maskz_srli_epi32(all, bits, 23), _mm512_set1_epi32(126)));
+	__m512 m = _mm512_castsi512_ps(_mm512_or_si512(
+			_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)),
+			_mm512_set1_epi32(0x3f000000)));
+	__mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(logSqrtHalf),
+										 _CMP_LT_OQ);
+	e = _mm512_mask_sub_ps(e, small, e, one);
+	m = _mm512_sub_ps(_mm512_mask_add_ps(m, small, m, m), one);
+
+	__m512 z = _mm512_mul_ps(m, m);
+	__m512 y = _mm512_set1_ps(logPoly[0]);
+	for (int i = 1; i < 9; ++i)
+		y = _mm512_add_ps(_mm512_mul_ps(y, m), _mm512_set1_ps(logPoly[i]));
+	y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+	y = _mm512_add_ps(y, _mm512_mul_ps(e, _mm512_set1_ps(logLn2Lo)));
+	y = _mm512_sub_ps(y, _mm512_mul_ps(z, _mm512_set1_ps(0.5f)));
+	return _mm512_add_ps(_mm512_add_ps(m, y),
+						 _mm512_mul_ps(e, _mm512_set1_ps(logLn2Hi)));
+}
+
+/* the log kernels leave the tail to the scalar code, as masked-out lanes
+   would fail the validity check */
+
+SM_AVX512 static void logAVX512(const float *x, float *y, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m512 v = _mm512_loadu_ps(x + i);
+		if (logValid512(v))
+			_mm512_storeu_ps(y + i, logAVX512Inl(v));
+		else
+			logScalar(x + i, y + i, 16);
+	}
+	logScalar(x + i, y + i, n - i);
+}
+
+SM_AVX512 static double divergenceAVX512(const float *a, const float *loga,
+										 float ia, const float *b, float ib,
+										 size_t n)
+{
+	const __m512 via = _mm512_set1_ps(ia), vib = _mm512_set1_ps(ib);
+	const size_t full = n & ~(size_t)15;
+	double ret = 0.;
+	size_t i = 0;
+	while (i < full) {
+		const size_t end = blockEnd(i, full);
+		__m512 acc = _mm512_setzero_ps();
+		for (; i < end; i += 16) {
+			__m512 vb = _mm512_loadu_ps(b + i), logb;
+			if (logValid512(vb)) {
+				logb = logAVX512Inl(vb);
+			} else {
+				float tmp[16];
+				logScalar(b + i, tmp, 16);
+				logb = _mm512_loadu_ps(tmp);
+			}
+			__m512 p = _mm512_sub_ps(_mm512_mul_ps(_mm512_loadu_ps(a + i), via),
+									 _mm512_mul_ps(vb, vib));
+			acc = _mm512_add_ps(acc, _mm512_mul_ps(p,
+					_mm512_sub_ps(_mm512_loadu_ps(loga + i), logb)));
+		}
+		ret += hsum512(acc);
+	}
+	return ret + divergenceScalar(a + i, loga + i, ia, b + i, ib, n - i);
+}
+
+static const Table avx512Table = {
+	"AVX-512", l1AVX512, l2sqAVX512, linfAVX512, dotsAVX512, sumAVX512,
+	logAVX512, divergenceAVX512
+};
+
+#endif // SM_KERNELS_DISPATCH
+
+static const Table &selectTable()
+{
+#ifdef SM_KERNELS_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return avx512Table;
+	if (__builtin_cpu_supports("avx2"))
+		return avx2Table;
+#endif
+#ifdef SM_KERNELS_SSE2
+	return sse2Table;
+#else
+	return scalarTable;
+#endif
+}
+
+/// chosen once, thread-safe initialization of function-local static
+static const Table &table()
+{
+	static const Table &t = selectTable();
+	return t;
+}
+
+const char *isa()
+{
+	return table().name;
+}
+
+double l1(const float *a, const float *b, size_t n)
+{
+	return table().l1(a, b, n);
+}
+
+double l2(const float *a, const float *b, size_t n)
+{
+	return std::sqrt(table().l2sq(a, b, n));
+}
+
+double linf(const float *a, const float *b, size_t n)
+{
+	return table().linf(a, b, n);
+}
+
+/// angle from squared norms and dot product
+static inline double angle(double aa, double bb, double ab)
+{
+	// rounding may push identical spectra slightly over 1
+	double c = ab / (std::sqrt(aa) * std::sqrt(bb));
+	return std::acos(std::max(-1., std::min(1., c)));
+}
+
+double sam(const float *a, const float *b, size_t n)
+{
+	double d[3];
+	table().dots(a, b, n, d);
+	return angle(d[0], d[1], d[2]);
+}
+
+/** SID on spectra a, b with sums sa, sb and log(a) given in loga.
+	With p = a/sa and q = b/sb, sum(p*log(p/q) + q*log(q/p)) equals
+	sum((p - q) * (log a - log b)), as p and q both sum up to 1.
+*/
+static double divergence(const Table &t, const float *a, const float *loga,
+						 double sa, const float *b, double sb, size_t n)
+{
+	if (sa == 0. || sb == 0.)
+		return 0.;
+
+	double ret = t.divergence(a, loga, (float)(1. / sa), b, (float)(1. / sb), n);
+	return std::max(ret, 0.); // negative values come from strange pixels.
+}
+
+/// SID using loga as buffer for log(a)
+static double divergence(const Table &t, const float *a, const float *b,
+						 size_t n, float *loga)
+{
+	t.log(a, loga, n);
+	return divergence(t, a, loga, t.sum(a, n), b, t.sum(b, n), n);
+}
+
+double sid(const float *a, const float *b, size_t n)
+{
+	std::vector<float> loga(n);
+	return divergence(table(), a, b, n, &loga[0]);
+}
+
+void oneToMany(Distance dist, const float *query, const float *candidates,
+			   size_t count, size_t stride, size_t n, double *out)
+{
+	const Table &t = table();
+	const float *c = candidates;
+	switch (dist) {
+	case L1:
+		for (size_t i = 0; i < count; ++i, c += stride)
+			out[i] = t.l1(query, c, n);
+		break;
+	case L2:
+		for (size_t i = 0; i < count; ++i, c += stride)
+			out[i] = std::sqrt(t.l2sq(query, c, n));
+		break;
+	case LINF:
+		for (size_t i = 0; i < count; ++i, c += stride)
+			out[i] = t.linf(query, c, n);
+		break;
+	case SAM:
+		for (size_t i = 0; i < count; ++i, c += stride) {
+			double d[3];
+			t.dots(query, c, n, d);
+			out[i] = angle(d[0], d[1], d[2]);
+		}
+		break;
+	case SID:
+	{
+		// logarithm and sum of the query are needed only once
+		std::vector<float> logq(n);
+		t.log(query, &logq[0], n);
+		double sq = t.sum(query, n);
+		for (size_t i = 0; i < count; ++i, c += stride)
+			out[i] = divergence(t, query, &logq[0], sq, c, t.sum(c, n), n);
+		break;
+	}
+	}
+}
+
+void pairwise(Distance dist, const float *data, size_t stride, size_t n,
+			  const std::pair<int, int> *pairs, size_t count, double *out)
+{
+	const Table &t = table();
+	std::vector<float> buffer(dist == SID ? n : 0);
+	for (size_t i = 0; i < count; ++i) {
+		const float *a = data + pairs[i].first * stride;
+		const float *b = data + pairs[i].second * stride;
+		switch (dist) {
+		case L1:
+			out[i] = t.l1(a, b, n);
+			break;
+		case L2:
+			out[i] = std::sqrt(t.l2sq(a, b, n));
+			break;
+		case LINF:
+			out[i] = t.linf(a, b, n);
+			break;
+		case SAM:
+		{
+			double d[3];
+			t.dots(a, b, n, d);
+			out[i] = angle(d[0], d[1], d[2]);
+			break;
+		}
+		case SID:
+			out[i] = divergence(t, a, b, n, &buffer[0]);
+			break;
+		}
+	}
+}
+
+} // namespace kernels
+} // namespace similarity_measures
@@ -0,0 +1,61 @@
+#ifndef SM_KERNELS_H
+#define SM_KERNELS_H
+
+#include <cstddef>
+#include <utility>
+
+namespace similarity_measures {
+
+/**
+* @namespace kernels
+*
+* @brief vectorized per-spectrum distances on float data
+*
+* The instruction set (AVX-512, AVX2 or SSE2) is chosen at runtime, on first
+* use, according to the capabilities of the CPU. All loads are unaligned, so
+* the data may start at any address. Sums are accumulated in double precision,
+* vector lanes only sum up blocks of 64 values in single precision first. No FMA
+* is used, so results of different instruction sets only differ by the order
+* of summation.
+* The logarithms needed by SID are computed in the vector lanes as well,
+* within 1 ulp of std::log().
+*/
+namespace kernels {
+
+/// name of the instruction set in use
+const char *isa();
+
+/// Manhattan distance
+double l1(const float *a, const float *b, size_t n);
+/// Euclidean distance
+double l2(const float *a, const float *b, size_t n);
+/// Chebyshev distance
+double linf(const float *a, const float *b, size_t n);
+/// spectral angle in radians (see ModifiedSpectralAngleSimilarity)
+double sam(const float *a, const float *b, size_t n);
+/// spectral information divergence (see SpectralInformationDivergence)
+double sid(const float *a, const float *b, size_t n);
+
+/// distances available in oneToMany()
+enum Distance { L1, L2, LINF, SAM, SID };
+
+/** Compute distances of one query to several candidates.
+	Candidate i starts at candidates + i*stride, all have length n. Anything
+	only depending on the query (e.g. its norm) is computed once.
+	@arg out receives count distances
+*/
+void oneToMany(Distance dist, const float *query, const float *candidates,
+			   size_t count, size_t stride, size_t n, double *out);
+
+/** Compute distances of pairs of vectors, e.g. neighboring pixels.
+	Vector r starts at data + r*stride and has length n, for each pair the
+	distance between vectors pair.first and pair.second is computed.
+	@arg out receives count distances
+*/
+void pairwise(Distance dist, const float *data, size_t stride, size_t n,
+			  const std::pair<int, int> *pairs, size_t count, double *out);
+
+} // namespace kernels
+} // namespace similarity_measures
+
+#endif // SM_KERNELS_H
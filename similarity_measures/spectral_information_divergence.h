@@ -11,6 +11,7 @@
 #define VOLE_INF_DIV_H
 
 #include "similarity_measure.h"
+#include "sm_kernels.h"
 #include <iostream>
 #include <limits>
 
@@ -30,6 +31,13 @@ public:
 	SpectralInformationDivergence() {}
 
 	double getSimilarity(const cv::Mat_<T> &img1, const cv::Mat_<T> &img2);
+	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2);
+	double getSimilarity(const T *v1, const T *v2, size_t n);
+	void getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+						 std::vector<double> &out);
+	void getSimilarities(const cv::Mat_<T> &data, int width,
+						 const std::vector<std::pair<int, int> > &pairs,
+						 std::vector<double> &out);
 };
 
 template<typename T>
@@ -43,16 +51,55 @@ inline double SpectralInformationDivergence<T>::getSimilarity(const cv::Mat_<T>
 		return 0.;
 		// can be harmful to graphseg: return (s1[0] == s2[0] ? 0. : std::numeric_limits<double>::max());
 
-	p1 /= s1[0];
-	p2 /= s2[0];
+	// normalize into new matrices, the input may be image data
+	cv::Mat_<T> n1 = p1 / s1[0];
+	cv::Mat_<T> n2 = p2 / s2[0];
 
 	cv::Mat_<T> l1, l2;
-	cv::log(p1 / p2, l1);
-	cv::log(p2 / p1, l2);
-	cv::Scalar ret = cv::sum(p1.mul(l1)) + cv::sum(p2.mul(l2));
+	cv::log(n1 / n2, l1);
+	cv::log(n2 / n1, l2);
+	cv::Scalar ret = cv::sum(n1.mul(l1)) + cv::sum(n2.mul(l2));
 	return std::max(ret[0], 0.); // negative values come from strange pixels.
 }
 
+template<typename T>
+inline double SpectralInformationDivergence<T>::getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2)
+{
+	this->check(v1, v2);
+
+	return getSimilarity(&v1[0], &v2[0], v1.size());
+}
+
+template<typename T>
+inline double SpectralInformationDivergence<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	assert(n > 0);
+
+	double s1 = 0., s2 = 0.;
+	for (size_t i = 0; i < n; ++i) {
+		s1 += v1[i];
+		s2 += v2[i];
+	}
+	if (s1 == 0. || s2 == 0.)
+		return 0.;
+
+	// p*log(p/q) + q*log(q/p) = (p - q)*log(p/q)
+	double ret = 0.;
+	for (size_t i = 0; i < n; ++i) {
+		double p = v1[i] / s1, q = v2[i] / s2;
+		ret += (p - q) * std::log(p / q);
+	}
+	return std::max(ret, 0.); // negative values come from strange pixels.
+}
+
+template<>
+inline double SpectralInformationDivergence<float>::getSimilarity(const float *v1, const float *v2, size_t n)
+{
+	assert(n > 0);
+
+	return kernels::sid(v1, v2, n);
+}
+
 	/** The following code implements SID as it is defined in
 		Spectral Matching Accuracy in Processing Hyperspectral Data
 		Stefan A. Robila, 2005
@@ -76,6 +123,42 @@ inline double SpectralInformationDivergence<T>::getSimilarity(const cv::Mat_<T>
 	return std::abs<double>(ret);
 	**/
 
+template<typename T>
+inline void SpectralInformationDivergence<T>::getSimilarities(const T *query, const cv::Mat_<T> &candidates,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(query, candidates, out);
+}
+
+template<typename T>
+inline void SpectralInformationDivergence<T>::getSimilarities(const cv::Mat_<T> &data, int width,
+									 const std::vector<std::pair<int, int> > &pairs,
+									 std::vector<double> &out)
+{
+	SimilarityMeasure<T>::getSimilarities(data, width, pairs, out);
+}
+
+template<>
+inline void SpectralInformationDivergence<float>::getSimilarities(const float *query, const cv::Mat_<float> &candidates,
+										 std::vector<double> &out)
+{
+	out.resize(candidates.rows);
+	if (candidates.rows > 0)
+		kernels::oneToMany(kernels::SID, query, candidates[0], candidates.rows,
+						   candidates.step1(), candidates.cols, &out[0]);
+}
+
+template<>
+inline void SpectralInformationDivergence<float>::getSimilarities(const cv::Mat_<float> &data, int width,
+										 const std::vector<std::pair<int, int> > &pairs,
+										 std::vector<double> &out)
+{
+	out.resize(pairs.size());
+	if (!pairs.empty())
+		kernels::pairwise(kernels::SID, data[0], data.step1(), data.cols,
+						  &pairs[0], pairs.size(), &out[0]);
+}
+
 } // namespace
 
 #endif
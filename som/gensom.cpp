@@ -7,9 +7,12 @@
 #include <sm_factory.h>
 
 #include <opencv2/highgui/highgui.hpp> // for debug writeout
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <boost/cstdint.hpp>
 #include <boost/filesystem.hpp>
 #include <fstream>
+#include <map>
 #include <algorithm>
 #include <functional>
 
@@ -40,6 +43,17 @@ void GenSOM::train(const multi_img &input, ProgressObserver *po)
 		std::cout  << "  0 %"; std::cout.flush();
 	long sumOfUpdates = 0;
 
+	// neurons change with every sample, batched search is not possible
+	// (batch training refreshes the matrix for each batch)
+	neuronMatrix.release();
+	index.clear();
+	bool batchMode = (config.batchSize > 1);
+	std::vector<multi_img::PixelView> batch;
+	if (batchMode) {
+		input.rebuildPixels();
+		batch.reserve(config.batchSize);
+	}
+
 	// starting training (notifier needed by OpenCL impl.)
 	notifyTrainingStart();
 
@@ -47,9 +61,20 @@ void GenSOM::train(const multi_img &input, ProgressObserver *po)
 	cv::MatConstIterator_<int> itX = shuffledX.begin();
 	for (int curIter = 0; curIter < maxIter; ++curIter, ++itX, ++itY)
 	{
-		// feed one sample
-		const multi_img::Pixel &vec = input(*itY, *itX);
-		sumOfUpdates += trainSingle(vec, curIter, maxIter);
+		if (batchMode) {
+			// collect samples, update when batch is complete
+			batch.push_back(input(*itY, *itX));
+			if ((int)batch.size() == config.batchSize
+				|| curIter == maxIter - 1) {
+				int first = curIter + 1 - (int)batch.size();
+				sumOfUpdates += trainBatch(batch, first, maxIter);
+				batch.clear();
+			}
+		} else {
+			// feed one sample
+			multi_img::PixelView vec = input(*itY, *itX);
+			sumOfUpdates += trainSingle(vec, curIter, maxIter);
+		}
 
 		// print progress (and maybe exit)
 		if ((config.verbosity > 0 || po) && (config.maxIter > 100)
@@ -60,6 +85,7 @@ void GenSOM::train(const multi_img &input, ProgressObserver *po)
 				bool cont = po->update(curIter / (float)config.maxIter);
 				if (!cont) {
 					std::cerr << "Aborting training" << std::endl;
+					updateNeuronMatrix();
 					return;
 				}
 			} else {
@@ -111,6 +137,7 @@ void GenSOM::train(const multi_img &input, ProgressObserver *po)
 
 	// finished training (notifier needed by OpenCL impl.)
 	notifyTrainingEnd();
+	updateNeuronMatrix();
 
 	std::cout <<"# Feeding done" <<std::endl;
 
@@ -124,16 +151,23 @@ void GenSOM::train(const multi_img &input, ProgressObserver *po)
     }
  }
 
-int GenSOM::trainSingle(const multi_img::Pixel &input, int iter, int max)
+void GenSOM::schedule(int iter, int max,
+					  double &learnRate, double &sigma) const
 {
-	// adjust learning rate and radius
 	// note that they are _decreasing_ -> start * (end/start)^(iter%)
-	double learnRate = config.learnStart * std::pow(
+	learnRate = config.learnStart * std::pow(
 				config.learnEnd / config.learnStart,
 				(double)iter/(double)max);
-	double sigma = config.sigmaStart * std::pow(
+	sigma = config.sigmaStart * std::pow(
 				config.sigmaEnd / config.sigmaStart,
 				(double)iter/(double)max);
+}
+
+int GenSOM::trainSingle(const multi_img::PixelView &input, int iter, int max)
+{
+	// adjust learning rate and radius
+	double learnRate, sigma;
+	schedule(iter, max, learnRate, sigma);
 
 	// find best matching unit to given input vector
 	size_t index = findBMU(input).index;
@@ -146,6 +180,91 @@ int GenSOM::trainSingle(const multi_img::Pixel &input, int iter, int max)
 	return updates;
 }
 
+int GenSOM::trainBatch(const std::vector<multi_img::PixelView> &batch,
+						int iter, int max)
+{
+	// learning rate and radius are held constant during the batch
+	double learnRate, sigma;
+	schedule(iter, max, learnRate, sigma);
+
+	// neurons do not change during the batch, find all BMUs in parallel
+	updateNeuronMatrix(false);
+	std::vector<size_t> bmus(batch.size());
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, batch.size()),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t i = r.begin(); i != r.end(); ++i)
+			bmus[i] = findBMU(batch[i]).index;
+	});
+
+	// sum up samples sharing a BMU, in sample order
+	size_t nbands = neurons[0].size();
+	std::map<size_t, size_t> slots; // BMU -> row in sums
+	std::vector<std::vector<double> > sums;
+	std::vector<int> counts;
+	for (size_t i = 0; i < batch.size(); ++i) {
+		std::map<size_t, size_t>::iterator it = slots.find(bmus[i]);
+		if (it == slots.end()) {
+			it = slots.insert(std::make_pair(bmus[i], counts.size())).first;
+			sums.push_back(std::vector<double>(nbands, 0.));
+			counts.push_back(0);
+		}
+		std::vector<double> &s = sums[it->second];
+		for (size_t d = 0; d < nbands; ++d)
+			s[d] += batch[i][d];
+		counts[it->second]++;
+	}
+
+	// neighborhood of each BMU, only recorded
+	std::vector<std::vector<std::pair<size_t, double> > > hoods(counts.size());
+	for (std::map<size_t, size_t>::const_iterator it = slots.begin();
+		 it != slots.end(); ++it) {
+		recorder = &hoods[it->second];
+		updateNeighborhood(it->first, multi_img::PixelView(), sigma, learnRate);
+	}
+	recorder = 0;
+
+	// accumulate weights and weighted sums per neuron
+	int updates = 0;
+	std::vector<double> den(neurons.size(), 0.);
+	for (size_t g = 0; g < hoods.size(); ++g) {
+		for (size_t k = 0; k < hoods[g].size(); ++k)
+			den[hoods[g][k].first] += hoods[g][k].second * counts[g];
+		updates += hoods[g].size() * counts[g];
+	}
+	/* we split the bands among threads, so every value is summed in the
+	 * same order regardless of the number of threads */
+	cv::Mat_<double> num((int)neurons.size(), (int)nbands, 0.);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, nbands, 8),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t g = 0; g < hoods.size(); ++g) {
+			const std::vector<double> &s = sums[g];
+			for (size_t k = 0; k < hoods[g].size(); ++k) {
+				double *dst = num[hoods[g][k].first];
+				double w = hoods[g][k].second;
+				for (size_t d = r.begin(); d != r.end(); ++d)
+					dst[d] += w * s[d];
+			}
+		}
+	});
+
+	/* apply the summed updates Σ w_i (x_i - n), normalized when weights add
+	 * up to more than one (would overshoot otherwise) */
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, neurons.size()),
+		[&](const tbb::blocked_range<size_t> &r) {
+		for (size_t j = r.begin(); j != r.end(); ++j) {
+			if (den[j] == 0.)
+				continue;
+			double norm = std::max(1., den[j]);
+			Neuron &ne = neurons[j];
+			const double *s = num[j];
+			for (size_t d = 0; d < nbands; ++d)
+				ne[d] += (s[d] - den[j] * ne[d]) / norm;
+		}
+	});
+
+	return updates;
+}
+
 double GenSOM::gaussWeight(double distance, double sigma, double learnRate)
 {
 	double gaussian = exp(-(distance) / (2.0*sigma*sigma));
@@ -190,7 +309,8 @@ void writeLittle(std::ostream &os, const T& x)
 GenSOM::GenSOM(const SOMConfig &config)
 	: config(config),
 	  distfun(similarity_measures::SMFactory<value_type>::
-			  spawn(config.similarity))
+			  spawn(config.similarity)),
+	  recorder(0)
 {}
 
 void GenSOM::init(size_t nneurons, size_t nbands, bool randomize)
@@ -206,6 +326,55 @@ void GenSOM::init(size_t nneurons, size_t nbands, bool randomize)
 			neurons[i].randomize(rng, 0., 1.);
 		}
 	}
+	updateNeuronMatrix();
+}
+
+void GenSOM::updateNeuronMatrix(bool withIndex)
+{
+	index.clear();
+	if (neurons.empty()) {
+		neuronMatrix.release();
+		return;
+	}
+
+	neuronMatrix.create(neurons.size(), neurons[0].size());
+	for (size_t i = 0; i < neurons.size(); ++i)
+		std::copy(neurons[i].begin(), neurons[i].end(), neuronMatrix[i]);
+
+	/* the index needs a metric (triangle inequality), and only pays off
+	 * against the vectorized linear scan for many neurons */
+	if (!withIndex || neurons.size() < SOM_INDEX_MIN_NEURONS)
+		return;
+	switch (config.similarity.function) {
+	case similarity_measures::MANHATTAN:
+		index.build(neuronMatrix, similarity_measures::kernels::L1);
+		break;
+	case similarity_measures::EUCLIDEAN:
+		index.build(neuronMatrix, similarity_measures::kernels::L2);
+		break;
+	case similarity_measures::CHEBYSHEV:
+		index.build(neuronMatrix, similarity_measures::kernels::LINF);
+		break;
+	default:
+		break;
+	}
+}
+
+void GenSOM::distances(const multi_img::PixelView &inputVec,
+					   std::vector<double> &out) const
+{
+	if (neuronMatrix.rows == (int)neurons.size()) {
+		// one call for all neurons
+		distfun->getSimilarities(inputVec.data(), neuronMatrix, out);
+		return;
+	}
+
+	out.resize(neurons.size());
+	for (size_t idx = 0; idx < neurons.size(); ++idx) {
+		out[idx] = distfun->getSimilarity(neurons[idx].data(),
+										  inputVec.data(),
+										  inputVec.size());
+	}
 }
 
 GenSOM *GenSOM::create(const SOMConfig &conf, size_t nbands, bool randomize)
@@ -258,15 +427,22 @@ GenSOM *GenSOM::create(const SOMConfig &conf, const multi_img &img,
 }
 
 DistIndexPair
-GenSOM::findBMU(const multi_img::Pixel &inputVec) const
+GenSOM::findBMU(const multi_img::PixelView &inputVec) const
 {
 	// the best matching unit (index and distance to input) we want to find
 	DistIndexPair bmu;
 
-	for (size_t idx = 0; idx < neurons.size(); ++idx) {
-		const double dist = distfun->getSimilarity(neurons[idx], inputVec);
-		if (dist < bmu.dist) {
-			bmu.dist = dist;
+	if (!index.empty()) {
+		std::vector<NeuronIndex::Entry> found;
+		index.closestN(inputVec.data(), 1, found);
+		return DistIndexPair(found[0].first, found[0].second);
+	}
+
+	std::vector<double> dists;
+	distances(inputVec, dists);
+	for (size_t idx = 0; idx < dists.size(); ++idx) {
+		if (dists[idx] < bmu.dist) {
+			bmu.dist = dists[idx];
 			bmu.index = idx;
 		}
 	}
@@ -401,6 +577,7 @@ GenSOM *GenSOM::loadFile(std::istream &is, const SOMConfig& config)
 			ne[j] = readLittle<float>(is);
 		}
 	}
+	som->updateNeuronMatrix();
 	return som;
 }
 
@@ -8,6 +8,7 @@
 
 #include "som_neuron.h"
 #include "som_config.h"
+#include "som_index.h"
 
 class ProgressObserver;
 
@@ -108,14 +109,14 @@ public:
 	 *
 	 * @return Pair of distance and linear index into the SOM's neuron array.
 	 */
-	DistIndexPair findBMU(const multi_img::Pixel &inputVec) const;
+	DistIndexPair findBMU(const multi_img::PixelView &inputVec) const;
 
 	/** Find closest n neurons for inputVec.
 	 *
 	 * Also known as k-nearest neighbours (kNN).
 	 * The result vector is sorted by ascending distance.
 	 */
-	std::vector<DistIndexPair> findClosestN(const multi_img::Pixel &p,
+	std::vector<DistIndexPair> findClosestN(const multi_img::PixelView &p,
 											size_t n) const
 	{
 		std::vector<DistIndexPair> ret(n);
@@ -132,7 +133,7 @@ public:
 	 * T must meet the requirements of the RandomAccessIterator concept.
 	 */
 	template<typename T>
-	void findClosestN(const multi_img::Pixel &inputVec,
+	void findClosestN(const multi_img::PixelView &inputVec,
 					  T dfirst, T dlast) const;
 
 	/** Return a higher-dimensional coordinate for a neuron at index idx,
@@ -180,10 +181,32 @@ protected:
 	void init(size_t nbands, size_t nneurons, bool randomize);
 
 	virtual int updateNeighborhood(size_t index,
-								   const multi_img::Pixel &input,
+								   const multi_img::PixelView &input,
 								   double sigma, double learnRate) = 0;
 	// helper to train()
-	int trainSingle(const multi_img::Pixel &input, int iter, int max);
+	int trainSingle(const multi_img::PixelView &input, int iter, int max);
+	/** helper to train(): one update for a batch of samples (batch SOM)
+	 *
+	 * BMUs are searched in parallel against the neurons at the start of the
+	 * batch. The neighborhood-weighted sums of all samples are accumulated
+	 * and applied at once. Summation order does not depend on the threads.
+	 * @param iter iteration of the first sample in the batch
+	 */
+	int trainBatch(const std::vector<multi_img::PixelView> &batch,
+				   int iter, int max);
+	// learning rate and neighborhood radius at iteration iter
+	void schedule(int iter, int max, double &learnRate, double &sigma) const;
+	/** helper to updateNeighborhood(): update neuron at linear index idx
+	 * (or record the update, see recorder).
+	 */
+	inline void updateNeuron(size_t idx, const multi_img::PixelView &input,
+							 double weight)
+	{
+		if (recorder)
+			recorder->push_back(std::make_pair(idx, weight));
+		else
+			neurons[idx].update(input, weight);
+	}
 	// helper to updateNeighborhood()
 	double gaussWeight(double distance, double sigma, double learnRate);
 	// is called before feeding
@@ -207,8 +230,33 @@ protected:
 	// Flat storage of n-dimensional SOM neuron structure.
 	std::vector<Neuron> neurons;
 
+	/** Copy of the neurons with one neuron per row, for batched distance
+	 * computation. It is released during training, as neurons change.
+	 */
+	cv::Mat_<value_type> neuronMatrix;
+
+	/** Copy neurons into neuronMatrix (after initialization or training)
+	 * @param withIndex also rebuild the nearest neighbor index (if used)
+	 */
+	void updateNeuronMatrix(bool withIndex = true);
+
+	/** Exact nearest neighbor index for metric distances and large SOMs.
+	 * Empty if not applicable, or during training. Searches fall back to
+	 * linear scans then.
+	 */
+	NeuronIndex index;
+
+	/// Compute distances of inputVec to all neurons, batched if possible
+	void distances(const multi_img::PixelView &inputVec,
+				   std::vector<double> &out) const;
+
 	similarity_measures::SimilarityMeasure<value_type> *distfun;
 
+	/** If set, updateNeighborhood() only records the neurons it would update,
+	 * and their weights, instead of updating them (used by trainBatch()).
+	 */
+	std::vector<std::pair<size_t, double> > *recorder;
+
 private:
 	GenSOM(); // undefined
 	GenSOM(const GenSOM& other); // undefined
@@ -216,7 +264,7 @@ private:
 };
 
 template<typename T> // T is iterator to a container of DistIndexPairs
-void GenSOM::findClosestN(const multi_img::Pixel &inputVec,
+void GenSOM::findClosestN(const multi_img::PixelView &inputVec,
 						  T dfirst, T dlast) const
 {
 	// initialize heap with infinity distances
@@ -224,11 +272,19 @@ void GenSOM::findClosestN(const multi_img::Pixel &inputVec,
 			  dlast,
 			  DistIndexPair());
 
-	for (std::vector<Neuron>::const_iterator it = neurons.begin();
-		 it != neurons.end();
-		 ++it)
+	if (!index.empty()) {
+		std::vector<NeuronIndex::Entry> found;
+		index.closestN(inputVec.data(), dlast - dfirst, found);
+		for (size_t i = 0; i < found.size(); ++i, ++dfirst)
+			*dfirst = DistIndexPair(found[i].first, found[i].second);
+		return;
+	}
+
+	std::vector<double> dists;
+	distances(inputVec, dists);
+	for (size_t idx = 0; idx < dists.size(); ++idx)
 	{
-		value_type dist = distfun->getSimilarity(*it, inputVec);
+		value_type dist = dists[idx];
 
 		if (dist < dfirst->dist) {
 			// remove max. value in heap
@@ -237,8 +293,8 @@ void GenSOM::findClosestN(const multi_img::Pixel &inputVec,
 			// max element is now on position "back" and should be popped
 			// instead we overwrite it directly with the new element
 			DistIndexPair &back = *(dlast-1);
-			back = DistIndexPair(dist,                  // distance
-								 it - neurons.begin()); // index into neurons
+			back = DistIndexPair(dist,  // distance
+								 idx);  // index into neurons
 			std::push_heap(dfirst, dlast, DistIndexPair::cmpDist);
 		}
 	}
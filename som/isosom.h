@@ -12,7 +12,7 @@ public:
 	IsoSOM(const SOMConfig &config, size_t nbands, bool randomize);
 
 	int updateNeighborhood(size_t index,
-						   const multi_img::Pixel &input,
+						   const multi_img::PixelView &input,
 						   double sigma, double learnRate);
 
 	std::vector<float> getCoord(size_t idx, bool normalize = true) const;
@@ -22,12 +22,12 @@ public:
 protected:
 	// helper called by updateNeighborhood for 2D, part of 3D case
 	int updateNeighborhoodGauss2D(size_t index,
-						   const multi_img::Pixel &input,
+						   const multi_img::PixelView &input,
 						   double sigma, double learnRate, int deltaZ);
 
 	// helper called by updateNeighborhood for all cases
 	int updateNeighborhoodUniform(size_t index,
-						   const multi_img::Pixel &input,
+						   const multi_img::PixelView &input,
 						   double sigma, double learnRate);
 
 	// convert from 1d to Nd index
@@ -7,7 +7,7 @@
 
 template<>
 inline int IsoSOM<2>::updateNeighborhood(size_t index,
-										 const multi_img::Pixel &input,
+										 const multi_img::PixelView &input,
 										 double sigma, double learnRate)
 {
 	if (learnRate < 0.01) // not worthy to continue
@@ -6,7 +6,7 @@
  * compile units. For most methods we wanted inline anyway, so it is o.k... */
 
 template<>
-inline int IsoSOM<3>::updateNeighborhood(size_t index, const multi_img::Pixel &input,
+inline int IsoSOM<3>::updateNeighborhood(size_t index, const multi_img::PixelView &input,
 							   double sigma, double learnRate)
 {
 	if (learnRate < 0.01) // not worthy to continue
@@ -29,7 +29,7 @@ std::vector<float> IsoSOM<N>::getCoord(size_t idx, bool normalize) const
 }
 
 template <size_t N>
-int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &input,
+int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::PixelView &input,
 								 double sigma, double learnRate, int deltaZ)
 {
 	/* deltaZ tells us that instead of updating one flat 2D SOM, we update two
@@ -50,7 +50,7 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 
 	if (!deltaZ) {
 		// update at center. distance = 0, we can assume full weight
-		neurons[index].update(input, learnRate);
+		updateNeuron(index, input, learnRate);
 		updates = 1;
 	} else {
 		// one update in each center of both slices
@@ -61,7 +61,7 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 				return 0;
 
 			if (pos.z + dZ >= 0 && pos.z + dZ < depth)
-			{ ++updates; n(pos.x, pos.y, pos.z + dZ).update(input, w); }
+			{ ++updates; updateNeuron(idx(pos.x, pos.y, pos.z + dZ), input, w); }
 		}
 	}
 
@@ -93,14 +93,14 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 				if (pZ >= 0 && pZ < depth) {
 					// x axis
 					if (posX)
-					{ ++updates; n(pos.x + i, pos.y, pZ).update(input, w); }
+					{ ++updates; updateNeuron(idx(pos.x + i, pos.y, pZ), input, w); }
 					if (negX)
-					{ ++updates; n(pos.x - i, pos.y, pZ).update(input, w); }
+					{ ++updates; updateNeuron(idx(pos.x - i, pos.y, pZ), input, w); }
 					// y axis
 					if (negY)
-					{ ++updates; n(pos.x, pos.y - i, pZ).update(input, w); }
+					{ ++updates; updateNeuron(idx(pos.x, pos.y - i, pZ), input, w); }
 					if (posY)
-					{ ++updates; n(pos.x, pos.y + i, pZ).update(input, w); }
+					{ ++updates; updateNeuron(idx(pos.x, pos.y + i, pZ), input, w); }
 				}
 			}
 		}
@@ -131,21 +131,21 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 					if (posY) {
 						if (posX) { // first quadrant
 							++updates;
-							n(pos.x + i, pos.y + i, pZ).update(input, w);
+							updateNeuron(idx(pos.x + i, pos.y + i, pZ), input, w);
 						}
 						if (negX) { // second quadrant
 							++updates;
-							n(pos.x - i, pos.y + i, pZ).update(input, w);
+							updateNeuron(idx(pos.x - i, pos.y + i, pZ), input, w);
 						}
 					}
 					if (negY) {
 						if (negX) { // third quadrant
 							++updates;
-							n(pos.x - i, pos.y - i, pZ).update(input, w);
+							updateNeuron(idx(pos.x - i, pos.y - i, pZ), input, w);
 						}
 						if (posX) { // fourth quadrant
 							++updates;
-							n(pos.x + i, pos.y - i, pZ).update(input, w);
+							updateNeuron(idx(pos.x + i, pos.y - i, pZ), input, w);
 						}
 					}
 				}
@@ -191,36 +191,36 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 
 					if (posYY && posXX) { //  first quadrant
 						++updates;
-						n(pos.x + x, pos.y + y, pZ).update(input, w);
+						updateNeuron(idx(pos.x + x, pos.y + y, pZ), input, w);
 					}
 					if (posYY && negXX) { // second quadrant
 						++updates;
-						n(pos.x - x, pos.y + y, pZ).update(input, w);
+						updateNeuron(idx(pos.x - x, pos.y + y, pZ), input, w);
 					}
 					if (negYY && negXX) { //  third quadrant
 						++updates;
-						n(pos.x - x, pos.y - y, pZ).update(input, w);
+						updateNeuron(idx(pos.x - x, pos.y - y, pZ), input, w);
 					}
 					if (negYY && posXX) { // fourth quadrant
 						++updates;
-						n(pos.x + x, pos.y - y, pZ).update(input, w);
+						updateNeuron(idx(pos.x + x, pos.y - y, pZ), input, w);
 					}
 					// swapping x and y mirrors over diagonal of the quadrant
 					if (posYX && posXY) { //  first quadrant
 						++updates;
-						n(pos.x + y, pos.y + x, pZ).update(input, w);
+						updateNeuron(idx(pos.x + y, pos.y + x, pZ), input, w);
 					}
 					if (posYX && negXY) { // second quadrant
 						++updates;
-						n(pos.x - y, pos.y + x, pZ).update(input, w);
+						updateNeuron(idx(pos.x - y, pos.y + x, pZ), input, w);
 					}
 					if (negYX && negXY) { //  third quadrant
 						++updates;
-						n(pos.x - y, pos.y - x, pZ).update(input, w);
+						updateNeuron(idx(pos.x - y, pos.y - x, pZ), input, w);
 					}
 					if (negYX && posXY) { // fourth quadrant
 						++updates;
-						n(pos.x + y, pos.y - x, pZ).update(input, w);
+						updateNeuron(idx(pos.x + y, pos.y - x, pZ), input, w);
 					}
 				}
 			}
@@ -234,7 +234,7 @@ int IsoSOM<N>::updateNeighborhoodGauss2D(size_t index, const multi_img::Pixel &i
 // #include <cstdio>
 
 template <size_t N>
-int IsoSOM<N>::updateNeighborhoodUniform(size_t index, const multi_img::Pixel &input, double sigma, double learnRate)
+int IsoSOM<N>::updateNeighborhoodUniform(size_t index, const multi_img::PixelView &input, double sigma, double learnRate)
 {
 	// kernel size
 	int ksize = (int)sigma;
@@ -265,7 +265,7 @@ int IsoSOM<N>::updateNeighborhoodUniform(size_t index, const multi_img::Pixel &i
 			// dbg(y,x) = 255; // for debugging
 			if (N == 2) {
 				++updates;
-				n(x, y).update(input, learnRate);
+				updateNeuron(idx(x, y), input, learnRate);
 			}
 			if (N > 2) {
 				int minz = std::max(pos[2] - (ksize - delta), 0);
@@ -274,7 +274,7 @@ int IsoSOM<N>::updateNeighborhoodUniform(size_t index, const multi_img::Pixel &i
 				for (int z = minz; z <= maxz; ++z) {
 					if (N == 3) {
 						++updates;
-						n(x, y, z).update(input, learnRate);
+						updateNeuron(idx(x, y, z), input, learnRate);
 					}
 					if (N > 3) {
 						int minw = std::max(pos[3] - (ksize - delta), 0);
@@ -282,7 +282,7 @@ int IsoSOM<N>::updateNeighborhoodUniform(size_t index, const multi_img::Pixel &i
 
 						for (int w = minw; w <= maxw; ++w) {
 							++updates;
-							n(x, y, z, w).update(input, learnRate);
+							updateNeuron(idx(x, y, z, w), input, learnRate);
 						}
 					}
 				}
@@ -1,11 +1,55 @@
 #include "som_cache.h"
 
+#include <tbb/blocked_range.h>
 #include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 
 namespace som {
 
+/** Cache file format. A file written on a host with different byte order
+ * fails the version check and is ignored. */
+static const char cacheMagic[] = "gerbilclosestn\x20\x20"; // 16 byte
+static const boost::int32_t cacheVersion = 1;
+
+struct CacheHeader {
+	char magic[16];
+	boost::int32_t version;
+	boost::int32_t height, width, n;
+	boost::uint64_t key;
+};
+
+struct CacheRecord {
+	float dist;
+	boost::uint32_t index;
+};
+
+// the file layout is the in-memory layout of these structs
+static_assert(sizeof(CacheHeader) == 40 && sizeof(CacheRecord) == 8,
+			  "unexpected padding in cache file structs");
+static_assert(sizeof(DistIndexPair::value_type) == sizeof(float),
+			  "cache stores distances as float");
+
+// FNV-1a hash
+static const boost::uint64_t fnvBasis = 14695981039346656037ULL;
+static inline boost::uint64_t fnv(boost::uint64_t h, const void *data,
+								  size_t bytes)
+{
+	const unsigned char *p = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < bytes; ++i) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
 class ClosestNTbb {
 public:
 	ClosestNTbb(SOMClosestN &o, multi_img const& img)
@@ -19,15 +63,17 @@ public:
 		float total = (o.height * o.width);
 		for (int y = r.rows().begin(); y < r.rows().end(); ++y) {
 			for (int x = r.cols().begin(); x < r.cols().end(); ++x) {
-				const multi_img::Pixel& pixel = img(y,x);
+				multi_img::PixelView pixel = img(y,x);
 				const size_t roff = o.roff(x,y);
 				o.som.findClosestN(pixel,
 									o.results.begin() + roff,
 									o.results.begin() + roff + o.n);
 				done++;
 				if (o.po && ((int)done % 1000 == 0)) {
-					if (!o.po->update(done / total, true))
+					if (!o.po->update(done / total, true)) {
+						o.aborted = true;
 						return;
+					}
 					done = 0;
 				}
 			}
@@ -50,9 +96,137 @@ SOMClosestN::SOMClosestN(GenSOM const& som, multi_img const& img, int n,
 	  results(height * width * n),
 	  po(po)
 {
+	aborted = false;
+
+	std::string file;
+	boost::uint64_t key = 0;
+	if (!som.getConfig().closestNCache.empty()) {
+		key = cacheKey(img);
+		file = cacheFile(key);
+		if (loadCache(file, key))
+			return;
+	}
+
 	tbb::parallel_for(tbb::blocked_range2d<int>(0, img.height, // row range
 												0, img.width), // column range
 					  ClosestNTbb(*this, img));
+
+	if (!file.empty() && !aborted)
+		saveCache(file, key);
+}
+
+boost::uint64_t SOMClosestN::cacheKey(multi_img const& img) const
+{
+	img.rebuildPixels(false);
+	const size_t bytes = img.size() * sizeof(multi_img::Value);
+
+	// hash each image row in parallel, then combine in order
+	std::vector<boost::uint64_t> rows(height);
+	tbb::parallel_for(tbb::blocked_range<int>(0, height),
+		[&](const tbb::blocked_range<int> &r) {
+		for (int y = r.begin(); y != r.end(); ++y) {
+			boost::uint64_t h = fnvBasis;
+			for (int x = 0; x < width; ++x)
+				h = fnv(h, img(y, x).data(), bytes);
+			rows[y] = h;
+		}
+	});
+
+	boost::uint64_t h = fnvBasis;
+	boost::int32_t dims[5] = { height, width, (boost::int32_t)img.size(), n,
+							   (boost::int32_t)som.getConfig().similarity.function };
+	h = fnv(h, dims, sizeof(dims));
+	if (!rows.empty())
+		h = fnv(h, &rows[0], rows.size() * sizeof(boost::uint64_t));
+
+	// SOM in its file format (contains type, size and all neurons)
+	std::ostringstream os(std::ios::out | std::ios::binary);
+	som.saveFile(os);
+	const std::string sombin = os.str();
+	return fnv(h, sombin.data(), sombin.size());
+}
+
+std::string SOMClosestN::cacheFile(boost::uint64_t key) const
+{
+	std::stringstream ss;
+	ss << std::hex << std::setfill('0') << std::setw(16) << key << ".closestn";
+	return (boost::filesystem::path(som.getConfig().closestNCache)
+			/ ss.str()).string();
+}
+
+bool SOMClosestN::loadCache(const std::string &file, boost::uint64_t key)
+{
+	namespace bip = boost::interprocess;
+	if (!boost::filesystem::exists(file))
+		return false;
+
+	try {
+		bip::file_mapping mapping(file.c_str(), bip::read_only);
+		bip::mapped_region region(mapping, bip::read_only);
+		const char *data = static_cast<const char*>(region.get_address());
+
+		CacheHeader header;
+		size_t records = results.size();
+		if (region.get_size() < sizeof(CacheHeader)
+			+ records * sizeof(CacheRecord))
+			return false;
+		std::memcpy(&header, data, sizeof(CacheHeader));
+		if (std::memcmp(header.magic, cacheMagic, 16) != 0
+			|| header.version != cacheVersion || header.key != key
+			|| header.height != height || header.width != width
+			|| header.n != n)
+			return false;
+
+		const CacheRecord *rec = reinterpret_cast<const CacheRecord*>
+				(data + sizeof(CacheHeader));
+		for (size_t i = 0; i < records; ++i)
+			results[i] = DistIndexPair(rec[i].dist, rec[i].index);
+	} catch (const bip::interprocess_exception &e) {
+		std::cerr << "SOMClosestN: could not read cache file " << file
+				  << ": " << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void SOMClosestN::saveCache(const std::string &file, boost::uint64_t key) const
+{
+	CacheHeader header;
+	std::memcpy(header.magic, cacheMagic, 16);
+	header.version = cacheVersion;
+	header.height = height;
+	header.width = width;
+	header.n = n;
+	header.key = key;
+
+	std::vector<CacheRecord> records(results.size());
+	for (size_t i = 0; i < results.size(); ++i) {
+		records[i].dist = results[i].dist;
+		records[i].index = (boost::uint32_t)results[i].index;
+	}
+
+	// write to temporary file first, so readers never see a partial file
+	const std::string tmpfile = file + ".tmp";
+	try {
+		boost::filesystem::create_directories(
+					boost::filesystem::path(file).parent_path());
+		{
+			std::ofstream os(tmpfile.c_str(),
+							 std::ios::out | std::ios::binary);
+			os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			if (!records.empty())
+				os.write(reinterpret_cast<const char*>(&records[0]),
+						 records.size() * sizeof(CacheRecord));
+			if (!os)
+				throw std::runtime_error("could not write to file");
+		}
+		boost::filesystem::rename(tmpfile, file);
+	} catch (const std::exception &e) {
+		std::cerr << "SOMClosestN: could not write cache file " << file
+				  << ": " << e.what() << std::endl;
+		boost::system::error_code ec;
+		boost::filesystem::remove(tmpfile, ec);
+	}
 }
 
 std::vector<DistIndexPair> SOMClosestN::closestNCopy(const cv::Point2i &p) const
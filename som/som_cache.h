@@ -3,12 +3,22 @@
 
 #include "gensom.h"
 #include <progress_observer.h>
+#include <boost/cstdint.hpp>
+#include <tbb/atomic.h>
 
 namespace som {
 
 /** Compute closest n neurons in SOM for each multi_img pixel.
  *
- * The results are computed on construction.
+ * The results are computed on construction. If SOMConfig::closestNCache is
+ * set, they are stored in a file in that directory, and read from there on
+ * later construction with the same image data, SOM and n.
+ *
+ * Cache file layout (native byte order, no padding): 16 byte magic, int32
+ * version, int32 height, width, n, uint64 key; then for each pixel
+ * (row-major) n records of float distance and uint32 neuron index.
+ * Distances are stored as float, which is the type of DistIndexPair::dist,
+ * so results read from the cache equal freshly computed ones.
 */
 class SOMClosestN
 {
@@ -59,10 +69,22 @@ protected:
 		return off;
 	}
 
+	/** Hash of image data, SOM (binary format), similarity measure and n.
+	 * Identifies the cache file. */
+	boost::uint64_t cacheKey(multi_img const& img) const;
+	// path of cache file for key
+	std::string cacheFile(boost::uint64_t key) const;
+	// read results from file, return false if not present or invalid
+	bool loadCache(const std::string &file, boost::uint64_t key);
+	// write results to file, replacing it atomically
+	void saveCache(const std::string &file, boost::uint64_t key) const;
+
 	// neuron distances and SOM indices
 	// size = width * height * n
 	std::vector<DistIndexPair> results;
 	ProgressObserver *po;
+	// set if computation was aborted through po, results are incomplete
+	tbb::atomic<bool> aborted;
 	friend class ClosestNTbb;
 };
 
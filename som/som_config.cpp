@@ -19,10 +19,12 @@ SOMConfig::SOMConfig(const std::string& p)
 	  learnEnd(0.01), // TODO: we stop updating, when weight is < 0.01!
 	  sigmaStart(12.), // ratio sigmaStart : sigmaEnd should be about 4 : 1
 	  sigmaEnd(2.),
+	  batchSize(0),
 	  gaussKernel(false),
 //    use_opencl(false),
 //    use_opencl_cpu_opt(false),
 	  somFile(),
+	  closestNCache(),
 	  similarity(prefix + "similarity")
 {
 	#ifdef WITH_BOOST_PROGRAM_OPTIONS
@@ -46,6 +48,9 @@ DESC_OPT(sigmaStart,
 		"Initial neighborhood radius")
 DESC_OPT(sigmaEnd,
 		"Neighborhood radius at the end of the training process")
+DESC_OPT(batchSize,
+		"Number of samples per update in batch training (BMUs of a batch are "
+		"found in parallel). 0 or 1: online training, one update per sample")
 DESC_OPT(seed,
 		"Seed value of random number generators")
 DESC_OPT(gaussKernel,
@@ -57,6 +62,10 @@ DESC_OPT(use_opencl_cpu_opt,
 DESC_OPT(somFile,
 		"If file exists read binary SOM format, "
 		"otherwise write after training. If not set (empty string), do neither.")
+DESC_OPT(closestNCache,
+		"Directory to store closest neuron lookups of images in, which are "
+		"reused for the same image, SOM and number of neurons. "
+		"If not set (empty string), nothing is stored.")
 }
 
 #ifdef WITH_BOOST_PROGRAM_OPTIONS
@@ -69,11 +78,13 @@ void SOMConfig::initBoostOptions() {
 		BOOST_OPT(learnEnd)
 		BOOST_OPT(sigmaStart)
 		BOOST_OPT(sigmaEnd)
+		BOOST_OPT(batchSize)
 		BOOST_OPT(seed)
 		BOOST_BOOL(gaussKernel)
 		//BOOST_BOOL(use_opencl)
 		//BOOST_BOOL(use_opencl_cpu_opt)
 		BOOST_OPT(somFile)
+		BOOST_OPT(closestNCache)
 		;
 	options.add(similarity.options);
 }
@@ -91,6 +102,7 @@ std::string SOMConfig::getString() const {
 	COMMENT_OPT(s, learnEnd);
 	COMMENT_OPT(s, sigmaStart);
 	COMMENT_OPT(s, sigmaEnd);
+	COMMENT_OPT(s, batchSize);
 	COMMENT_OPT(s, seed);
 	COMMENT_OPT(s, gaussKernel);
 	s  << similarity.getString();
@@ -40,6 +40,7 @@ public:
 	double learnEnd;	// start value for learning rate (fades off with sigma)
 	double sigmaStart;	// start value for neighborhood radius
 	double sigmaEnd;	// start value for neighborhood radius
+	int batchSize;		// samples per update in batch mode, 0 for online
 
 	// kernel type: uniform or gauss
 	bool gaussKernel;
@@ -47,6 +48,9 @@ public:
 	// TODO: add bool flag, to explicitly allow overwriting if file exists.
 	std::string somFile;
 
+	/// directory for cached closest neuron lookups (SOMClosestN), or empty
+	std::string closestNCache;
+
 	/// similarity measure for model vector search in SOM
 	similarity_measures::SMConfig similarity;
 
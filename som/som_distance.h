@@ -40,6 +40,9 @@ public:
 	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2);
 	double getSimilarity(const std::vector<T> &v1, const std::vector<T> &v2,
 						 const cv::Point &c1, const cv::Point &c2);
+	double getSimilarity(const T *v1, const T *v2, size_t n);
+	double getSimilarity(const T *v1, const T *v2, size_t n,
+						 const cv::Point &c1, const cv::Point &c2);
 
 	const GenSOM &som;
 	const multi_img &img;
@@ -75,5 +78,25 @@ inline double SOMDistance<T>::getSimilarity(const std::vector<T> &v1,
 	return l2.getSimilarity(n1, n2);
 }
 
+template<typename T>
+inline double SOMDistance<T>::getSimilarity(const T *v1, const T *v2, size_t n)
+{
+	std::vector<float> n1 =
+			som.getCoord(som.findBMU(multi_img::PixelView(v1, n)).index);
+	std::vector<float> n2 =
+			som.getCoord(som.findBMU(multi_img::PixelView(v2, n)).index);
+	return l2.getSimilarity(n1, n2);
+}
+
+template<typename T>
+inline double SOMDistance<T>::getSimilarity(const T *v1, const T *v2, size_t n,
+											const cv::Point &c1,
+											const cv::Point &c2)
+{
+	std::vector<float> n1 = som.getCoord(cache.closestN(c1).first->index);
+	std::vector<float> n2 = som.getCoord(cache.closestN(c2).first->index);
+	return l2.getSimilarity(n1, n2);
+}
+
 }
 #endif
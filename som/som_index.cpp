@@ -0,0 +1,154 @@
+#include "som_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace som {
+
+namespace kernels = similarity_measures::kernels;
+
+/// neurons per leaf, scanned linearly
+static const size_t leafSize = 8;
+
+/* distances are computed in single precision lanes, triangle inequality may
+ * be violated by rounding. Tolerance when pruning subtrees. */
+static const double slack = 1e-4;
+
+void NeuronIndex::build(const cv::Mat_<float> &data, kernels::Distance d)
+{
+	assert(d == kernels::L1 || d == kernels::L2 || d == kernels::LINF);
+	clear();
+	if (data.empty())
+		return;
+
+	points = data.clone();
+	dist = d;
+	order.resize(points.rows);
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	nodes.reserve(2 * order.size() / leafSize + 1);
+	buildNode(0, order.size());
+}
+
+void NeuronIndex::clear()
+{
+	points.release();
+	nodes.clear();
+	order.clear();
+}
+
+double NeuronIndex::distance(const float *a, const float *b) const
+{
+	switch (dist) {
+	case kernels::L1:
+		return kernels::l1(a, b, points.cols);
+	case kernels::LINF:
+		return kernels::linf(a, b, points.cols);
+	default:
+		return kernels::l2(a, b, points.cols);
+	}
+}
+
+int NeuronIndex::buildNode(size_t first, size_t last)
+{
+	if (first >= last)
+		return -1;
+
+	int id = nodes.size();
+	nodes.push_back(Node());
+	Node node;
+	node.inside = node.outside = -1;
+	node.radius = 0.;
+
+	if (last - first <= leafSize) {
+		node.vantage = order[first];
+		node.first = first;
+		node.last = last;
+		nodes[id] = node;
+		return id;
+	}
+
+	// vantage point is the first neuron, split the others at the median
+	node.vantage = order[first];
+	node.first = node.last = 0;
+	const float *vp = points[node.vantage];
+	std::vector<std::pair<double, size_t> > tmp;
+	tmp.reserve(last - first - 1);
+	for (size_t i = first + 1; i < last; ++i)
+		tmp.push_back(std::make_pair(distance(vp, points[order[i]]), order[i]));
+
+	size_t half = tmp.size() / 2;
+	std::nth_element(tmp.begin(), tmp.begin() + half, tmp.end());
+	node.radius = tmp[half].first;
+	for (size_t i = 0; i < tmp.size(); ++i)
+		order[first + 1 + i] = tmp[i].second;
+
+	// inside: distance <= radius, outside: distance >= radius
+	size_t split = first + 1 + half + 1;
+	node.inside = buildNode(first + 1, split);
+	node.outside = buildNode(split, last);
+	nodes[id] = node;
+	return id;
+}
+
+void NeuronIndex::consider(const Entry &e, size_t n,
+						   std::vector<Entry> &heap) const
+{
+	// (distance, index) order: ties are won by the lower index
+	if (heap.size() < n) {
+		heap.push_back(e);
+		std::push_heap(heap.begin(), heap.end());
+	} else if (e < heap.front()) {
+		std::pop_heap(heap.begin(), heap.end());
+		heap.back() = e;
+		std::push_heap(heap.begin(), heap.end());
+	}
+}
+
+void NeuronIndex::search(int id, const float *query, size_t n,
+						 std::vector<Entry> &heap) const
+{
+	const Node &node = nodes[id];
+	if (node.first < node.last) {
+		for (size_t i = node.first; i < node.last; ++i)
+			consider(Entry(distance(query, points[order[i]]), order[i]),
+					 n, heap);
+		return;
+	}
+
+	double d = distance(query, points[node.vantage]);
+	consider(Entry(d, node.vantage), n, heap);
+
+	// start with the side the query falls into
+	int near = node.inside, far = node.outside;
+	if (d > node.radius)
+		std::swap(near, far);
+	for (int side = 0; side < 2; ++side) {
+		int child = (side ? far : near);
+		if (child < 0)
+			continue;
+		double tau = (heap.size() < n ? std::numeric_limits<double>::infinity()
+									  : heap.front().first);
+		tau += slack * tau + slack;
+		// bound on the distance to any neuron in the child
+		double bound = (child == node.inside ? d - node.radius
+											 : node.radius - d);
+		if (bound <= tau)
+			search(child, query, n, heap);
+	}
+}
+
+void NeuronIndex::closestN(const float *query, size_t n,
+						   std::vector<Entry> &out) const
+{
+	out.clear();
+	if (nodes.empty() || n == 0)
+		return;
+
+	out.reserve(std::min(n, (size_t)points.rows));
+	search(0, query, n, out);
+	std::sort_heap(out.begin(), out.end());
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef SOM_INDEX_H
+#define SOM_INDEX_H
+
+#include <sm_kernels.h>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace som {
+
+/// minimum number of neurons for which GenSOM builds a NeuronIndex
+#define SOM_INDEX_MIN_NEURONS 4096
+
+/** Exact nearest neighbor index over neuron weights (vantage point tree).
+ *
+ * Each node picks a vantage point and splits the remaining neurons at the
+ * median distance to it. Queries skip subtrees that, by the triangle
+ * inequality, cannot contain a closer neuron. The distance therefore has to
+ * be a metric (L1, L2 or Linf).
+ *
+ * Results are identical to a linear scan, including ties, which are broken
+ * by the lower neuron index.
+ */
+class NeuronIndex
+{
+public:
+	/// (distance, neuron index)
+	typedef std::pair<double, size_t> Entry;
+
+	NeuronIndex() : dist(similarity_measures::kernels::L2) {}
+
+	/// Build index over the rows of points (the data is copied)
+	void build(const cv::Mat_<float> &points,
+			   similarity_measures::kernels::Distance dist);
+
+	/// remove the index
+	void clear();
+
+	bool empty() const { return nodes.empty(); }
+
+	/** Find the n closest neurons to query, sorted by ascending distance.
+	 * out receives min(n, number of neurons) entries.
+	 */
+	void closestN(const float *query, size_t n, std::vector<Entry> &out) const;
+
+protected:
+	struct Node {
+		size_t vantage;   // neuron index
+		double radius;    // median distance of the subtree to the vantage
+		int inside;       // children, -1 if empty
+		int outside;
+		size_t first;     // leaf: range of neurons in order (empty otherwise)
+		size_t last;
+	};
+
+	int buildNode(size_t first, size_t last);
+	void search(int node, const float *query, size_t n,
+				std::vector<Entry> &heap) const;
+	double distance(const float *a, const float *b) const;
+	void consider(const Entry &e, size_t n, std::vector<Entry> &heap) const;
+
+	cv::Mat_<float> points;
+	similarity_measures::kernels::Distance dist;
+	std::vector<Node> nodes;
+	std::vector<size_t> order; // neuron indices, grouped by node
+};
+
+}
+#endif // SOM_INDEX_H
@@ -45,9 +45,9 @@ public:
 	  * Update vector by shifting it to new vector with a weight,
 	  * this = this + (input - this)*weight;
 	  */
-	inline void update(const multi_img::Pixel &input, double weight) {
+	inline void update(const multi_img::PixelView &input, double weight) {
 		Neuron::iterator o = begin();
-		multi_img::Pixel::const_iterator i = input.begin();
+		multi_img::PixelView::const_iterator i = input.begin();
 		for (; o != end(); ++o, ++i)
 			*o += (*i - *o) * weight;
 	}